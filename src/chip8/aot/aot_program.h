@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "chip8/chip8.h"
+#include "instruction/instruction.h"
+
+
+/**
+ * @struct aot_block
+ * @brief  A basic block of a ROM that was compiled ahead of time by the chip8_aot tool
+ */
+struct aot_block {
+    // The address of the first instruction in the block
+    uint16_t start = 0;
+
+    // One past the last byte the block was compiled from
+    uint16_t end = 0;
+
+    // The number of CHIP-8 instructions in the block
+    uint16_t instruction_count = 0;
+
+    // The compiled block
+    auto (*function)(chip8&) -> void = nullptr;
+};
+
+
+/**
+ * @struct aot_program
+ * @brief  A ROM that was compiled ahead of time by the chip8_aot tool
+ */
+struct aot_program {
+    // The name the program was generated with
+    std::string_view name;
+
+    // The ROM the program was compiled from
+    std::span<const uint8_t> rom;
+
+    // The quirk profile the program was compiled for
+    QuirkProfile quirk_profile = QuirkProfile::xo_chip;
+
+    // The compiled blocks of the ROM
+    std::span<const aot_block> blocks;
+};
+
+
+/**
+ * @brief Register a compiled program so that it's used whenever its ROM is loaded
+ *
+ * @details Generated programs call this during static initialization.
+ *
+ * @param[in] program  The program to register. Must outlive all chip8 instances.
+ *
+ * @return True
+ */
+auto register_aot_program(const aot_program& program) -> bool;
+
+/**
+ * @brief Find the registered program that was compiled from a ROM
+ *
+ * @param[in] rom      The contents of the ROM
+ * @param[in] profile  The quirk profile the ROM is run with
+ *
+ * @return The compiled program, or nullptr if none of the registered programs match the ROM and profile
+ */
+[[nodiscard]]
+auto find_aot_program(std::span<const uint8_t> rom, QuirkProfile profile) -> const aot_program*;
+
+
+/**
+ * @class AOTAccess
+ *
+ * @brief Gives code generated by the chip8_aot tool access to the state of a chip8
+ */
+class AOTAccess {
+public:
+
+    [[nodiscard]]
+    static auto v(chip8& chip) noexcept -> std::array<uint8_t, 16>& {
+        return chip.state.v;
+    }
+
+    [[nodiscard]]
+    static auto i(chip8& chip) noexcept -> uint16_t& {
+        return chip.state.i;
+    }
+
+    [[nodiscard]]
+    static auto pc(chip8& chip) noexcept -> uint16_t& {
+        return chip.state.pc;
+    }
+
+    /**
+     * @brief Execute an instruction with the interpreter
+     *
+     * @param[in] chip     The chip8 to execute the instruction on
+     * @param[in] address  The address of the instruction
+     * @param[in] instr    The instruction to execute
+     */
+    static auto interpret(chip8& chip, uint16_t address, instruction instr) -> void;
+};
@@ -0,0 +1,71 @@
+#include "aot_runtime.h"
+#include "chip8/isa/isa.h"
+
+#include <algorithm>
+#include <vector>
+
+
+//----------------------------------------------------------------------------------
+// Program Registry
+//----------------------------------------------------------------------------------
+
+static auto aot_programs() -> std::vector<const aot_program*>& {
+	static std::vector<const aot_program*> programs;
+	return programs;
+}
+
+
+auto register_aot_program(const aot_program& program) -> bool {
+	aot_programs().push_back(&program);
+	return true;
+}
+
+
+auto find_aot_program(std::span<const uint8_t> rom, QuirkProfile profile) -> const aot_program* {
+	for (const auto* program : aot_programs()) {
+		if ((program->quirk_profile == profile) and std::ranges::equal(program->rom, rom)) {
+			return program;
+		}
+	}
+	return nullptr;
+}
+
+
+auto AOTAccess::interpret(chip8& chip, uint16_t address, instruction instr) -> void {
+	chip.state.pc = address;
+	(*chip.handlers)[to_index(instr.opcode)](chip, instr);
+}
+
+
+//----------------------------------------------------------------------------------
+// AOTRuntime
+//----------------------------------------------------------------------------------
+
+AOTRuntime::AOTRuntime(const aot_program& program) : program(program) {
+	for (const auto& blk : program.blocks) {
+		blocks[blk.start] = &blk;
+	}
+}
+
+
+auto AOTRuntime::execute(chip8& chip) -> uint32_t {
+	const aot_block* const blk = blocks[chip.state.pc];
+
+	if (!blk) {
+		return 0;
+	}
+
+	blk->function(chip);
+	return blk->instruction_count;
+}
+
+
+auto AOTRuntime::invalidate(size_t address, size_t count) noexcept -> void {
+	const size_t last = address + count;
+
+	for (const auto& blk : program.blocks) {
+		if ((blk.start < last) and (blk.end > address)) {
+			blocks[blk.start] = nullptr;
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "aot_program.h"
+#include "chip8/chip8.h"
+
+
+/**
+ * @class AOTRuntime
+ *
+ * @brief Executes the blocks of an ahead-of-time compiled program on a chip8
+ *
+ * @details Blocks are looked up by the PC. A block is disabled once any byte
+ *          it was compiled from is written, and the interpreter executes that
+ *          code instead. Addresses without a block, such as the targets of
+ *          indirect jumps, are also left to the interpreter.
+ */
+class AOTRuntime {
+public:
+
+    /**
+     * @param[in] program  The program to execute. Must match the ROM loaded in the chip8.
+     */
+    explicit AOTRuntime(const aot_program& program);
+
+    /**
+     * @brief Execute the block at the chip's PC, if there is one
+     *
+     * @param[in] chip  The chip8 to execute
+     *
+     * @return The number of instructions executed. 0 if there is no block at the PC.
+     */
+    auto execute(chip8& chip) -> uint32_t;
+
+    /**
+     * @brief Disable any blocks compiled from the specified memory range
+     *
+     * @param[in] address  The first address that was written
+     * @param[in] count    The number of bytes that were written
+     */
+    auto invalidate(size_t address, size_t count) noexcept -> void;
+
+    [[nodiscard]]
+    auto get_program() const noexcept -> const aot_program& {
+        return program;
+    }
+
+private:
+
+    const aot_program& program;
+
+    // The block that starts at each address, or nullptr if there isn't one
+    std::array<const aot_block*, chip8::max_memory_size> blocks = {};
+};
@@ -0,0 +1,887 @@
+#include "chip8_batch.h"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <iostream>
+
+
+Chip8Batch::Chip8Batch(size_t count) :
+	lanes(count),
+	stride(((count + lane_alignment - 1) / lane_alignment) * lane_alignment),
+	v(16 * stride),
+	i(stride),
+	pc(stride),
+	stack(stack_levels * stride),
+	sp(stride),
+	delay_timer(stride),
+	sound_timer(stride),
+	virtual_time(stride),
+	display(display_height * stride),
+	memory(count * memory_size),
+	keys(stride),
+	key_register(stride),
+	paused(stride),
+	halt_reason(stride),
+	cycle_count(stride),
+	rng_seed(count),
+	rng(count),
+	opcodes(stride),
+	executed(stride),
+	group_slots(std::bit_ceil(std::max<size_t>(2 * count, 64))),
+	mask(stride) {
+
+	// Each lane gets a random seed, like a chip8
+	auto device = std::random_device{};
+	for (size_t lane = 0; lane < lanes; ++lane) {
+		set_rng_seed(lane, device());
+	}
+
+	reset();
+}
+
+
+auto Chip8Batch::reset() -> void {
+	// Reset registers
+	std::ranges::fill(v, uint8_t{0});
+	std::ranges::fill(i, uint16_t{0});
+	std::ranges::fill(pc, static_cast<uint16_t>(rom_start));
+
+	// Empty the stack
+	std::ranges::fill(stack, uint16_t{0});
+	std::ranges::fill(sp, uint32_t{0});
+
+	// Reset the delay and sound timers
+	std::ranges::fill(delay_timer, uint8_t{0});
+	std::ranges::fill(sound_timer, uint8_t{0});
+	std::ranges::fill(virtual_time, uint32_t{0});
+
+	// Clear the display
+	std::ranges::fill(display, uint64_t{0});
+
+	// Zero out memory and load the font
+	std::ranges::fill(memory, uint8_t{0});
+	for (size_t lane = 0; lane < lanes; ++lane) {
+		std::ranges::copy(chip8::font, lane_memory(lane));
+	}
+	rom_end = rom_start;
+
+	// Release all keys
+	std::ranges::fill(keys, uint16_t{0});
+	std::ranges::fill(key_register, no_key_wait);
+
+	std::ranges::fill(cycle_count, uint64_t{0});
+	std::ranges::fill(halt_reason, HaltReason::none);
+
+	// Restart the random number sequences
+	for (size_t lane = 0; lane < lanes; ++lane) {
+		rng[lane].seed(rng_seed[lane]);
+	}
+
+	// Every lane is paused until a ROM is loaded. The padding lanes never run.
+	std::ranges::fill(paused, uint8_t{1});
+}
+
+
+auto Chip8Batch::pause(size_t lane) noexcept -> void {
+	paused[lane] = 1;
+}
+
+
+auto Chip8Batch::resume(size_t lane) noexcept -> void {
+	paused[lane] = 0;
+	halt_reason[lane] = HaltReason::none;
+}
+
+
+auto Chip8Batch::halt(size_t lane, HaltReason reason) noexcept -> void {
+	paused[lane] = 1;
+	halt_reason[lane] = reason;
+}
+
+
+auto Chip8Batch::get_registers(size_t lane) const noexcept -> std::array<uint8_t, 16> {
+	std::array<uint8_t, 16> result;
+	for (size_t idx = 0; idx < result.size(); ++idx) {
+		result[idx] = v[(idx * stride) + lane];
+	}
+	return result;
+}
+
+
+auto Chip8Batch::get_stack(size_t lane) const -> std::vector<uint16_t> {
+	std::vector<uint16_t> result;
+	for (size_t level = 0; level < sp[lane]; ++level) {
+		result.push_back(stack[(level * stride) + lane]);
+	}
+	return result;
+}
+
+
+auto Chip8Batch::set_key_state(size_t lane, Keys key, bool pressed) noexcept -> void {
+	const auto bit = static_cast<uint16_t>(1 << static_cast<uint8_t>(key));
+
+	if (pressed) {
+		keys[lane] |= bit;
+	}
+	else {
+		keys[lane] &= ~bit;
+	}
+
+	// Complete the key wait if the lane is waiting for a key press
+	if (pressed and (key_register[lane] != no_key_wait)) {
+		reg(key_register[lane])[lane] = static_cast<uint8_t>(key);
+		key_register[lane] = no_key_wait;
+		resume(lane);
+		pc[lane] += 2;
+	}
+}
+
+
+auto Chip8Batch::get_timer_clock_rate() const noexcept -> uint32_t {
+	// In instructions per frame mode, each frame is one 60Hz tick
+	if (clock_mode == ClockMode::instructions_per_frame) {
+		return instructions_per_frame * 60;
+	}
+	return clock_rate;
+}
+
+
+auto Chip8Batch::load_rom(const std::filesystem::path& file) -> bool {
+	// Check that file exists
+	if (!std::filesystem::exists(file)) {
+		std::cout << "Error loading ROM " << file << ": The file does not exist\n";
+		return false;
+	}
+
+	// Ensure the ROM will fit in the memory
+	const auto file_size = std::filesystem::file_size(file);
+
+	if (file_size > (memory_size - rom_start)) {
+		std::cout << "The ROM " << file << " is too big to fit in the CHIP8 memory\n"
+		          << "  Memory size: " << (memory_size - rom_start) << '\n'
+		          << "     ROM size: " << file_size << '\n';
+		return false;
+	}
+
+	// Open the file and check that it's not in an error state
+	std::ifstream rom(file, std::ios::binary);
+	if (!rom) {
+		std::cout << "Error opening " << file << '\n';
+		return false;
+	}
+
+	std::vector<uint8_t> data(file_size);
+	rom.read(reinterpret_cast<char*>(data.data()), file_size);
+
+	load_rom_data(data);
+	return true;
+}
+
+
+auto Chip8Batch::load_rom(std::span<const uint16_t> rom_data) -> bool {
+	// Ensure the ROM will fit in the memory
+	if (rom_data.size_bytes() > (memory_size - rom_start)) {
+		std::cout << "The ROM data is too big to fit in the CHIP8 memory\n"
+		          << "  Memory size: " << (memory_size - rom_start) << '\n'
+		          << "     ROM size: " << rom_data.size_bytes() << '\n';
+		return false;
+	}
+
+	std::vector<uint8_t> data;
+	for (const uint16_t word : rom_data) {
+		data.push_back(static_cast<uint8_t>(word >> 8));
+		data.push_back(static_cast<uint8_t>(word));
+	}
+
+	load_rom_data(data);
+	return true;
+}
+
+
+auto Chip8Batch::load_rom_data(std::span<const uint8_t> data) -> void {
+	// Apply the settings the ROM was written for. Only the CHIP-8 platform is supported, so the platform is ignored.
+	if (const rom_info* const info = rom_database ? rom_database->find(data) : nullptr) {
+		if (info->quirks) {
+			set_quirk_profile(*info->quirks);
+		}
+		if (info->instructions_per_frame) {
+			clock_mode = ClockMode::instructions_per_frame;
+			set_instructions_per_frame(*info->instructions_per_frame);
+		}
+	}
+
+	reset();
+
+	for (size_t lane = 0; lane < lanes; ++lane) {
+		std::ranges::copy(data, lane_memory(lane) + rom_start);
+	}
+	rom_end = rom_start + data.size();
+
+	// Start emulation
+	for (size_t lane = 0; lane < lanes; ++lane) {
+		resume(lane);
+	}
+}
+
+
+auto Chip8Batch::step() -> size_t {
+	const size_t executed_lanes = fetch();
+	if (executed_lanes == 0) {
+		return 0;
+	}
+
+	const uint16_t* const ops = opcodes.data();
+	const uint8_t* const  ran = executed.data();
+	uint8_t* const        m   = mask.data();
+
+	// Find the range of lanes to execute, and check if they all have the same instruction
+	size_t begin = 0;
+	while (!ran[begin]) {
+		++begin;
+	}
+	size_t end = lanes;
+	while (!ran[end - 1]) {
+		--end;
+	}
+
+	const uint16_t op = ops[begin];
+
+	// Count the lanes that execute the first lane's instruction
+	size_t matching = 0;
+	for (size_t lane = begin; lane < end; ++lane) {
+		matching += ran[lane] & ((ops[lane] == op) ? 1 : 0);
+	}
+
+	// The mask is cleared after each group, so it only selects the lanes of the next group
+	if (matching == executed_lanes) {
+		std::ranges::copy(executed, mask.begin());
+		execute<false>(instruction{op}, begin, end);
+		std::ranges::fill(mask, uint8_t{0});
+	}
+	else if ((matching * 2) < executed_lanes) {
+		// The lanes have scattered over many instructions, and grouping them costs
+		// more than it saves. Execute each lane on its own.
+		for (size_t lane = begin; lane < end; ++lane) {
+			if (ran[lane]) {
+				m[lane] = 0xFF;
+				execute<true>(instruction{ops[lane]}, lane, lane + 1);
+				m[lane] = 0;
+			}
+		}
+	}
+	else {
+		group_lanes(begin, end);
+
+		for (const auto& group : groups) {
+			const uint16_t group_op = group.opcode;
+			const size_t group_end  = group.last + 1;
+
+			// A masked pass costs about the same for any number of lanes in its range,
+			// so small groups are faster to execute one lane at a time.
+			if (group.size <= max_scalar_group) {
+				for (size_t lane = group.first; lane < group_end; ++lane) {
+					if (ran[lane] and (ops[lane] == group_op)) {
+						m[lane] = 0xFF;
+						execute<true>(instruction{group_op}, lane, lane + 1);
+						m[lane] = 0;
+					}
+				}
+				continue;
+			}
+
+			for (size_t lane = group.first; lane < group_end; ++lane) {
+				m[lane] = ran[lane] & ((ops[lane] == group_op) ? 0xFF : 0);
+			}
+
+			execute<false>(instruction{group_op}, group.first, group_end);
+
+			for (size_t lane = group.first; lane < group_end; ++lane) {
+				m[lane] = 0;
+			}
+		}
+	}
+
+	advance_timers();
+
+	return executed_lanes;
+}
+
+
+auto Chip8Batch::group_lanes(size_t begin, size_t end) -> void {
+	const uint16_t* const ops = opcodes.data();
+	const uint8_t* const  ran = executed.data();
+	const size_t slot_mask = group_slots.size() - 1;
+
+	groups.clear();
+
+	for (size_t lane = begin; lane < end; ++lane) {
+		if (!ran[lane]) {
+			continue;
+		}
+
+		// Find the group of the lane's instruction with linear probing. The
+		// table has at least twice as many slots as lanes, so it's never full.
+		const uint16_t op = ops[lane];
+		size_t slot = (op * size_t{0x9E3779B1}) >> 16;
+
+		while (true) {
+			slot &= slot_mask;
+			const uint32_t entry = group_slots[slot];
+
+			if (entry == 0) {
+				groups.push_back(lane_group{op, static_cast<uint32_t>(lane), static_cast<uint32_t>(lane), 1, static_cast<uint32_t>(slot)});
+				group_slots[slot] = static_cast<uint32_t>(groups.size());
+				break;
+			}
+
+			auto& group = groups[entry - 1];
+			if (group.opcode == op) {
+				group.last = static_cast<uint32_t>(lane);
+				++group.size;
+				break;
+			}
+
+			++slot;
+		}
+	}
+
+	// Empty the table for the next step
+	for (const auto& group : groups) {
+		group_slots[group.slot] = 0;
+	}
+}
+
+
+auto Chip8Batch::run(uint64_t count) -> uint64_t {
+	cycle_limit = std::numeric_limits<uint64_t>::max();
+
+	uint64_t total = 0;
+
+	for (uint64_t n = 0; n < count; ++n) {
+		const size_t executed_lanes = step();
+		if (executed_lanes == 0) {
+			break;
+		}
+		total += executed_lanes;
+	}
+
+	return total;
+}
+
+
+auto Chip8Batch::run_until(uint64_t target) -> uint64_t {
+	cycle_limit = target;
+
+	uint64_t total = 0;
+	while (const size_t executed_lanes = step()) {
+		total += executed_lanes;
+	}
+
+	cycle_limit = std::numeric_limits<uint64_t>::max();
+	return total;
+}
+
+
+auto Chip8Batch::fetch() noexcept -> size_t {
+	size_t count = 0;
+
+	for (size_t lane = 0; lane < lanes; ++lane) {
+		executed[lane] = 0;
+
+		if (paused[lane] or (cycle_count[lane] >= cycle_limit)) {
+			continue;
+		}
+
+		// Check that the PC is within the ROM's memory region
+		if (pc[lane] >= rom_end) {
+			halt(lane, HaltReason::end_of_rom);
+			continue;
+		}
+
+		const uint8_t* const mem = lane_memory(lane);
+		opcodes[lane]  = static_cast<uint16_t>((mem[pc[lane]] << 8) | mem[(pc[lane] + 1) % memory_size]);
+		executed[lane] = 0xFF;
+		++count;
+	}
+
+	return count;
+}
+
+
+auto Chip8Batch::advance_timers() noexcept -> void {
+	const uint8_t* const ran = executed.data();
+	uint64_t* const cycles   = cycle_count.data();
+	uint32_t* const time     = virtual_time.data();
+	uint8_t* const delay     = delay_timer.data();
+	uint8_t* const sound     = sound_timer.data();
+	const size_t   count     = stride;
+
+	for (size_t lane = 0; lane < count; ++lane) {
+		cycles[lane] += ran[lane] & 1;
+	}
+
+	const uint32_t rate = get_timer_clock_rate();
+
+	// Each instruction is 60 units of time. At 60Hz or more, that's at most one tick.
+	if (rate >= 60) {
+		for (size_t lane = 0; lane < count; ++lane) {
+			const uint32_t now  = time[lane] + (ran[lane] & 60); //0xFF & 60 == 60
+			const uint32_t tick = (now >= rate) ? 1 : 0;
+
+			time[lane]  = now - (tick * rate);
+			delay[lane] = static_cast<uint8_t>(delay[lane] - (tick & (delay[lane] != 0)));
+			sound[lane] = static_cast<uint8_t>(sound[lane] - (tick & (sound[lane] != 0)));
+		}
+		return;
+	}
+
+	for (size_t lane = 0; lane < lanes; ++lane) {
+		if (!ran[lane]) {
+			continue;
+		}
+
+		time[lane] += 60;
+		const uint32_t ticks = time[lane] / rate;
+		time[lane] %= rate;
+
+		delay[lane] = (ticks < delay[lane]) ? static_cast<uint8_t>(delay[lane] - ticks) : 0;
+		sound[lane] = (ticks < sound[lane]) ? static_cast<uint8_t>(sound[lane] - ticks) : 0;
+	}
+}
+
+
+auto Chip8Batch::wait_for_frame(size_t lane) noexcept -> void {
+	const uint64_t rate  = get_timer_clock_rate();
+	const uint64_t frame = (cycle_count[lane] * 60) / rate;
+
+	// The lane continues at the instruction count at which the timers next tick, like chip8::instructions_until_frame.
+	// One instruction is counted by advance_timers.
+	const uint64_t end    = (((frame + 1) * rate) + 59) / 60;
+	const uint64_t waited = end - cycle_count[lane] - 1;
+	cycle_count[lane] += waited;
+
+	// The timers advance by the waited instructions now, and by the draw itself with the rest of the step
+	const uint64_t time  = virtual_time[lane] + (waited * 60);
+	const uint64_t ticks = time / rate;
+	virtual_time[lane] = static_cast<uint32_t>(time % rate);
+
+	delay_timer[lane] = (ticks < delay_timer[lane]) ? static_cast<uint8_t>(delay_timer[lane] - ticks) : 0;
+	sound_timer[lane] = (ticks < sound_timer[lane]) ? static_cast<uint8_t>(sound_timer[lane] - ticks) : 0;
+}
+
+
+//----------------------------------------------------------------------------------
+// Instruction Execution
+//----------------------------------------------------------------------------------
+//
+// Each instruction has the same effect on a lane as its ISA handler. Instructions
+// that only touch the per-lane arrays are a single pass over the group, which
+// writes every lane and keeps the old value of the lanes that aren't selected.
+// These passes have no branches, so the compiler vectorizes them. Instructions
+// that access memory, the stack, or the random number generator execute one lane
+// at a time.
+//
+// Registers are read and written in the same order as the ISA handlers, so an
+// instruction that operates on vF has the same result.
+//
+//----------------------------------------------------------------------------------
+
+// Select a for the lanes in the mask (0xFF), otherwise b. Unlike a conditional,
+// both values are always evaluated, so loops that use it have no branches.
+template<typename T>
+[[nodiscard]]
+static constexpr auto blend(uint8_t mask, T a, T b) noexcept -> T {
+	const auto wide = static_cast<T>(-static_cast<T>(mask & 1));
+	return static_cast<T>((a & wide) | (b & static_cast<T>(~wide)));
+}
+
+
+auto Chip8Batch::increment_pc(size_t begin, size_t end) noexcept -> void {
+	const uint8_t* const m = mask.data();
+	uint16_t* const counter = pc.data();
+
+	for (size_t lane = begin; lane < end; ++lane) {
+		counter[lane] = blend(m[lane], static_cast<uint16_t>(counter[lane] + 2), counter[lane]);
+	}
+}
+
+
+template<typename Pred>
+auto Chip8Batch::skip_if(size_t begin, size_t end, Pred&& pred) noexcept -> void {
+	const uint8_t* const m = mask.data();
+	uint16_t* const counter = pc.data();
+
+	for (size_t lane = begin; lane < end; ++lane) {
+		const uint16_t offset = pred(lane) ? 4 : 2;
+		counter[lane] = blend(m[lane], static_cast<uint16_t>(counter[lane] + offset), counter[lane]);
+	}
+}
+
+
+auto Chip8Batch::clear_vf(size_t begin, size_t end) noexcept -> void {
+	const uint8_t* const m  = mask.data();
+	uint8_t* const       vf = reg(0xF);
+
+	for (size_t lane = begin; lane < end; ++lane) {
+		vf[lane] = blend(m[lane], uint8_t{0}, vf[lane]);
+	}
+}
+
+
+template<typename Func>
+auto Chip8Batch::each_lane(size_t begin, size_t end, Func&& func) -> void {
+	for (size_t lane = begin; lane < end; ++lane) {
+		if (mask[lane]) {
+			func(lane);
+		}
+	}
+}
+
+
+template<bool Single>
+auto Chip8Batch::execute(instruction instr, size_t begin, size_t end) -> void {
+	if constexpr (Single) {
+		end = begin + 1;
+	}
+
+	const uint8_t* const m = mask.data();
+
+	uint8_t* const vx = reg(instr.x);
+	uint8_t* const vy = reg(instr.y);
+	uint8_t* const vf = reg(0xF);
+	uint8_t* const v0 = reg(0);
+
+	uint16_t* const index   = i.data();
+	uint16_t* const counter = pc.data();
+	uint8_t* const  delay   = delay_timer.data();
+	uint8_t* const  sound   = sound_timer.data();
+
+	const uint8_t  nn  = instr.nn;
+	const uint16_t nnn = instr.nnn;
+	const quirks q     = active_quirks;
+
+	switch (instr.opcode) {
+		case Opcodes::cls:
+			for (size_t y = 0; y < display_height; ++y) {
+				uint64_t* const row = display.data() + (y * stride);
+				for (size_t lane = begin; lane < end; ++lane) {
+					row[lane] = blend(m[lane], uint64_t{0}, row[lane]);
+				}
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::ret:
+			each_lane(begin, end, [&](size_t lane) {
+				if (sp[lane] == 0) {
+					halt(lane, HaltReason::invalid_instruction);
+					return;
+				}
+				--sp[lane];
+				counter[lane] = stack[(sp[lane] * stride) + lane] + 2;
+			});
+			break;
+
+		case Opcodes::sys_nnn:
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::jmp_nnn:
+			for (size_t lane = begin; lane < end; ++lane) {
+				counter[lane] = blend(m[lane], nnn, counter[lane]);
+			}
+			break;
+
+		case Opcodes::call_nnn:
+			each_lane(begin, end, [&](size_t lane) {
+				if (sp[lane] == stack_levels) {
+					halt(lane, HaltReason::stack_overflow);
+					return;
+				}
+				stack[(sp[lane] * stride) + lane] = counter[lane];
+				++sp[lane];
+				counter[lane] = nnn;
+			});
+			break;
+
+		case Opcodes::se_vx_nn:
+			skip_if(begin, end, [&](size_t lane) { return vx[lane] == nn; });
+			break;
+
+		case Opcodes::sne_vx_nn:
+			skip_if(begin, end, [&](size_t lane) { return vx[lane] != nn; });
+			break;
+
+		case Opcodes::se_vx_vy:
+			skip_if(begin, end, [&](size_t lane) { return vx[lane] == vy[lane]; });
+			break;
+
+		case Opcodes::sne_vx_vy:
+			skip_if(begin, end, [&](size_t lane) { return vx[lane] != vy[lane]; });
+			break;
+
+		case Opcodes::mov_vx_nn:
+			for (size_t lane = begin; lane < end; ++lane) {
+				vx[lane] = blend(m[lane], nn, vx[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::add_vx_nn:
+			for (size_t lane = begin; lane < end; ++lane) {
+				vx[lane] = blend(m[lane], static_cast<uint8_t>(vx[lane] + nn), vx[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::mov_vx_vy:
+			for (size_t lane = begin; lane < end; ++lane) {
+				vx[lane] = blend(m[lane], vy[lane], vx[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::or_vx_vy:
+			for (size_t lane = begin; lane < end; ++lane) {
+				vx[lane] = blend(m[lane], static_cast<uint8_t>(vx[lane] | vy[lane]), vx[lane]);
+			}
+			if (q.vf_reset) {
+				clear_vf(begin, end);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::and_vx_vy:
+			for (size_t lane = begin; lane < end; ++lane) {
+				vx[lane] = blend(m[lane], static_cast<uint8_t>(vx[lane] & vy[lane]), vx[lane]);
+			}
+			if (q.vf_reset) {
+				clear_vf(begin, end);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::xor_vx_vy:
+			for (size_t lane = begin; lane < end; ++lane) {
+				vx[lane] = blend(m[lane], static_cast<uint8_t>(vx[lane] ^ vy[lane]), vx[lane]);
+			}
+			if (q.vf_reset) {
+				clear_vf(begin, end);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::add_vx_vy:
+			for (size_t lane = begin; lane < end; ++lane) {
+				const auto result = static_cast<uint8_t>(vx[lane] + vy[lane]);
+				const uint8_t carry = (result < vx[lane]) ? 1 : 0;
+				vx[lane] = blend(m[lane], result, vx[lane]);
+				vf[lane] = blend(m[lane], carry, vf[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::sub_vx_vy:
+			for (size_t lane = begin; lane < end; ++lane) {
+				vf[lane] = blend(m[lane], static_cast<uint8_t>((vx[lane] > vy[lane]) ? 1 : 0), vf[lane]);
+				vx[lane] = blend(m[lane], static_cast<uint8_t>(vx[lane] - vy[lane]), vx[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::shr_vx: {
+			uint8_t* const src = q.shift_vy ? vy : vx;
+			for (size_t lane = begin; lane < end; ++lane) {
+				vf[lane] = blend(m[lane], static_cast<uint8_t>(src[lane] & 1), vf[lane]);
+				vx[lane] = blend(m[lane], static_cast<uint8_t>(src[lane] >> 1), vx[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+		}
+
+		case Opcodes::subn_vx_vy:
+			for (size_t lane = begin; lane < end; ++lane) {
+				vf[lane] = blend(m[lane], static_cast<uint8_t>((vy[lane] > vx[lane]) ? 1 : 0), vf[lane]);
+				vx[lane] = blend(m[lane], static_cast<uint8_t>(vy[lane] - vx[lane]), vx[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::shl_vx: {
+			uint8_t* const src = q.shift_vy ? vy : vx;
+			for (size_t lane = begin; lane < end; ++lane) {
+				vf[lane] = blend(m[lane], static_cast<uint8_t>(src[lane] >> 7), vf[lane]);
+				vx[lane] = blend(m[lane], static_cast<uint8_t>(src[lane] << 1), vx[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+		}
+
+		case Opcodes::mov_i_nnn:
+			for (size_t lane = begin; lane < end; ++lane) {
+				index[lane] = blend(m[lane], nnn, index[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::jmp_v0_nnn: {
+			// SUPER-CHIP jumps relative to vx instead of v0
+			const uint8_t* const base = q.jump_vx ? vx : v0;
+			for (size_t lane = begin; lane < end; ++lane) {
+				counter[lane] = blend(m[lane], static_cast<uint16_t>(nnn + base[lane]), counter[lane]);
+			}
+			break;
+		}
+
+		case Opcodes::rnd_vx_nn:
+			each_lane(begin, end, [&](size_t lane) {
+				vx[lane] = static_cast<uint8_t>((rng[lane]() >> 24) & nn);
+			});
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::drw_vx_vy_n:
+			// 16x16 sprites are SUPER-CHIP instructions, which aren't supported
+			if (instr.n == 0) {
+				each_lane(begin, end, [&](size_t lane) {
+					halt(lane, HaltReason::invalid_instruction);
+				});
+				break;
+			}
+
+			each_lane(begin, end, [&](size_t lane) {
+				const uint8_t* const mem = lane_memory(lane);
+				const size_t x = vx[lane] % display_width;
+				const size_t y = vy[lane] % display_height;
+
+				// Each sprite byte is XORed onto a row, rotated so it wraps around the display,
+				// or shifted so the part past the right edge is clipped
+				bool erased = false;
+				for (size_t n = 0; n < instr.n; ++n) {
+					if (!q.wrap and ((y + n) >= display_height)) {
+						break;
+					}
+
+					const auto sprite = static_cast<uint64_t>(mem[(index[lane] + n) % memory_size]) << 56;
+					const auto bits   = q.wrap ? std::rotr(sprite, static_cast<int>(x)) : (sprite >> x);
+					uint64_t& row = display[(((y + n) % display_height) * stride) + lane];
+
+					erased |= (row & bits) != 0;
+					row ^= bits;
+				}
+
+				vf[lane] = erased ? 1 : 0;
+
+				if (q.display_wait) {
+					wait_for_frame(lane);
+				}
+			});
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::skp_vx:
+			skip_if(begin, end, [&](size_t lane) {
+				return (vx[lane] < 16) and (((keys[lane] >> vx[lane]) & 1) != 0);
+			});
+			break;
+
+		case Opcodes::sknp_vx:
+			skip_if(begin, end, [&](size_t lane) {
+				return (vx[lane] >= 16) or (((keys[lane] >> vx[lane]) & 1) == 0);
+			});
+			break;
+
+		case Opcodes::gdly_vx:
+			for (size_t lane = begin; lane < end; ++lane) {
+				vx[lane] = blend(m[lane], delay[lane], vx[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::key_vx:
+			// The lane resumes at the next instruction when a key is pressed (see set_key_state)
+			each_lane(begin, end, [&](size_t lane) {
+				halt(lane, HaltReason::key_wait);
+				key_register[lane] = instr.x;
+			});
+			break;
+
+		case Opcodes::sdly_vx:
+			for (size_t lane = begin; lane < end; ++lane) {
+				delay[lane] = blend(m[lane], vx[lane], delay[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::ssnd_vx:
+			for (size_t lane = begin; lane < end; ++lane) {
+				sound[lane] = blend(m[lane], vx[lane], sound[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::add_i_vx:
+			for (size_t lane = begin; lane < end; ++lane) {
+				const auto sum = static_cast<uint16_t>(index[lane] + vx[lane]);
+				vf[lane]    = blend(m[lane], static_cast<uint8_t>((sum < index[lane]) ? 1 : 0), vf[lane]);
+				index[lane] = blend(m[lane], static_cast<uint16_t>(vx[lane] + index[lane]), index[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::font_vx:
+			for (size_t lane = begin; lane < end; ++lane) {
+				index[lane] = blend(m[lane], static_cast<uint16_t>(vx[lane] * 5), index[lane]);
+			}
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::bcd_vx:
+			each_lane(begin, end, [&](size_t lane) {
+				uint8_t* const mem = lane_memory(lane);
+				const uint8_t val = vx[lane];
+
+				mem[index[lane] % memory_size]       = val / 100;
+				mem[(index[lane] + 1) % memory_size] = (val / 10) % 10;
+				mem[(index[lane] + 2) % memory_size] = val % 10;
+			});
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::str_v0_vx:
+			each_lane(begin, end, [&](size_t lane) {
+				uint8_t* const mem = lane_memory(lane);
+
+				for (size_t r = 0; r <= instr.x; ++r) {
+					mem[(index[lane] + r) % memory_size] = reg(r)[lane];
+				}
+				if (q.increment_i) {
+					index[lane] = static_cast<uint16_t>(index[lane] + instr.x + 1);
+				}
+			});
+			increment_pc(begin, end);
+			break;
+
+		case Opcodes::ld_v0_vx:
+			each_lane(begin, end, [&](size_t lane) {
+				const uint8_t* const mem = lane_memory(lane);
+
+				for (size_t r = 0; r <= instr.x; ++r) {
+					reg(r)[lane] = mem[(index[lane] + r) % memory_size];
+				}
+				if (q.increment_i) {
+					index[lane] = static_cast<uint16_t>(index[lane] + instr.x + 1);
+				}
+			});
+			increment_pc(begin, end);
+			break;
+
+		default:
+			// The instruction couldn't be decoded. Pause the lane at the instruction so it can be inspected.
+			each_lane(begin, end, [&](size_t lane) {
+				halt(lane, HaltReason::invalid_instruction);
+			});
+			break;
+	}
+}
@@ -0,0 +1,453 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "chip8/chip8.h"
+#include "chip8/rom_database/rom_database.h"
+#include "instruction/instruction.h"
+#include "util/pcg32/pcg32.h"
+
+
+/**
+ * @class Chip8Batch
+ *
+ * @brief Runs many copies of the same ROM in lock-step
+ *
+ * @details Each lane is an independent CHIP-8 system. The state of all lanes
+ *          is stored as a structure of arrays: each register, the index
+ *          register, the PC, the timers, and each row of the display is a
+ *          contiguous array with one element per lane. Memory is stored
+ *          per lane, since lanes read and write it at different addresses.
+ *
+ *          Every step, the lanes that are running are grouped by the
+ *          instruction at their PC. Each group is executed by one pass over
+ *          its lanes that is masked to the group, so lanes that share an
+ *          instruction execute together with SIMD operations. Small groups
+ *          execute one lane at a time, as does every lane once most lanes
+ *          have diverged from the first one.
+ *
+ *          A step has the same effect on each lane as chip8::run_cycle with
+ *          virtual timers (see TimerMode::virtual_time), executing one
+ *          instruction. The delay and sound timers count down once every
+ *          (clock rate / 60) instructions. With the display wait quirk, a
+ *          draw counts the instructions up to the next frame, so the lanes'
+ *          instruction counts can differ after the same number of steps. Breakpoints, the JIT, and
+ *          ahead-of-time programs aren't supported. Memory addresses wrap
+ *          around at the end of memory. A lane that calls a subroutine with
+ *          a full stack halts with HaltReason::stack_overflow, and one that
+ *          returns with an empty stack halts with
+ *          HaltReason::invalid_instruction.
+ *
+ *          Only the CHIP-8 instruction set is supported. A lane that reaches
+ *          a SUPER-CHIP instruction, including a 16x16 sprite (Dxy0), halts
+ *          with HaltReason::invalid_instruction.
+ */
+class Chip8Batch {
+public:
+
+    static constexpr size_t display_width  = 64;
+    static constexpr size_t display_height = 32;
+
+    /**
+     * @param[in] lanes  The number of systems to run
+     */
+    explicit Chip8Batch(size_t lanes);
+
+    /// Reset the state of every lane
+    auto reset() -> void;
+
+    /**
+     * @brief Load a ROM into every lane
+     *
+     * @details Resets every lane and loads the ROM. If the file does not exist,
+     *          cannot be opened, or is too large for the memory, then the
+     *          function will exit early without resetting the lanes.
+     *
+     * @param[in] file  The path to the ROM file
+     *
+     * @return True if the file loaded without error, otherwise false.
+     */
+    [[nodiscard]]
+    auto load_rom(const std::filesystem::path& file) -> bool;
+
+    /**
+     * @brief Load a ROM into every lane
+     *
+     * @details Resets every lane and loads the ROM. If the ROM is too large
+     *          for the memory, then the function will exit early without
+     *          resetting the lanes.
+     *
+     * @param[in] rom_data  The list of instructions to write into memory
+     *
+     * @return True if the ROM loaded without error, otherwise false.
+     */
+    [[nodiscard]]
+    auto load_rom(std::span<const uint16_t> rom_data) -> bool;
+
+    /**
+     * @brief Execute one instruction on every lane that isn't paused
+     *
+     * @return The number of lanes that executed an instruction
+     */
+    auto step() -> size_t;
+
+    /**
+     * @brief Execute a number of steps, or until every lane is paused
+     *
+     * @param[in] count  The number of steps to execute
+     *
+     * @return The number of instructions executed across all lanes
+     */
+    auto run(uint64_t count) -> uint64_t;
+
+    /**
+     * @brief Execute steps until every lane reached an instruction count, or is paused
+     *
+     * @details A lane stops once it executed the given number of instructions
+     *          since the last reset, like chip8::run_cycle in a loop that stops
+     *          at the count. A draw that waits for the display can take a lane
+     *          past it.
+     *
+     * @param[in] target  The instruction count to run each lane to
+     *
+     * @return The number of instructions executed across all lanes
+     */
+    auto run_until(uint64_t target) -> uint64_t;
+
+    [[nodiscard]]
+    auto get_lane_count() const noexcept -> size_t {
+        return lanes;
+    }
+
+
+    //--------------------------------------------------------------------------------
+    // Configuration
+    //--------------------------------------------------------------------------------
+
+    [[nodiscard]]
+    auto get_clock_rate() const noexcept -> uint32_t {
+        return clock_rate;
+    }
+    /// @copydoc chip8::set_clock_rate
+    auto set_clock_rate(uint32_t rate) noexcept -> void {
+        if (rate != 0) {
+            clock_rate = std::min(rate, chip8::max_clock_rate);
+        }
+    }
+
+    [[nodiscard]]
+    auto get_clock_mode() const noexcept -> ClockMode {
+        return clock_mode;
+    }
+    auto set_clock_mode(ClockMode mode) noexcept -> void {
+        clock_mode = mode;
+    }
+
+    [[nodiscard]]
+    auto get_instructions_per_frame() const noexcept -> uint32_t {
+        return instructions_per_frame;
+    }
+    /// @copydoc chip8::set_instructions_per_frame
+    auto set_instructions_per_frame(uint32_t count) noexcept -> void {
+        if (count != 0) {
+            instructions_per_frame = std::min(count, chip8::max_instructions_per_frame);
+        }
+    }
+
+    /// @copydoc chip8::get_rom_database
+    [[nodiscard]]
+    auto get_rom_database() const noexcept -> const std::shared_ptr<const RomDatabase>& {
+        return rom_database;
+    }
+
+    /// Set the database of the settings that ROMs need. The quirk profile and instructions per frame of a ROM's entry are applied when it's loaded.
+    auto set_rom_database(std::shared_ptr<const RomDatabase> database) noexcept -> void {
+        rom_database = std::move(database);
+    }
+
+    /// @copydoc chip8::get_quirk_profile
+    [[nodiscard]]
+    auto get_quirk_profile() const noexcept -> QuirkProfile {
+        return quirk_profile;
+    }
+
+    /**
+     * @brief Select the interpreter whose quirks the instructions follow
+     *
+     * @details The quirks are checked once per group of lanes rather than per
+     *          lane.
+     */
+    auto set_quirk_profile(QuirkProfile profile) noexcept -> void {
+        quirk_profile = profile;
+        active_quirks = get_quirks(profile);
+    }
+
+
+    //--------------------------------------------------------------------------------
+    // Lane State
+    //--------------------------------------------------------------------------------
+
+    [[nodiscard]]
+    auto is_paused(size_t lane) const noexcept -> bool {
+        return paused[lane] != 0;
+    }
+
+    /// Pause a lane
+    auto pause(size_t lane) noexcept -> void;
+
+    /// Resume a lane
+    auto resume(size_t lane) noexcept -> void;
+
+    /// Get the reason a lane paused itself. HaltReason::none if it's running or was paused by the user.
+    [[nodiscard]]
+    auto get_halt_reason(size_t lane) const noexcept -> HaltReason {
+        return halt_reason[lane];
+    }
+
+    /// Get the number of instructions a lane executed since the last reset
+    [[nodiscard]]
+    auto get_cycle_count(size_t lane) const noexcept -> uint64_t {
+        return cycle_count[lane];
+    }
+
+    [[nodiscard]]
+    auto get_pc(size_t lane) const noexcept -> uint16_t {
+        return pc[lane];
+    }
+
+    /// Get the value of a lane's index register (i)
+    [[nodiscard]]
+    auto get_index(size_t lane) const noexcept -> uint16_t {
+        return i[lane];
+    }
+
+    /// Get the values of a lane's general purpose registers (v0 - vF)
+    [[nodiscard]]
+    auto get_registers(size_t lane) const noexcept -> std::array<uint8_t, 16>;
+
+    /// Get the return addresses on a lane's stack, from the bottom to the top
+    [[nodiscard]]
+    auto get_stack(size_t lane) const -> std::vector<uint16_t>;
+
+    [[nodiscard]]
+    auto get_memory(size_t lane) const noexcept -> std::span<const uint8_t> {
+        return std::span{memory}.subspan(lane * memory_size, memory_size);
+    }
+
+    [[nodiscard]]
+    auto get_delay_timer(size_t lane) const noexcept -> uint8_t {
+        return delay_timer[lane];
+    }
+
+    [[nodiscard]]
+    auto get_sound_timer(size_t lane) const noexcept -> uint8_t {
+        return sound_timer[lane];
+    }
+
+    /// Get a row of a lane's display. The most significant bit is the pixel at x = 0.
+    [[nodiscard]]
+    auto get_display_row(size_t lane, size_t y) const noexcept -> uint64_t {
+        return display[(y * stride) + lane];
+    }
+
+    /// Check if a pixel of a lane's display is lit
+    [[nodiscard]]
+    auto get_pixel(size_t lane, size_t x, size_t y) const noexcept -> bool {
+        return ((get_display_row(lane, y) >> (display_width - 1 - x)) & 1) != 0;
+    }
+
+    /**
+     * @brief Set the state of a key on a lane
+     *
+     * @details If the lane is waiting for a key press, pressing a key stores
+     *          it in the waiting register and resumes the lane.
+     *
+     * @param[in] lane     The lane to set the key state of
+     * @param[in] key      The key to set the state of
+     * @param[in] pressed  The state of the key
+     */
+    auto set_key_state(size_t lane, Keys key, bool pressed) noexcept -> void;
+
+    /// Get the seed of a lane's random number generator
+    [[nodiscard]]
+    auto get_rng_seed(size_t lane) const noexcept -> uint32_t {
+        return rng_seed[lane];
+    }
+
+    /// @copydoc chip8::set_rng_seed
+    auto set_rng_seed(size_t lane, uint32_t seed) -> void {
+        rng_seed[lane] = seed;
+        rng[lane].seed(seed);
+    }
+
+private:
+
+    // Lanes only run CHIP-8 programs, so they only have the CHIP-8 memory
+    static constexpr size_t memory_size = ::memory_size(Platform::chip8);
+    static constexpr size_t rom_start   = chip8::rom_start;
+
+    // The lane arrays are padded to a multiple of the widest SIMD register (in bytes)
+    static constexpr size_t lane_alignment = 32;
+
+    // Groups of up to this many lanes are executed one lane at a time
+    static constexpr size_t max_scalar_group = 4;
+
+    // The number of return addresses each lane's stack holds, like the stack of a chip8
+    static constexpr size_t stack_levels = chip8_state::stack_size;
+
+    // Marks a lane that isn't waiting for a key press
+    static constexpr uint8_t no_key_wait = 0xFF;
+
+    /// Pause a lane and record the reason
+    auto halt(size_t lane, HaltReason reason) noexcept -> void;
+
+    /// Get the number of instructions per emulated second that the timers are derived from
+    [[nodiscard]]
+    auto get_timer_clock_rate() const noexcept -> uint32_t;
+
+    /// Get a pointer to the first lane of a register
+    [[nodiscard]]
+    auto reg(size_t index) noexcept -> uint8_t* {
+        return v.data() + (index * stride);
+    }
+
+    /// Get a pointer to a lane's memory
+    [[nodiscard]]
+    auto lane_memory(size_t lane) noexcept -> uint8_t* {
+        return memory.data() + (lane * memory_size);
+    }
+
+    /// Reset every lane and copy the ROM into its memory
+    auto load_rom_data(std::span<const uint8_t> data) -> void;
+
+    /// Fetch the instruction of each running lane, mark the lanes to execute, and return their number
+    auto fetch() noexcept -> size_t;
+
+    /// Group the lanes that execute an instruction by the instruction
+    auto group_lanes(size_t begin, size_t end) -> void;
+
+    /**
+     * @brief Execute an instruction on the lanes in [begin, end) that are selected by the mask
+     *
+     * @tparam Single  Execute a group of one lane. The passes over the group are
+     *                 then a single iteration, which avoids the setup of a SIMD loop.
+     */
+    template<bool Single>
+    auto execute(instruction instr, size_t begin, size_t end) -> void;
+
+    /// Advance the timers and instruction counts of the lanes that executed an instruction
+    auto advance_timers() noexcept -> void;
+
+    /// Count the instructions a lane waits for after a draw, up to the next frame (the display wait quirk)
+    auto wait_for_frame(size_t lane) noexcept -> void;
+
+    /// Move the selected lanes to their next instruction
+    auto increment_pc(size_t begin, size_t end) noexcept -> void;
+
+    /// Set vf to 0 on the selected lanes (the VF reset quirk)
+    auto clear_vf(size_t begin, size_t end) noexcept -> void;
+
+    /// Execute a skip instruction. pred(lane) returns true if the lane skips the next instruction.
+    template<typename Pred>
+    auto skip_if(size_t begin, size_t end, Pred&& pred) noexcept -> void;
+
+    /// Execute an instruction one lane at a time. func(lane) executes the instruction on a selected lane.
+    template<typename Func>
+    auto each_lane(size_t begin, size_t end, Func&& func) -> void;
+
+
+    //--------------------------------------------------------------------------------
+    // Configuration
+    //--------------------------------------------------------------------------------
+
+    // The number of lanes, and the number of elements in each per-lane array
+    size_t lanes;
+    size_t stride;
+
+    QuirkProfile quirk_profile = QuirkProfile::xo_chip;
+    quirks active_quirks = get_quirks(QuirkProfile::xo_chip);
+    std::shared_ptr<const RomDatabase> rom_database;
+    uint32_t clock_rate = 500;
+    ClockMode clock_mode = ClockMode::hz;
+    uint32_t instructions_per_frame = 10;
+
+    // One past the last byte of the ROM
+    size_t rom_end = rom_start;
+
+    // Lanes that executed this many instructions don't execute any more (see run_until)
+    uint64_t cycle_limit = std::numeric_limits<uint64_t>::max();
+
+
+    //--------------------------------------------------------------------------------
+    // Lane State
+    //--------------------------------------------------------------------------------
+
+    // Registers. v holds 16 arrays of stride lanes, one for each of v0 - vF.
+    std::vector<uint8_t>  v;
+    std::vector<uint16_t> i;
+    std::vector<uint16_t> pc;
+
+    // Stack. Holds an array of stride lanes for each level.
+    std::vector<uint16_t> stack;
+    std::vector<uint32_t> sp;
+
+    // Timers, and the emulated time since the last tick in units of 1 / (60 * clock rate) seconds
+    std::vector<uint8_t>  delay_timer;
+    std::vector<uint8_t>  sound_timer;
+    std::vector<uint32_t> virtual_time;
+
+    // The display. Holds display_height arrays of stride lanes, one for each row.
+    std::vector<uint64_t> display;
+
+    // Memory. Holds memory_size bytes for each lane.
+    std::vector<uint8_t> memory;
+
+    // A bitmask of the pressed keys, and the register waiting for a key press
+    std::vector<uint16_t> keys;
+    std::vector<uint8_t>  key_register;
+
+    // Execution state. paused is 0 for running lanes.
+    std::vector<uint8_t>    paused;
+    std::vector<HaltReason> halt_reason;
+    std::vector<uint64_t>   cycle_count;
+
+    // The random number generator of each lane, and its seed
+    std::vector<uint32_t>     rng_seed;
+    std::vector<Pcg32>        rng;
+
+
+    //--------------------------------------------------------------------------------
+    // Step State
+    //--------------------------------------------------------------------------------
+
+    // The instruction at each lane's PC
+    std::vector<uint16_t> opcodes;
+
+    // 0xFF for lanes that execute an instruction this step
+    std::vector<uint8_t> executed;
+
+    // The lanes that execute the same instruction, when the lanes have diverged
+    struct lane_group {
+        uint16_t opcode;
+        uint32_t first; //the first lane in the group
+        uint32_t last;  //the last lane in the group
+        uint32_t size;  //the number of lanes in the group
+        uint32_t slot;  //the group's slot in group_slots
+    };
+    std::vector<lane_group> groups;
+
+    // A hash table that maps an instruction to its group. Holds the index of the group plus one, or 0 if the slot is empty.
+    std::vector<uint32_t> group_slots;
+
+    // 0xFF for the lanes in the group being executed
+    std::vector<uint8_t> mask;
+};
@@ -1,40 +1,109 @@
 #include "chip8.h"
+#include "aot/aot_runtime.h"
 #include "isa/isa.h"
+#include "jit/jit.h"
+#include "rom_database/rom_database.h"
+#include "util/fnv1a/fnv1a.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <fstream>
 
 
 chip8::chip8() {
+	// Zero the padding of the state, so equal states have equal bytes
+	std::memset(static_cast<void*>(&state), 0, sizeof(state));
+	state.key_register = chip8_state::no_key_wait;
+
+	// Each instance has its own generator, so instances can run on separate threads
+	state.rng_seed = std::random_device{}();
+
+	ISA::select_engine(*this);
 	reset();
 }
 
 
+chip8::chip8(chip8&&) noexcept = default;
+
+chip8::~chip8() = default;
+
+auto chip8::operator=(chip8&&) noexcept -> chip8& = default;
+
+
 auto chip8::reset() -> void {
 	// Reset registers
-	pc = rom_start;
-	i = 0;
-	v.fill(0);
-
-	// Zero out memory
-	memory.fill(0);
+	state.pc = rom_start;
+	state.i = 0;
+	state.v.fill(0);
+
+	// Zero out the memory of the active platform
+	const size_t size = memory_size(platform);
+	state.address_mask = static_cast<uint16_t>(size - 1);
+	std::fill_n(state.memory.begin(), size, uint8_t{0});
+	dirty_blocks.fill(~uint64_t{0});
+	decode_cache.resize(size);
+	if (jit) {
+		jit->clear();
+	}
+	aot.reset();
 
 	// Reset ROM patch
 	current_rom = std::filesystem::path{};
+	current_rom_info = nullptr;
 	rom_end = rom_start;
+	rom_digest = {};
 
 	// Empty the stack
-	stack.clear();
+	state.stack.fill(0);
+	state.sp = 0;
 
-	// Clear the display
-	display.clear();
+	// Stop waiting for a key press. The keys that are held stay pressed.
+	state.key_register = chip8_state::no_key_wait;
 
-	// Load the font into memory
-	for (size_t i = 0; i < font.size(); ++i) {
-		memory[i] = font[i];
-	}
+	// Clear the RPL user flags. They're reloaded when a ROM is loaded from a file.
+	state.rpl_flags.fill(0);
+
+	state.cycle_count = 0;
+	fusion = fusion_report{};
+	idle_instructions = 0;
+
+	// Restart the random number sequence
+	state.rng.seed(state.rng_seed);
+
+	// Reset the delay and sound timers
+	timer.reset(state.timers);
+
+	// Clear the display, return to the low resolution, and select the first plane
+	state.display.set_hires(false);
+	state.display.set_planes(1);
+
+	// Load the fonts into memory
+	std::ranges::copy(font, state.memory.begin());
+	std::ranges::copy(big_font, state.memory.begin() + big_font_start);
 
 	pause();
+	halt_reason = HaltReason::none;
+}
+
+
+auto chip8::set_platform(Platform new_platform) -> void {
+	platform = new_platform;
+	reset();
+}
+
+
+auto chip8::set_quirk_profile(QuirkProfile profile) -> void {
+	quirk_profile = profile;
+	ISA::select_engine(*this);
+
+	// The decoded and compiled instructions call the handlers of the previous profile
+	decode_cache.clear();
+	if (jit) {
+		jit->clear();
+	}
+	attach_aot_program();
 }
 
 
@@ -46,29 +115,366 @@ auto chip8::pause() noexcept -> void {
 
 auto chip8::resume() noexcept -> void {
 	paused = false;
+	halt_reason = HaltReason::none;
 	//timer.resume();
 }
 
 
+auto chip8::halt(HaltReason reason) noexcept -> void {
+	pause();
+	halt_reason = reason;
+}
+
+
 auto chip8::run_cycle() -> void {
-	// Update timer
-	timer.tick();
+	// Update wall-clock timers
+	if (timer.get_mode() == TimerMode::real_time) {
+		timer.tick(state.timers);
+	}
 
-	if (pc < rom_end) {  //check that the PC is within the ROM's memory region
-		if (breakpoints.contains((pc - rom_start) / 2)) {
-			pause();
+	if (state.pc < rom_end) {  //check that the PC is within the ROM's memory region
+		if (is_at_breakpoint()) {
+			halt(HaltReason::breakpoint);
 		}
 		else {
-			ISA::execute_cycle(*this);
+			// Superinstructions add the extra instructions they execute to the cycle count
+			const uint64_t start_count = state.cycle_count;
+			state.cycle_count += execute();
+
+			if (timer.get_mode() == TimerMode::virtual_time) {
+				timer.advance(state.timers, state.cycle_count - start_count, get_timer_clock_rate());
+			}
 		}
 	}
 	else {
 		std::cout << "PC moved past end of ROM\n";
-		pause();
+		halt(HaltReason::end_of_rom);
+	}
+}
+
+
+auto chip8::step() -> void {
+	if (timer.get_mode() == TimerMode::real_time) {
+		timer.tick(state.timers);
+	}
+
+	if (state.pc >= rom_end) {
+		std::cout << "PC moved past end of ROM\n";
+		halt(HaltReason::end_of_rom);
+		return;
+	}
+
+	// A draw that waits for the display adds the instructions it waits for to the cycle count
+	const uint64_t start_count = state.cycle_count;
+	const auto instr = instruction{state.memory[state.pc], state.memory[state.pc + 1]};
+	(*handlers)[to_index(instr.opcode)](*this, instr);
+	++state.cycle_count;
+
+	if (timer.get_mode() == TimerMode::virtual_time) {
+		timer.advance(state.timers, state.cycle_count - start_count, get_timer_clock_rate());
+	}
+}
+
+
+auto chip8::execute() -> uint32_t {
+	// Compiled blocks don't stop at breakpoints, so only use them when there are none
+	if (aot and breakpoints.empty()) {
+		if (const uint32_t count = aot->execute(*this)) {
+			return count;
+		}
+	}
+
+	if (jit) {
+		return jit->execute(*this);
+	}
+
+	interpret(*this);
+	return 1;
+}
+
+
+auto chip8::instructions_until_frame() const noexcept -> uint64_t {
+	const uint64_t rate = get_timer_clock_rate();
+	if (rate == 0) {
+		return 1;  //the timers never tick at a clock rate of 0
+	}
+
+	const uint64_t frame = (state.cycle_count * 60) / rate;
+
+	// The instruction count at which the virtual timers next tick
+	const uint64_t end = (((frame + 1) * rate) + 59) / 60;
+	return end - state.cycle_count;
+}
+
+
+auto chip8::instructions_until_tick() const noexcept -> uint64_t {
+	// Real-time timers only tick between cycles, so the frames of the instruction count are used instead
+	if (timer.get_mode() != TimerMode::virtual_time) {
+		return instructions_until_frame();
+	}
+
+	// Each instruction adds 60 units to the virtual time, and the timers count down when it reaches the clock rate
+	const uint64_t rate = get_timer_clock_rate();
+	if (state.timers.virtual_time >= rate) {
+		return 1;  //the clock rate was lowered, so the next instruction ticks
+	}
+	return (rate - state.timers.virtual_time + 59) / 60;
+}
+
+
+auto chip8::get_timer_clock_rate() const noexcept -> uint32_t {
+	// In instructions per frame mode, each frame is one 60Hz tick
+	if (clock_mode == ClockMode::instructions_per_frame) {
+		return instructions_per_frame * 60;
+	}
+	return clock_rate;
+}
+
+
+auto chip8::set_jit_enabled(bool state) -> void {
+	if (state and !jit and JIT::is_supported()) {
+		jit = std::make_unique<JIT>(*this);
+	}
+	else if (!state) {
+		jit.reset();
+	}
+}
+
+
+auto chip8::set_aot_enabled(bool state) -> void {
+	aot_enabled = state;
+	attach_aot_program();
+}
+
+
+auto chip8::attach_aot_program() -> void {
+	aot.reset();
+
+	if (!aot_enabled) {
+		return;
+	}
+
+	const auto rom = std::span{state.memory}.subspan(rom_start, rom_end - rom_start);
+	if (const auto* program = find_aot_program(rom, quirk_profile)) {
+		aot = std::make_unique<AOTRuntime>(*program);
+	}
+}
+
+
+auto chip8::get_flags_path() const -> std::filesystem::path {
+	if (flags_directory.empty() or current_rom.empty()) {
+		return {};
+	}
+	return flags_directory / current_rom.stem().concat(".rpl");
+}
+
+
+auto chip8::load_flags() -> void {
+	const auto path = get_flags_path();
+	if (path.empty()) {
+		return;
+	}
+
+	// A ROM that hasn't saved any flags yet has no file
+	std::ifstream file(path, std::ios::binary);
+	if (file) {
+		file.read(reinterpret_cast<char*>(state.rpl_flags.data()), state.rpl_flags.size());
+	}
+}
+
+
+auto chip8::save_flags() const -> void {
+	const auto path = get_flags_path();
+	if (path.empty()) {
+		return;
+	}
+
+	auto error = std::error_code{};
+	std::filesystem::create_directories(flags_directory, error);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "Error saving the RPL flags to " << path << '\n';
+		return;
+	}
+	file.write(reinterpret_cast<const char*>(state.rpl_flags.data()), state.rpl_flags.size());
+}
+
+
+auto chip8::add_breakpoint(uint16_t instruction_number) -> void {
+	breakpoints.insert(instruction_number);
+
+	// Superinstructions and compiled blocks may extend past the new breakpoint
+	decode_cache.clear();
+	if (jit) {
+		jit->clear();
+	}
+}
+
+
+auto chip8::remove_breakpoint(uint16_t instruction_number) -> void {
+	breakpoints.erase(instruction_number);
+
+	decode_cache.clear();
+	if (jit) {
+		jit->clear();
+	}
+}
+
+
+auto chip8::clear_breakpoints() -> void {
+	breakpoints.clear();
+
+	decode_cache.clear();
+	if (jit) {
+		jit->clear();
+	}
+}
+
+
+auto chip8::invalidate_code(size_t address, size_t count) noexcept -> void {
+	// The written bytes wrap around the end of memory like the addresses that were written
+	const auto mark_dirty = [this](size_t byte) noexcept {
+		const size_t block = (byte & state.address_mask) / memory_block_size;
+		dirty_blocks[block / 64] |= uint64_t{1} << (block % 64);
+	};
+	for (size_t offset = 0; offset < count; offset += memory_block_size) {
+		mark_dirty(address + offset);
+	}
+	mark_dirty(address + count - 1);
+
+	const auto discard_code = [this](size_t first, size_t length) noexcept {
+		decode_cache.invalidate(first, length);
+
+		if (jit) {
+			jit->invalidate(first, length);
+		}
+		if (aot) {
+			aot->invalidate(first, length);
+		}
+	};
+
+	// The code is discarded in up to two ranges: up to the end of memory, and the part that wrapped to the start
+	const size_t memory_size = state.address_mask + size_t{1};
+	const size_t start  = address & state.address_mask;
+	const size_t length = std::min(count, memory_size);
+	const size_t before_end = std::min(length, memory_size - start);
+
+	discard_code(start, before_end);
+	if (length > before_end) {
+		discard_code(0, length - before_end);
+	}
+}
+
+
+auto chip8::set_key_state(Keys key, bool pressed) noexcept -> void {
+	const auto bit = static_cast<uint16_t>(1 << static_cast<uint8_t>(key));
+
+	if (pressed) {
+		state.keys |= bit;
+	}
+	else {
+		state.keys &= ~bit;
+	}
+
+	// Complete the key instruction if it's waiting for a key press
+	if (pressed and (state.key_register != chip8_state::no_key_wait)) {
+		state.v[state.key_register] = static_cast<uint8_t>(key);
+		state.key_register = chip8_state::no_key_wait;
+		resume();
+		state.pc += 2;
 	}
 }
 
 
+auto chip8::snapshot(chip8_state& out) const noexcept -> void {
+	std::memcpy(static_cast<void*>(&out), &state, state.size());
+}
+
+
+auto chip8::restore(const chip8_state& snapshot) -> bool {
+	if (snapshot.address_mask != state.address_mask) {
+		std::cout << "Error restoring the state: It has " << (snapshot.address_mask + size_t{1})
+		          << " bytes of memory, but the platform has " << (state.address_mask + size_t{1}) << '\n';
+		return false;
+	}
+
+	// The snapshot may hold different code than the memory did. Only the code in the blocks that
+	// differ is discarded, so restoring a recent snapshot keeps the decoded and compiled code.
+	bool rom_changed = false;
+
+	for (size_t address = 0; address <= state.address_mask; address += memory_block_size) {
+		if (std::memcmp(&state.memory[address], &snapshot.memory[address], memory_block_size) != 0) {
+			invalidate_code(address, memory_block_size);
+			rom_changed |= (address < rom_end) and ((address + memory_block_size) > rom_start);
+		}
+	}
+
+	std::memcpy(static_cast<void*>(&state), &snapshot, snapshot.size());
+	++restore_count;
+
+	// Blocks of the program that were disabled by writes may match it again
+	if (rom_changed) {
+		attach_aot_program();
+	}
+
+	if (state.key_register != chip8_state::no_key_wait) {
+		halt(HaltReason::key_wait);
+	}
+	else if (halt_reason == HaltReason::key_wait) {
+		resume();
+	}
+
+	return true;
+}
+
+
+auto chip8::fork() const -> chip8 {
+	auto copy = chip8{};
+
+	copy.platform = platform;
+	copy.set_quirk_profile(quirk_profile);
+	copy.reset();
+
+	copy.clock_rate = clock_rate;
+	copy.clock_mode = clock_mode;
+	copy.instructions_per_frame = instructions_per_frame;
+	copy.set_timer_mode(get_timer_mode());
+	copy.set_jit_enabled(is_jit_enabled());
+	copy.aot_enabled = aot_enabled;
+	copy.fusion_enabled = fusion_enabled;
+	copy.idle_skip_enabled = idle_skip_enabled;
+
+	copy.current_rom = current_rom;
+	copy.rom_database = rom_database;
+	copy.current_rom_info = current_rom_info;
+	copy.rom_end = rom_end;
+	copy.rom_digest = rom_digest;
+
+	copy.restore(state);
+	copy.paused = paused;
+	copy.halt_reason = halt_reason;
+
+	return copy;
+}
+
+
+auto chip8::hash_state() const noexcept -> uint64_t {
+	const auto* base = reinterpret_cast<const uint8_t*>(&state);
+	const auto& display = state.display;
+
+	// The display is hashed through its contents, leaving out the generation counters
+	const auto rows = display.get_rows();
+	const auto mode = std::array<uint8_t, 2>{display.get_planes(), static_cast<uint8_t>(display.is_hires())};
+	const size_t display_end = offsetof(chip8_state, display) + sizeof(display_t);
+
+	auto hash = fnv1a({base, offsetof(chip8_state, display)});
+	hash = fnv1a(mode, hash);
+	hash = fnv1a({reinterpret_cast<const uint8_t*>(rows.data()), rows.size_bytes()}, hash);
+	return fnv1a({base + display_end, state.size() - display_end}, hash);
+}
+
+
 auto chip8::load_rom(const std::filesystem::path& file) -> bool {
     // Check that file exists
     if (!std::filesystem::exists(file)) {
@@ -76,16 +482,6 @@ auto chip8::load_rom(const std::filesystem::path& file) -> bool {
         return false;
     }
 
-    // Ensure the ROM will fit in the memory
-	const auto file_size = std::filesystem::file_size(file);
-
-    if (file_size > (memory.size() - rom_start)) {
-        std::cout << "The ROM " << file << " is too big to fit in the CHIP8 memory\n"
-                  << "  Memory size: " << (memory.size() - rom_start) << '\n'
-                  << "     ROM size: " << file_size << '\n';
-        return false;
-    }
-
 	// Open the file and check that it's not in an error state
     std::ifstream rom(file, std::ios::binary);
 	if (!rom) {
@@ -93,13 +489,16 @@ auto chip8::load_rom(const std::filesystem::path& file) -> bool {
         return false;
     }
 
-	// Reset the device before loading the ROM
-	reset();
+	// Read the entire file, since the ROM database entry may change the size of the memory
+	const auto data = std::vector<uint8_t>(std::istreambuf_iterator<char>{rom}, std::istreambuf_iterator<char>{});
+
+	if (!load_rom_data(data)) {
+		std::cout << "Error loading ROM " << file << '\n';
+		return false;
+	}
 
-	// Read the entire file contents into the memory array
-    rom.read(reinterpret_cast<char*>(memory.data() + rom_start), file_size);
 	current_rom = file;
-	rom_end = rom_start + file_size;
+	load_flags();
 
 	// Start emulation
 	resume();
@@ -109,29 +508,70 @@ auto chip8::load_rom(const std::filesystem::path& file) -> bool {
 
 
 auto chip8::load_rom(std::span<const uint16_t> rom_data) -> bool {
-	// Ensure the ROM will fit in the memory
-	if (rom_data.size_bytes() > (memory.size() - rom_start)) {
-        std::cout << "The ROM data is too big to fit in the CHIP8 memory\n"
-                  << "  Memory size: " << (memory.size() - rom_start) << '\n'
-                  << "     ROM size: " << rom_data.size_bytes() << '\n';
+	std::vector<uint8_t> data;
+	data.reserve(rom_data.size_bytes());
+
+	for (const uint16_t word : rom_data) {
+		data.push_back(static_cast<uint8_t>(word >> 8));
+		data.push_back(static_cast<uint8_t>(word));
+	}
 
+	if (!load_rom_data(data)) {
 		return false;
 	}
 
-	// Reset the device before loading the ROM
-	reset();
+	resume();
+
+	return true;
+}
+
+
+auto chip8::set_rom_database(std::shared_ptr<const RomDatabase> database) noexcept -> void {
+	rom_database = std::move(database);
+
+	// The entry of the loaded ROM may belong to the previous database, which this instance might have held the last reference to
+	current_rom_info = rom_database ? rom_database->find(rom_digest) : nullptr;
+}
+
+
+auto chip8::load_rom_data(std::span<const uint8_t> data) -> bool {
+	const auto digest = sha1(data);
+	const rom_info* const info = rom_database ? rom_database->find(digest) : nullptr;
 
-	// Write the instructions to memory
-	for (size_t i = 0; i < rom_data.size(); ++i) {
-		const auto idx = rom_start + (i * 2);
-		memory[idx]     = static_cast<uint8_t>(rom_data[i] >> 8);
-		memory[idx + 1] = static_cast<uint8_t>(rom_data[i]);
+	// Ensure the ROM will fit in the memory of the platform it runs on
+	const Platform target = (info and info->platform) ? *info->platform : platform;
+
+	if (data.size() > (memory_size(target) - rom_start)) {
+        std::cout << "The ROM is too big to fit in the CHIP8 memory\n"
+                  << "  Memory size: " << (memory_size(target) - rom_start) << '\n'
+                  << "     ROM size: " << data.size() << '\n';
+		return false;
 	}
 
-	current_rom = std::filesystem::path{};
-	rom_end = rom_start + rom_data.size_bytes();
+	// Apply the settings the ROM was written for. Changing the platform resets the device.
+	if (info) {
+		if (info->platform) {
+			platform = *info->platform;
+		}
+		if (info->quirks and (*info->quirks != quirk_profile)) {
+			set_quirk_profile(*info->quirks);
+		}
+		if (info->instructions_per_frame) {
+			clock_mode = ClockMode::instructions_per_frame;
+			set_instructions_per_frame(*info->instructions_per_frame);
+		}
+	}
 
-	resume();
+	// Reset the device before loading the ROM
+	reset();
+
+	// Copy the ROM into memory
+	std::ranges::copy(data, state.memory.begin() + rom_start);
+	rom_end = rom_start + data.size();
+	rom_digest = digest;
+	current_rom_info = info;
+
+	attach_aot_program();
 
 	return true;
 }
@@ -1,25 +1,151 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <filesystem>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
 #include <span>
+#include <string_view>
 #include <unordered_set>
-#include <vector>
 
+#include "chip8/chip8_state.h"
+#include "chip8/isa/decode_cache.h"
+#include "chip8/isa/fusion.h"
+#include "chip8/isa/quirks.h"
 #include "display/display.h"
 #include "input/input.h"
 #include "timer/chip_timer.h"
+#include "util/sha1/sha1.h"
+
+class AOTRuntime;
+class JIT;
+class RomDatabase;
+struct rom_info;
+
+
+/**
+ * @enum ClockMode
+ * 
+ * @brief How the emulator converts host time into CHIP-8 instructions
+ */
+enum class ClockMode : uint8_t {
+    hz,                     //Execute clock_rate instructions per second
+    instructions_per_frame, //Execute a fixed number of instructions per host frame
+};
+
+
+/**
+ * @enum Platform
+ *
+ * @brief The CHIP-8 variant that the system emulates
+ *
+ * @details The platform selects the size of the memory. The instructions of
+ *          every variant are always decoded.
+ */
+enum class Platform : uint8_t {
+    chip8,   //CHIP-8, with 4 KB of memory
+    schip,   //SUPER-CHIP, with 4 KB of memory
+    xo_chip, //XO-CHIP, with 64 KB of memory
+};
+
+/// Convert a @ref Platform to a string
+[[nodiscard]]
+constexpr auto to_string(Platform platform) noexcept -> std::string_view {
+    switch (platform) {
+        case Platform::chip8:   return "CHIP-8";
+        case Platform::schip:   return "SUPER-CHIP";
+        case Platform::xo_chip: return "XO-CHIP";
+        default:                return "unknown";
+    }
+}
+
+/// Convert a string produced by to_string(Platform) to a @ref Platform
+[[nodiscard]]
+constexpr auto to_platform(std::string_view str) noexcept -> std::optional<Platform> {
+    for (const auto platform : {Platform::chip8, Platform::schip, Platform::xo_chip}) {
+        if (to_string(platform) == str) {
+            return platform;
+        }
+    }
+    return {};
+}
+
+/// Get the size of the memory of a @ref Platform
+[[nodiscard]]
+constexpr auto memory_size(Platform platform) noexcept -> size_t {
+    return (platform == Platform::xo_chip) ? chip8_state::max_memory_size : 4096;
+}
+
+
+/**
+ * @enum HaltReason
+ * 
+ * @brief The reason the system paused itself
+ */
+enum class HaltReason : uint8_t {
+    none,                //Running, or paused by the user
+    breakpoint,          //The PC reached a breakpoint
+    end_of_rom,          //The PC moved past the end of the ROM
+    invalid_instruction, //An instruction couldn't be decoded
+    key_wait,            //Waiting for a key press
+    exited,              //The program executed the exit instruction
+    stack_overflow,      //A subroutine was called with a full stack
+};
+
+/// Convert a @ref HaltReason to a string
+[[nodiscard]]
+constexpr auto to_string(HaltReason reason) noexcept -> std::string_view {
+    switch (reason) {
+        case HaltReason::none:                return "none";
+        case HaltReason::breakpoint:          return "breakpoint";
+        case HaltReason::end_of_rom:          return "end of rom";
+        case HaltReason::invalid_instruction: return "invalid instruction";
+        case HaltReason::key_wait:            return "key wait";
+        case HaltReason::exited:              return "exited";
+        case HaltReason::stack_overflow:      return "stack overflow";
+        default:                              return "unknown";
+    }
+}
 
 
 class chip8 {
+    friend class AOTAccess;
+    friend class AOTRuntime;
+    friend class Chip8Batch;
     friend class ISA;
+    friend class JIT;
     friend class MediaLayer;
+    friend class Movie;
+    friend class MoviePlayer;
+    friend class RunAhead;
+    friend class SaveState;
 
 public:
 
+    using display_t = chip8_state::display_t;
+
+    // The size of the blocks that writes to memory are tracked in (see get_dirty_blocks)
+    static constexpr size_t memory_block_size = 64;
+
+    // The number of 64-bit words in the bitmask of dirty memory blocks
+    static constexpr size_t dirty_block_words = chip8_state::max_memory_size / memory_block_size / 64;
+
+    // The highest clock rate. The emulated time of an instruction is added to times below it in 32 bits (see Chip8Batch).
+    static constexpr uint32_t max_clock_rate = std::numeric_limits<uint32_t>::max() - 60;
+
+    // The most instructions per frame, for which the timer clock rate (60 times the count) is at most max_clock_rate
+    static constexpr uint32_t max_instructions_per_frame = max_clock_rate / 60;
+
     chip8();
+    chip8(chip8&&) noexcept;
+    ~chip8();
+
+    auto operator=(chip8&&) noexcept -> chip8&;
 
     /// Resets the state of the system
 	auto reset() -> void;
@@ -35,9 +161,256 @@ public:
     /// Resume execution
 	auto resume() noexcept -> void;
 
-    /// Run a single cycle of the syystem
+    /// Get the reason the system paused itself. HaltReason::none if it's running or was paused by the user.
+    [[nodiscard]]
+    auto get_halt_reason() const noexcept -> HaltReason {
+        return halt_reason;
+    }
+
+    /**
+     * @brief Run a single cycle of the system
+     * 
+     * @details When the JIT is enabled or the ROM was compiled ahead of time,
+     *          a cycle executes an entire compiled block, which may contain
+     *          multiple instructions.
+     */
     auto run_cycle() -> void;
 
+    /**
+     * @brief Execute exactly one instruction
+     *
+     * @details Unlike run_cycle, superinstructions and compiled blocks aren't
+     *          used and breakpoints are ignored, so the instruction count only
+     *          advances by one instruction (more for a draw that waits for the
+     *          display). The result is the same as executing the instructions
+     *          with run_cycle, which lets the ReverseDebugger re-execute up to
+     *          an exact instruction count.
+     */
+    auto step() -> void;
+
+    /// Get the number of instructions executed since the last reset
+    [[nodiscard]]
+    auto get_cycle_count() const noexcept -> uint64_t {
+        return state.cycle_count;
+    }
+
+    [[nodiscard]]
+    auto get_pc() const noexcept -> uint16_t {
+        return state.pc;
+    }
+
+    /// Get the value of the index register (i)
+    [[nodiscard]]
+    auto get_index() const noexcept -> uint16_t {
+        return state.i;
+    }
+
+    /// Get the values of the general purpose registers (v0 - vF)
+    [[nodiscard]]
+    auto get_registers() const noexcept -> const std::array<uint8_t, 16>& {
+        return state.v;
+    }
+
+    /// Get the return addresses on the stack, from the bottom to the top
+    [[nodiscard]]
+    auto get_stack() const noexcept -> std::span<const uint16_t> {
+        return std::span{state.stack}.first(state.sp);
+    }
+
+    /// Get the memory of the active platform
+    [[nodiscard]]
+    auto get_memory() const noexcept -> std::span<const uint8_t> {
+        return std::span{state.memory}.first(state.address_mask + 1);
+    }
+
+    [[nodiscard]]
+    auto get_display() const noexcept -> const display_t& {
+        return state.display;
+    }
+
+    [[nodiscard]]
+    auto get_delay_timer() const noexcept -> uint8_t {
+        return state.timers.delay;
+    }
+
+    [[nodiscard]]
+    auto get_sound_timer() const noexcept -> uint8_t {
+        return state.timers.sound;
+    }
+
+    /// Get the SUPER-CHIP RPL user flags, which are written and read by the strf and ldf instructions
+    [[nodiscard]]
+    auto get_flags() const noexcept -> const std::array<uint8_t, 16>& {
+        return state.rpl_flags;
+    }
+
+    /// Check if a key is pressed
+    [[nodiscard]]
+    auto is_key_pressed(Keys key) const noexcept -> bool {
+        return state.is_key_pressed(static_cast<uint8_t>(key));
+    }
+
+    /**
+     * @brief Set the state of a key
+     *
+     * @details Pressing a key while the key instruction is waiting for one
+     *          stores the key and resumes execution at the next instruction.
+     *
+     * @param[in] key      The key to set the state of
+     * @param[in] pressed  The state of the key
+     */
+    auto set_key_state(Keys key, bool pressed) noexcept -> void;
+
+    //--------------------------------------------------------------------------------
+    // State
+    //--------------------------------------------------------------------------------
+
+    /// Get the emulated state of the system
+    [[nodiscard]]
+    auto get_state() const noexcept -> const chip8_state& {
+        return state;
+    }
+
+    /**
+     * @brief Copy the emulated state of the system
+     *
+     * @details Only the bytes in use are copied (see chip8_state::size), so a
+     *          snapshot of a 4 KB platform doesn't copy the 64 KB memory.
+     *
+     * @param[out] out  The state to copy into
+     */
+    auto snapshot(chip8_state& out) const noexcept -> void;
+
+    /**
+     * @brief Replace the emulated state of the system with a snapshot
+     *
+     * @details The settings, breakpoints, and loaded ROM are unchanged. The
+     *          memory is compared with the snapshot block by block, and the
+     *          predecoded and compiled instructions of the blocks that differ
+     *          are discarded, like after a write. Restoring a recent snapshot
+     *          (e.g. for run-ahead or reverse debugging) then takes a few
+     *          microseconds and keeps the code warm. A snapshot that is
+     *          waiting for a key press halts the system with
+     *          HaltReason::key_wait.
+     *
+     * @param[in] snapshot  A state copied by snapshot()
+     *
+     * @return True if the state was restored, or false if the snapshot was
+     *         taken on a platform with a different memory size.
+     */
+    auto restore(const chip8_state& snapshot) -> bool;
+
+    /**
+     * @brief Get the number of times the state was restored
+     *
+     * @details The display generation is restored with the pixels, so a
+     *          consumer of the display must also treat a change to this count
+     *          as a change to the pixels.
+     */
+    [[nodiscard]]
+    auto get_restore_count() const noexcept -> uint64_t {
+        return restore_count;
+    }
+
+    /**
+     * @brief Create a copy of the system
+     *
+     * @details The copy has the same state and settings, and the same ROM
+     *          loaded, but no breakpoints. It doesn't persist the RPL user
+     *          flags, so it can run ahead or speculatively without writing
+     *          over the files of this system.
+     */
+    [[nodiscard]]
+    auto fork() const -> chip8;
+
+    /**
+     * @brief Get a 64-bit FNV-1a hash of the bytes of the emulated state in use
+     *
+     * @details The generation counters of the display are left out. They
+     *          count every change to the display since the system was
+     *          created, so they depend on more than the emulated program,
+     *          e.g. on how many times a ROM was loaded.
+     */
+    [[nodiscard]]
+    auto hash_state() const noexcept -> uint64_t;
+
+    /**
+     * @brief Get the blocks of memory that were written since the dirty blocks were last cleared
+     *
+     * @details Memory is tracked in blocks of memory_block_size bytes. Bit b
+     *          of word w is set when block (64 * w) + b was written. Every
+     *          block is dirty after a reset, and the blocks that differ from
+     *          the snapshot are dirty after a restore. Together with the row
+     *          generations of the display, this lets a consumer that copies
+     *          the state every frame (e.g. RewindBuffer) copy only what
+     *          changed.
+     */
+    [[nodiscard]]
+    auto get_dirty_blocks() const noexcept -> std::span<const uint64_t, dirty_block_words> {
+        return dirty_blocks;
+    }
+
+    /// Mark every block of memory as clean
+    auto clear_dirty_blocks() noexcept -> void {
+        dirty_blocks.fill(0);
+    }
+
+    [[nodiscard]]
+    auto get_flags_directory() const noexcept -> const std::filesystem::path& {
+        return flags_directory;
+    }
+
+    /**
+     * @brief Set the directory that the RPL user flags are persisted in
+     *
+     * @details When set, the flags of a ROM loaded from a file are read from
+     *          <directory>/<rom name>.rpl when the ROM is loaded, and written
+     *          there whenever the ROM stores them. The flags aren't persisted
+     *          when the directory is empty, which is the default.
+     */
+    auto set_flags_directory(const std::filesystem::path& directory) -> void {
+        flags_directory = directory;
+    }
+
+    /// Get the path of the loaded ROM. Empty if no ROM is loaded, or if the ROM wasn't loaded from a file.
+    [[nodiscard]]
+    auto get_current_rom() const noexcept -> const std::filesystem::path& {
+        return current_rom;
+    }
+
+    [[nodiscard]]
+    auto get_rom_database() const noexcept -> const std::shared_ptr<const RomDatabase>& {
+        return rom_database;
+    }
+
+    /**
+     * @brief Set the database of the settings that ROMs need
+     *
+     * @details When set, each ROM that is loaded is looked up in the database
+     *          by its hash. The platform, quirk profile, and instructions per
+     *          frame of its entry are applied before the ROM is loaded, and
+     *          replace the current settings. Settings that the entry doesn't
+     *          specify, and every setting of a ROM that isn't in the database,
+     *          are left unchanged. The database may be shared between instances.
+     *
+     *          The loaded ROM is looked up again in the new database, so
+     *          get_rom_info never refers to an entry of a previous database.
+     *          Its settings are only applied the next time it's loaded.
+     */
+    auto set_rom_database(std::shared_ptr<const RomDatabase> database) noexcept -> void;
+
+    /// Get the SHA-1 digest of the loaded ROM. All zeroes if no ROM is loaded.
+    [[nodiscard]]
+    auto get_rom_digest() const noexcept -> const sha1_digest& {
+        return rom_digest;
+    }
+
+    /// Get the database entry of the loaded ROM. Null if there is no database, or the ROM isn't in it.
+    [[nodiscard]]
+    auto get_rom_info() const noexcept -> const rom_info* {
+        return current_rom_info;
+    }
+
     /**
      * @brief Load a ROM into memory
      * 
@@ -45,6 +418,9 @@ public:
      *          If the file does not exist, cannot be opened, or is
      *          too large for the memory, then the function will exit
      *          early without resetting the system.
+     *
+     *          The settings recorded in the ROM database are applied
+     *          first (see set_rom_database).
      * 
      * @param[in] file  The path to the ROM file
      * 
@@ -59,6 +435,7 @@ public:
      * @details Resets the state of the system and loads the ROM.
      *          If the ROM is too large for the memory, then the
      *          function will exit early without resetting the system.
+     *          The settings recorded in the ROM database are applied first.
      *
      * @param[in] instructions  The list of instructions to write into memory
      * 
@@ -71,89 +448,338 @@ public:
     auto get_clock_rate() const noexcept -> uint32_t {
         return clock_rate;
     }
+    /// Set the clock rate in Hz. A rate of 0 is ignored, and a rate above max_clock_rate is limited to it.
     auto set_clock_rate(uint32_t rate) noexcept -> void {
-        clock_rate = rate;
+        if (rate != 0) {
+            clock_rate = std::min(rate, max_clock_rate);
+        }
     }
 
-    /// Get the legacy mode status. Legacy mode changes the behavior of certain instructions. Newer ROMS might not expect legacy behavior.
     [[nodiscard]]
-    auto is_legacy_mode() const noexcept -> bool {
-        return legacy_mode;
+    auto get_clock_mode() const noexcept -> ClockMode {
+        return clock_mode;
+    }
+    auto set_clock_mode(ClockMode mode) noexcept -> void {
+        clock_mode = mode;
     }
 
-    /// Enable/disable legacy mode, which changes the behavior of certain instructions. Newer ROMS might not expect legacy behavior.
-    auto set_legacy_mode(bool state) noexcept -> void {
-        legacy_mode = state;
+    /// Get the number of instructions executed per host frame when the clock mode is ClockMode::instructions_per_frame
+    [[nodiscard]]
+    auto get_instructions_per_frame() const noexcept -> uint32_t {
+        return instructions_per_frame;
+    }
+    /// Set the number of instructions per frame. A count of 0 is ignored, and a count above max_instructions_per_frame is limited to it.
+    auto set_instructions_per_frame(uint32_t count) noexcept -> void {
+        if (count != 0) {
+            instructions_per_frame = std::min(count, max_instructions_per_frame);
+        }
+    }
+
+    [[nodiscard]]
+    auto get_platform() const noexcept -> Platform {
+        return platform;
     }
 
     /**
-    * @brief Add a breakpoint at the specified instruction number
-    * @param instruction_number  The instruction number to break at. 0 specifies the first instruction in the ROM.
-    */
-    auto add_breakpoint(uint16_t instruction_number) -> void {
-        breakpoints.insert(instruction_number);
+     * @brief Select the CHIP-8 variant to emulate
+     *
+     * @details Resets the system, since the size of the memory may change.
+     *          The memory is 4 KB for CHIP-8 and SUPER-CHIP, and 64 KB for
+     *          XO-CHIP. Addresses are wrapped to the size of the memory.
+     */
+    auto set_platform(Platform new_platform) -> void;
+
+    /// Get the quirk profile that the instructions follow
+    [[nodiscard]]
+    auto get_quirk_profile() const noexcept -> QuirkProfile {
+        return quirk_profile;
+    }
+
+    /**
+     * @brief Select the interpreter whose quirks the instructions follow
+     *
+     * @details The interpreter is compiled once for each profile, and the
+     *          engine for the new profile is selected here rather than the
+     *          instructions checking the profile as they execute. ROMs are
+     *          written for a particular interpreter, and may not work with
+     *          the quirks of another one. The default is QuirkProfile::xo_chip.
+     */
+    auto set_quirk_profile(QuirkProfile profile) -> void;
+
+    [[nodiscard]]
+    auto get_timer_mode() const noexcept -> TimerMode {
+        return timer.get_mode();
+    }
+
+    /**
+     * @brief Select the time source of the delay and sound timers
+     * 
+     * @details In TimerMode::virtual_time, the timers count down once every
+     *          (clock rate / 60) executed instructions instead of following the
+     *          wall clock. Runs are then reproducible, independent of host
+     *          speed, and can run faster than real time.
+     */
+    auto set_timer_mode(TimerMode mode) noexcept -> void {
+        timer.set_mode(mode, state.timers);
+    }
+
+    /// Get the seed of the random number generator used by the rnd instruction
+    [[nodiscard]]
+    auto get_rng_seed() const noexcept -> uint32_t {
+        return state.rng_seed;
+    }
+
+    /**
+     * @brief Seed the random number generator used by the rnd instruction
+     * 
+     * @details The generator is also reseeded with this value whenever the
+     *          system is reset, so a run with the same ROM and seed always
+     *          produces the same random numbers, on every host. The seed is
+     *          part of the emulated state, so snapshots record it. The default
+     *          seed is random.
+     */
+    auto set_rng_seed(uint32_t seed) -> void {
+        state.rng_seed = seed;
+        state.rng.seed(seed);
+    }
+
+    /// Check if the JIT compiler is enabled
+    [[nodiscard]]
+    auto is_jit_enabled() const noexcept -> bool {
+        return jit != nullptr;
+    }
+
+    /// Enable/disable the JIT compiler. Has no effect if the JIT isn't supported on the host (see JIT::is_supported).
+    auto set_jit_enabled(bool state) -> void;
+
+    /// Check if an ahead-of-time compiled program is being used for the loaded ROM
+    [[nodiscard]]
+    auto is_aot_active() const noexcept -> bool {
+        return aot != nullptr;
+    }
+
+    [[nodiscard]]
+    auto is_aot_enabled() const noexcept -> bool {
+        return aot_enabled;
+    }
+
+    /**
+     * @brief Enable/disable ahead-of-time compiled programs
+     * 
+     * @details When enabled, loading a ROM that was compiled by the chip8_aot
+     *          tool and linked into the executable runs the compiled program
+     *          instead of the interpreter or JIT. Takes precedence over the JIT.
+     */
+    auto set_aot_enabled(bool state) -> void;
+
+    /// Check if superinstruction fusion is enabled
+    [[nodiscard]]
+    auto is_fusion_enabled() const noexcept -> bool {
+        return fusion_enabled;
+    }
+
+    /// Enable/disable the fusion of common instruction sequences into superinstructions (see FusedOp)
+    auto set_fusion_enabled(bool state) noexcept -> void {
+        fusion_enabled = state;
+        decode_cache.clear();
+    }
+
+    /// Get the number of instructions executed by superinstructions since the ROM was loaded
+    [[nodiscard]]
+    auto get_fusion_report() const noexcept -> const fusion_report& {
+        return fusion;
     }
-    auto remove_breakpoint(uint16_t instruction_number) -> void {
-        breakpoints.erase(instruction_number);
+
+    /// Check if idle loops are skipped
+    [[nodiscard]]
+    auto is_idle_skip_enabled() const noexcept -> bool {
+        return idle_skip_enabled;
     }
-    auto clear_breakpoints() -> void {
-        breakpoints.clear();
+
+    /**
+     * @brief Enable/disable skipping the iterations of idle loops
+     *
+     * @details The interpreter recognizes loops that poll the delay timer or
+     *          a key and change nothing else while they wait, such as
+     *          `gdly vx; se vx 0; jmp` or `jmp` to itself. Neither the timers
+     *          nor the keys change within a cycle, so every iteration of such
+     *          a loop up to the next 60Hz timer tick has the same result, and
+     *          the cycle counts them all at once instead of executing them.
+     *          The state is identical to executing each iteration, only the
+     *          host time is saved. Only the table and switch interpreters skip
+     *          idle loops, not the JIT or ahead-of-time programs. Enabled by
+     *          default, and can be disabled to compare against.
+     */
+    auto set_idle_skip_enabled(bool state) noexcept -> void {
+        idle_skip_enabled = state;
+        decode_cache.clear();
     }
 
+    /// Get the number of instructions that idle loops were skipped for since the ROM was loaded
+    [[nodiscard]]
+    auto get_idle_instructions() const noexcept -> uint64_t {
+        return idle_instructions;
+    }
+
+    /**
+    * @brief Add a breakpoint at the specified instruction number
+    * @param instruction_number  The instruction number to break at. 0 specifies the first instruction in the ROM.
+    */
+    auto add_breakpoint(uint16_t instruction_number) -> void;
+    auto remove_breakpoint(uint16_t instruction_number) -> void;
+    auto clear_breakpoints() -> void;
+
     [[nodiscard]]
     auto get_breakpoints() const noexcept -> const std::unordered_set<uint16_t>& {
         return breakpoints;
     }
 
+    /// Check if the PC is at a breakpoint
+    [[nodiscard]]
+    auto is_at_breakpoint() const -> bool {
+        return breakpoints.contains((state.pc - rom_start) / 2);
+    }
+
+    /**
+     * @brief Notify the system that memory was modified
+     * 
+     * @details Discards any predecoded instructions that overlap the written bytes,
+     *          and marks their blocks as dirty. This must be called after every
+     *          write to memory.
+     * 
+     * @param[in] address  The first address that was written
+     * @param[in] count    The number of bytes that were written
+     */
+    auto invalidate_code(size_t address, size_t count = 1) noexcept -> void;
+
 private:
 
+    /// Pause execution and record the reason
+    auto halt(HaltReason reason) noexcept -> void;
+
+    /// Execute the next instruction or compiled block, and return the number of instructions executed
+    auto execute() -> uint32_t;
+
+    /// Get the number of instructions per emulated second that the virtual timers are derived from
+    [[nodiscard]]
+    auto get_timer_clock_rate() const noexcept -> uint32_t;
+
+    /// Get the number of instructions left until the next 60Hz frame, including the current one
+    [[nodiscard]]
+    auto instructions_until_frame() const noexcept -> uint64_t;
+
+    /// Get the number of instructions that execute before the timers next count down, including the current one
+    [[nodiscard]]
+    auto instructions_until_tick() const noexcept -> uint64_t;
+
+    /// Apply the database settings of a ROM and reset, then copy the ROM into memory. Returns false if it doesn't fit.
+    [[nodiscard]]
+    auto load_rom_data(std::span<const uint8_t> data) -> bool;
+
+    /// Use the registered ahead-of-time compiled program for the loaded ROM, if there is one
+    auto attach_aot_program() -> void;
+
+    /// Get the file the RPL user flags of the loaded ROM are persisted in. Empty if they aren't persisted.
+    [[nodiscard]]
+    auto get_flags_path() const -> std::filesystem::path;
+
+    /// Read the RPL user flags of the loaded ROM from disk, if they were saved
+    auto load_flags() -> void;
+
+    /// Write the RPL user flags of the loaded ROM to disk
+    auto save_flags() const -> void;
+
     //--------------------------------------------------------------------------------
     // Execution State
     //--------------------------------------------------------------------------------
 
-    // Enables legacy mode. Modifies the behavior of some instructions that
-    // function differently according to the S-CHIP documentation.
-    bool legacy_mode = true;
+    // The emulated CHIP-8 variant
+    Platform platform = Platform::chip8;
+
+    // The interpreter whose quirks the instructions follow
+    QuirkProfile quirk_profile = QuirkProfile::xo_chip;
+
+    // The interpreter instantiated for the quirk profile, and its handler for each
+    // opcode. Both are set by ISA::select_engine.
+    auto (*interpret)(chip8&) -> void = nullptr;
+    const std::array<instruction_handler, opcode_count>* handlers = nullptr;
 
 	// The currently loaded ROM and its size
 	std::filesystem::path current_rom;
 
+    // The settings of known ROMs, and the entry of the loaded ROM
+    std::shared_ptr<const RomDatabase> rom_database;
+    const rom_info* current_rom_info = nullptr;
+
 	// Pauses execution when true
 	bool paused = false;
 
+    // The reason the system paused itself
+    HaltReason halt_reason = HaltReason::none;
+
     // The clock speed in Hz
     uint32_t clock_rate = 500;
 
+    // Selects whether the clock rate or the instructions per frame limit the execution rate
+    ClockMode clock_mode = ClockMode::hz;
+
+    // The number of instructions executed per host frame in ClockMode::instructions_per_frame
+    uint32_t instructions_per_frame = 10;
+
     // Instruction numbers to pause execution at
     std::unordered_set<uint16_t> breakpoints;
 
+    // The JIT compiler. Null when the JIT is disabled.
+    std::unique_ptr<JIT> jit;
+
+    // The ahead-of-time compiled program for the loaded ROM. Null if there isn't one.
+    std::unique_ptr<AOTRuntime> aot;
+
+    // Uses ahead-of-time compiled programs for ROMs that have one when true
+    bool aot_enabled = true;
+
+    // Replaces common instruction sequences with superinstructions when true
+    bool fusion_enabled = true;
+
+    // Skips the iterations of idle loops up to the next timer tick when true
+    bool idle_skip_enabled = true;
+
+    // The instructions executed by superinstructions since the last reset
+    fusion_report fusion;
+
+    // The instructions that idle loops were skipped for since the last reset
+    uint64_t idle_instructions = 0;
+
 
     //--------------------------------------------------------------------------------
     // Processor State
     //--------------------------------------------------------------------------------
 
-    // System memory
-    std::array<uint8_t, 4096> memory;
+    // The memory, registers, and devices. Addresses computed from i are ANDed
+    // with state.address_mask, which wraps them to the active memory.
+    static constexpr size_t max_memory_size = chip8_state::max_memory_size;
+    chip8_state state;
 	static const size_t rom_start = 512;
-    size_t rom_end = rom_start;
-
-    // Registers
-    uint16_t pc = rom_start;
-    uint16_t i = 0;
-    std::array<uint8_t, 16> v;
 
-    // Stack
-    std::vector<uint16_t> stack;
+    // Predecoded instructions for each memory address
+    DecodeCache decode_cache;
 
-    // Input handler
-    Input input;
+    // The end of the loaded ROM in memory, and the SHA-1 digest of its contents
+    size_t rom_end = rom_start;
+    sha1_digest rom_digest = {};
 
-    // Display
-    Display<64, 32> display;
+    // The directory the RPL user flags are persisted in
+    std::filesystem::path flags_directory;
 
-    // Delay and Sound timers
+    // The host clock that drives the delay and sound timers
     Chip8Timer timer;
 
+    // The number of snapshots that replaced the state
+    uint64_t restore_count = 0;
+
+    // A bit for each block of memory that was written since the bits were last cleared
+    std::array<uint64_t, dirty_block_words> dirty_blocks = {};
+
     // Font
     static inline const std::array<uint8_t, 80> font = {
         0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
@@ -173,4 +799,25 @@ private:
         0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
         0xF0, 0x80, 0xF0, 0x80, 0x80  // F
     };
+
+    // SUPER-CHIP large font, which is loaded into memory after the font
+    static constexpr size_t big_font_start = 80;
+    static inline const std::array<uint8_t, 160> big_font = {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+    };
 };
\ No newline at end of file
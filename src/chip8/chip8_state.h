@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "display/display.h"
+#include "input/input.h"
+#include "timer/chip_timer.h"
+#include "util/pcg32/pcg32.h"
+
+
+/**
+ * @struct chip8_state
+ *
+ * @brief The emulated state of a @ref chip8
+ *
+ * @details Everything a program can observe or change is kept in this
+ *          fixed-size, trivially copyable struct: the memory, registers,
+ *          stack, timers, display, keys, and random number generator. The
+ *          settings of the host, such as the clock rate or the breakpoints,
+ *          and the caches derived from the memory are kept in the chip8.
+ *
+ *          A snapshot, restore, or comparison is a single copy or comparison
+ *          of bytes. The memory is the last member, and only the memory of
+ *          the active platform is used, so only the first size() bytes need
+ *          to be copied. That's about 6 KB for CHIP-8 and SUPER-CHIP.
+ *
+ *          A chip8 zeroes its state before initializing it, and only assigns
+ *          its members after that, so the padding bytes are always zero and
+ *          the bytes of two equal states are equal.
+ */
+struct chip8_state {
+    using display_t = Display<128, 64>;
+
+    // The size of the largest memory of any platform (XO-CHIP)
+    static constexpr size_t max_memory_size = 65536;
+
+    // The number of return addresses the stack holds
+    static constexpr size_t stack_size = 16;
+
+    // The value of key_register when no instruction is waiting for a key press
+    static constexpr uint8_t no_key_wait = 0xFF;
+
+    /// Get the number of bytes that are in use, which is the size of the state up to the end of the active memory
+    [[nodiscard]]
+    auto size() const noexcept -> size_t;
+
+    /// Check if a key is pressed. Values that aren't a key are never pressed.
+    [[nodiscard]]
+    auto is_key_pressed(uint8_t key) const noexcept -> bool {
+        return (key < 16) and (((keys >> key) & 1) != 0);
+    }
+
+    // The number of instructions executed since the last reset
+    uint64_t cycle_count;
+
+    // Delay and sound timers
+    timer_state timers;
+
+    // The random number generator used by the rnd instruction, and the seed
+    // it restarts from on reset. The seed is saved with the rest of the state,
+    // so a restored state repeats the same sequence after a reset.
+    Pcg32 rng;
+    uint32_t rng_seed;
+
+    // Display
+    display_t display;
+
+    // Registers
+    uint16_t pc;
+    uint16_t i;
+    std::array<uint8_t, 16> v;
+
+    // Stack of return addresses, and the number of addresses on it
+    std::array<uint16_t, stack_size> stack;
+    uint8_t sp;
+
+    // The register that the key instruction is waiting to store a key press in, or no_key_wait
+    uint8_t key_register;
+
+    // A bitmask of the pressed keys. Bit n is set when key n is pressed.
+    uint16_t keys;
+
+    // SUPER-CHIP RPL user flags
+    std::array<uint8_t, 16> rpl_flags;
+
+    // Addresses computed from i are ANDed with the address mask, which wraps them to the active memory
+    uint16_t address_mask;
+
+    // System memory. Large enough for every platform, but only the first address_mask + 1 bytes are used.
+    std::array<uint8_t, max_memory_size> memory;
+};
+
+static_assert(std::is_trivially_copyable_v<chip8_state>, "The state must be copyable as bytes");
+static_assert(std::is_standard_layout_v<chip8_state>, "The size of the state is computed with offsetof");
+
+
+inline auto chip8_state::size() const noexcept -> size_t {
+    return offsetof(chip8_state, memory) + address_mask + size_t{1};
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "instruction/instruction.h"
+
+class chip8;
+
+
+/// A function which executes a decoded instruction
+using instruction_handler = auto(*)(chip8&, instruction) -> void;
+
+
+/**
+ * @struct decoded_instruction
+ * @brief  An instruction that has been decoded, along with the function that executes it.
+ */
+struct decoded_instruction {
+    // The function which executes the instruction. Null if the entry hasn't been decoded.
+    instruction_handler handler = nullptr;
+
+    // The unpacked instruction. For a fused entry, the opcode is Opcodes::invalid
+    // and the arguments hold the operands of the fused sequence.
+    instruction instr = instruction{Opcodes::invalid, 0};
+};
+
+
+/**
+ * @class DecodeCache
+ *
+ * @brief Holds a predecoded instruction for every address in the CHIP-8 memory
+ *
+ * @details Entries are filled lazily by the interpreter the first time the
+ *          instruction at an address is executed. Any write to memory must
+ *          invalidate the entries that overlap the written bytes, so that
+ *          self-modifying programs are decoded again.
+ *
+ *          An entry may hold a superinstruction which executes a sequence of
+ *          instructions starting at its address (see FusedOp).
+ *
+ *          The cache is sized to the memory of the active platform, so a
+ *          4 KB program doesn't pay for clearing the 64 KB XO-CHIP memory.
+ */
+class DecodeCache {
+public:
+
+    /**
+     * @brief Set the size of the memory that this cache mirrors
+     *
+     * @details Every entry is invalidated.
+     *
+     * @param[in] memory_size  The number of bytes of memory
+     */
+    auto resize(size_t memory_size) -> void {
+        entries.assign(memory_size, decoded_instruction{});
+    }
+
+    /**
+     * @brief Get the cache entry for an address
+     *
+     * @param[in] address  The memory address of the instruction
+     *
+     * @return The entry for the address. The handler is null if it hasn't been decoded.
+     */
+    [[nodiscard]]
+    auto operator[](size_t address) noexcept -> decoded_instruction& {
+        return entries[address];
+    }
+
+    /// The maximum number of bytes an entry is decoded from. Fused entries span up to 3 instructions.
+    static constexpr size_t max_entry_size = 6;
+
+    /**
+     * @brief Invalidate the entries affected by a memory write
+     *
+     * @details An entry may be decoded from up to @ref max_entry_size bytes,
+     *          so entries that begin shortly before the written range are
+     *          also invalidated.
+     *
+     * @param[in] address  The first address that was written
+     * @param[in] count    The number of bytes that were written
+     */
+    auto invalidate(size_t address, size_t count = 1) noexcept -> void {
+        const size_t first = (address >= max_entry_size) ? (address - max_entry_size + 1) : 0;
+        const size_t last  = std::min(address + count, entries.size());
+
+        for (size_t addr = first; addr < last; ++addr) {
+            entries[addr].handler = nullptr;
+        }
+    }
+
+    /// Invalidate every entry
+    auto clear() noexcept -> void {
+        std::fill(entries.begin(), entries.end(), decoded_instruction{});
+    }
+
+private:
+
+    std::vector<decoded_instruction> entries;
+};
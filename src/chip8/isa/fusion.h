@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <string_view>
+
+
+/**
+ * @enum FusedOp
+ *
+ * @brief Common instruction sequences that the interpreter executes as a single superinstruction
+ */
+enum class FusedOp : uint8_t {
+    gdly_se_jmp, //gdly vx; se vy nn; jmp nnn  (delay timer wait loop)
+    mov_add_i,   //mov vx nn; add i vy
+    se_nn_jmp,   //se vx nn; jmp nnn
+    sne_nn_jmp,  //sne vx nn; jmp nnn
+    se_vy_jmp,   //se vx vy; jmp nnn
+    sne_vy_jmp,  //sne vx vy; jmp nnn
+};
+
+/// The number of values in @ref FusedOp
+inline constexpr size_t fused_op_count = 6;
+
+
+/**
+ * @brief Convert a @ref FusedOp to a string
+ *
+ * @param[in] op  The fused operation
+ *
+ * @return The instruction sequence that the operation replaces
+ */
+[[nodiscard]]
+constexpr auto to_string(FusedOp op) noexcept -> std::string_view {
+    switch (op) {
+        case FusedOp::gdly_se_jmp: return "gdly vx; se vy nn; jmp nnn";
+        case FusedOp::mov_add_i:   return "mov vx nn; add i vy";
+        case FusedOp::se_nn_jmp:   return "se vx nn; jmp nnn";
+        case FusedOp::sne_nn_jmp:  return "sne vx nn; jmp nnn";
+        case FusedOp::se_vy_jmp:   return "se vx vy; jmp nnn";
+        case FusedOp::sne_vy_jmp:  return "sne vx vy; jmp nnn";
+        default:                   return "invalid";
+    }
+}
+
+
+/**
+ * @struct fusion_report
+ * @brief  Counts the instructions that were executed by superinstructions since the last reset
+ */
+struct fusion_report {
+    /// The number of times each fused operation was executed
+    std::array<uint64_t, fused_op_count> dispatches = {};
+
+    /// The number of CHIP-8 instructions executed by each fused operation
+    std::array<uint64_t, fused_op_count> instructions = {};
+
+    /// Get the total number of CHIP-8 instructions executed by fused operations
+    [[nodiscard]]
+    auto total_instructions() const noexcept -> uint64_t {
+        return std::accumulate(instructions.begin(), instructions.end(), uint64_t{0});
+    }
+
+    /// Record an execution of a fused operation
+    auto record(FusedOp op, uint64_t instruction_count) noexcept -> void {
+        dispatches[static_cast<size_t>(op)]   += 1;
+        instructions[static_cast<size_t>(op)] += instruction_count;
+    }
+};
@@ -1,17 +1,415 @@
 #include "isa.h"
 #include "../chip8.h"
 
+#include <cstdlib>
+#include <format>
+#include <iostream>
 #include <random>
 
+#if defined(CHIP8_DISPATCH_MAP)
+#include <functional>
+#include <unordered_map>
+#endif
+
+
+//----------------------------------------------------------------------------------
+// Engines
+//----------------------------------------------------------------------------------
+//
+// The interpreter is instantiated once for each quirk profile. The profile is
+// converted to its quirks here, and the rest of the interpreter only sees the
+// quirks as a template argument.
+//
+//----------------------------------------------------------------------------------
+
+auto ISA::select_engine(chip8& chip) noexcept -> void {
+	switch (chip.quirk_profile) {
+		case QuirkProfile::cosmac_vip:
+			use_engine<get_quirks(QuirkProfile::cosmac_vip)>(chip);
+			break;
+
+		case QuirkProfile::schip:
+			use_engine<get_quirks(QuirkProfile::schip)>(chip);
+			break;
+
+		case QuirkProfile::xo_chip:
+		default:
+			use_engine<get_quirks(QuirkProfile::xo_chip)>(chip);
+			break;
+	}
+}
+
+
+template<quirks Quirks>
+auto ISA::use_engine(chip8& chip) noexcept -> void {
+	chip.interpret = execute_cycle<Quirks>;
+	chip.handlers  = &get_handler_table<Quirks>();
+}
+
+
+template<quirks Quirks>
+auto ISA::get_handler_table() noexcept -> const handler_table_t& {
+	static constexpr auto table = [] {
+		auto table = handler_table_t{};
+		table[to_index(Opcodes::cls)]         = cls;
+		table[to_index(Opcodes::ret)]         = ret;
+		table[to_index(Opcodes::sys_nnn)]     = sys_nnn;
+		table[to_index(Opcodes::jmp_nnn)]     = jmp_nnn;
+		table[to_index(Opcodes::call_nnn)]    = call_nnn;
+		table[to_index(Opcodes::se_vx_nn)]    = se_vx_nn;
+		table[to_index(Opcodes::sne_vx_nn)]   = sne_vx_nn;
+		table[to_index(Opcodes::se_vx_vy)]    = se_vx_vy;
+		table[to_index(Opcodes::mov_vx_nn)]   = mov_vx_nn;
+		table[to_index(Opcodes::add_vx_nn)]   = add_vx_nn;
+		table[to_index(Opcodes::mov_vx_vy)]   = mov_vx_vy;
+		table[to_index(Opcodes::or_vx_vy)]    = or_vx_vy<Quirks>;
+		table[to_index(Opcodes::and_vx_vy)]   = and_vx_vy<Quirks>;
+		table[to_index(Opcodes::xor_vx_vy)]   = xor_vx_vy<Quirks>;
+		table[to_index(Opcodes::add_vx_vy)]   = add_vx_vy;
+		table[to_index(Opcodes::sub_vx_vy)]   = sub_vx_vy;
+		table[to_index(Opcodes::shr_vx)]      = shr_vx<Quirks>;
+		table[to_index(Opcodes::subn_vx_vy)]  = subn_vx_vy;
+		table[to_index(Opcodes::shl_vx)]      = shl_vx<Quirks>;
+		table[to_index(Opcodes::sne_vx_vy)]   = sne_vx_vy;
+		table[to_index(Opcodes::mov_i_nnn)]   = mov_i_nnn;
+		table[to_index(Opcodes::jmp_v0_nnn)]  = jmp_v0_nnn<Quirks>;
+		table[to_index(Opcodes::rnd_vx_nn)]   = rnd_vx_nn;
+		table[to_index(Opcodes::drw_vx_vy_n)] = drw_vx_vy_n<Quirks>;
+		table[to_index(Opcodes::skp_vx)]      = skp_vx;
+		table[to_index(Opcodes::sknp_vx)]     = sknp_vx;
+		table[to_index(Opcodes::gdly_vx)]     = gdly_vx;
+		table[to_index(Opcodes::key_vx)]      = key_vx;
+		table[to_index(Opcodes::sdly_vx)]     = sdly_vx;
+		table[to_index(Opcodes::ssnd_vx)]     = ssnd_vx;
+		table[to_index(Opcodes::add_i_vx)]    = add_i_vx;
+		table[to_index(Opcodes::font_vx)]     = font_vx;
+		table[to_index(Opcodes::bcd_vx)]      = bcd_vx;
+		table[to_index(Opcodes::str_v0_vx)]   = str_v0_vx<Quirks>;
+		table[to_index(Opcodes::ld_v0_vx)]    = ld_v0_vx<Quirks>;
+		table[to_index(Opcodes::scd_n)]       = scd_n;
+		table[to_index(Opcodes::scr)]         = scr;
+		table[to_index(Opcodes::scl)]         = scl;
+		table[to_index(Opcodes::exit)]        = exit;
+		table[to_index(Opcodes::low)]         = low;
+		table[to_index(Opcodes::high)]        = high;
+		table[to_index(Opcodes::hfont_vx)]    = hfont_vx;
+		table[to_index(Opcodes::strf_vx)]     = strf_vx;
+		table[to_index(Opcodes::ldf_vx)]      = ldf_vx;
+		table[to_index(Opcodes::save_vx_vy)]  = save_vx_vy;
+		table[to_index(Opcodes::load_vx_vy)]  = load_vx_vy;
+		table[to_index(Opcodes::mov_i_nnnn)]  = mov_i_nnnn;
+		table[to_index(Opcodes::plane_x)]     = plane_x;
+		table[to_index(Opcodes::invalid)]     = invalid;
+		return table;
+	}();
+
+	return table;
+}
+
 
+template<quirks Quirks>
 auto ISA::execute_cycle(chip8& chip) -> void {
-	const auto instr = instruction{chip.memory[chip.pc], chip.memory[chip.pc+1]};
-    opcode_map.at(instr.opcode)(chip, instr);
+#if defined(CHIP8_DISPATCH_TABLE)
+	const auto& entry = fetch<Quirks>(chip);
+	entry.handler(chip, entry.instr);
+
+#elif defined(CHIP8_DISPATCH_SWITCH)
+	const auto& entry = fetch<Quirks>(chip);
+	const auto instr = entry.instr;
+
+	switch (instr.opcode) {
+		case Opcodes::cls:         cls(chip, instr);                 break;
+		case Opcodes::ret:         ret(chip, instr);                 break;
+		case Opcodes::sys_nnn:     sys_nnn(chip, instr);             break;
+		case Opcodes::jmp_nnn:     jmp_nnn(chip, instr);             break;
+		case Opcodes::call_nnn:    call_nnn(chip, instr);            break;
+		case Opcodes::se_vx_nn:    se_vx_nn(chip, instr);            break;
+		case Opcodes::sne_vx_nn:   sne_vx_nn(chip, instr);           break;
+		case Opcodes::se_vx_vy:    se_vx_vy(chip, instr);            break;
+		case Opcodes::mov_vx_nn:   mov_vx_nn(chip, instr);           break;
+		case Opcodes::add_vx_nn:   add_vx_nn(chip, instr);           break;
+		case Opcodes::mov_vx_vy:   mov_vx_vy(chip, instr);           break;
+		case Opcodes::or_vx_vy:    or_vx_vy<Quirks>(chip, instr);    break;
+		case Opcodes::and_vx_vy:   and_vx_vy<Quirks>(chip, instr);   break;
+		case Opcodes::xor_vx_vy:   xor_vx_vy<Quirks>(chip, instr);   break;
+		case Opcodes::add_vx_vy:   add_vx_vy(chip, instr);           break;
+		case Opcodes::sub_vx_vy:   sub_vx_vy(chip, instr);           break;
+		case Opcodes::shr_vx:      shr_vx<Quirks>(chip, instr);      break;
+		case Opcodes::subn_vx_vy:  subn_vx_vy(chip, instr);          break;
+		case Opcodes::shl_vx:      shl_vx<Quirks>(chip, instr);      break;
+		case Opcodes::sne_vx_vy:   sne_vx_vy(chip, instr);           break;
+		case Opcodes::mov_i_nnn:   mov_i_nnn(chip, instr);           break;
+		case Opcodes::jmp_v0_nnn:  jmp_v0_nnn<Quirks>(chip, instr);  break;
+		case Opcodes::rnd_vx_nn:   rnd_vx_nn(chip, instr);           break;
+		case Opcodes::drw_vx_vy_n: drw_vx_vy_n<Quirks>(chip, instr); break;
+		case Opcodes::skp_vx:      skp_vx(chip, instr);              break;
+		case Opcodes::sknp_vx:     sknp_vx(chip, instr);             break;
+		case Opcodes::gdly_vx:     gdly_vx(chip, instr);             break;
+		case Opcodes::key_vx:      key_vx(chip, instr);              break;
+		case Opcodes::sdly_vx:     sdly_vx(chip, instr);             break;
+		case Opcodes::ssnd_vx:     ssnd_vx(chip, instr);             break;
+		case Opcodes::add_i_vx:    add_i_vx(chip, instr);            break;
+		case Opcodes::font_vx:     font_vx(chip, instr);             break;
+		case Opcodes::bcd_vx:      bcd_vx(chip, instr);              break;
+		case Opcodes::str_v0_vx:   str_v0_vx<Quirks>(chip, instr);   break;
+		case Opcodes::ld_v0_vx:    ld_v0_vx<Quirks>(chip, instr);    break;
+		case Opcodes::scd_n:       scd_n(chip, instr);               break;
+		case Opcodes::scr:         scr(chip, instr);                 break;
+		case Opcodes::scl:         scl(chip, instr);                 break;
+		case Opcodes::exit:        exit(chip, instr);                break;
+		case Opcodes::low:         low(chip, instr);                 break;
+		case Opcodes::high:        high(chip, instr);                break;
+		case Opcodes::hfont_vx:    hfont_vx(chip, instr);            break;
+		case Opcodes::strf_vx:     strf_vx(chip, instr);             break;
+		case Opcodes::ldf_vx:      ldf_vx(chip, instr);              break;
+		case Opcodes::save_vx_vy:  save_vx_vy(chip, instr);          break;
+		case Opcodes::load_vx_vy:  load_vx_vy(chip, instr);          break;
+		case Opcodes::mov_i_nnnn:  mov_i_nnnn(chip, instr);          break;
+		case Opcodes::plane_x:     plane_x(chip, instr);             break;
+		default:                   entry.handler(chip, instr);       break; //invalid or fused
+	}
+
+#elif defined(CHIP8_DISPATCH_MAP)
+	// Map each opcode enum to the appropriate function
+	static const auto opcode_map = std::unordered_map<Opcodes, std::function<void(chip8&, instruction)>>{
+		{Opcodes::cls,         cls},
+		{Opcodes::ret,         ret},
+		{Opcodes::sys_nnn,     sys_nnn},
+		{Opcodes::jmp_nnn,     jmp_nnn},
+		{Opcodes::call_nnn,    call_nnn},
+		{Opcodes::se_vx_nn,    se_vx_nn},
+		{Opcodes::sne_vx_nn,   sne_vx_nn},
+		{Opcodes::se_vx_vy,    se_vx_vy},
+		{Opcodes::mov_vx_nn,   mov_vx_nn},
+		{Opcodes::add_vx_nn,   add_vx_nn},
+		{Opcodes::mov_vx_vy,   mov_vx_vy},
+		{Opcodes::or_vx_vy,    or_vx_vy<Quirks>},
+		{Opcodes::and_vx_vy,   and_vx_vy<Quirks>},
+		{Opcodes::xor_vx_vy,   xor_vx_vy<Quirks>},
+		{Opcodes::add_vx_vy,   add_vx_vy},
+		{Opcodes::sub_vx_vy,   sub_vx_vy},
+		{Opcodes::shr_vx,      shr_vx<Quirks>},
+		{Opcodes::subn_vx_vy,  subn_vx_vy},
+		{Opcodes::shl_vx,      shl_vx<Quirks>},
+		{Opcodes::sne_vx_vy,   sne_vx_vy},
+		{Opcodes::mov_i_nnn,   mov_i_nnn},
+		{Opcodes::jmp_v0_nnn,  jmp_v0_nnn<Quirks>},
+		{Opcodes::rnd_vx_nn,   rnd_vx_nn},
+		{Opcodes::drw_vx_vy_n, drw_vx_vy_n<Quirks>},
+		{Opcodes::skp_vx,      skp_vx},
+		{Opcodes::sknp_vx,     sknp_vx},
+		{Opcodes::gdly_vx,     gdly_vx},
+		{Opcodes::key_vx,      key_vx},
+		{Opcodes::sdly_vx,     sdly_vx},
+		{Opcodes::ssnd_vx,     ssnd_vx},
+		{Opcodes::add_i_vx,    add_i_vx},
+		{Opcodes::font_vx,     font_vx},
+		{Opcodes::bcd_vx,      bcd_vx},
+		{Opcodes::str_v0_vx,   str_v0_vx<Quirks>},
+		{Opcodes::ld_v0_vx,    ld_v0_vx<Quirks>},
+		{Opcodes::scd_n,       scd_n},
+		{Opcodes::scr,         scr},
+		{Opcodes::scl,         scl},
+		{Opcodes::exit,        exit},
+		{Opcodes::low,         low},
+		{Opcodes::high,        high},
+		{Opcodes::hfont_vx,    hfont_vx},
+		{Opcodes::strf_vx,     strf_vx},
+		{Opcodes::ldf_vx,      ldf_vx},
+		{Opcodes::save_vx_vy,  save_vx_vy},
+		{Opcodes::load_vx_vy,  load_vx_vy},
+		{Opcodes::mov_i_nnnn,  mov_i_nnnn},
+		{Opcodes::plane_x,     plane_x},
+		{Opcodes::invalid,     invalid},
+	};
+
+	const auto instr = instruction{chip.state.memory[chip.state.pc], chip.state.memory[chip.state.pc+1]};
+	opcode_map.at(instr.opcode)(chip, instr);
+#endif
+}
+
+
+template<quirks Quirks>
+auto ISA::fetch(chip8& chip) noexcept -> const decoded_instruction& {
+	auto& entry = chip.decode_cache[chip.state.pc];
+
+	if (!entry.handler) {
+		entry.instr   = instruction{chip.state.memory[chip.state.pc], chip.state.memory[chip.state.pc+1]};
+		entry.handler = get_handler_table<Quirks>()[to_index(entry.instr.opcode)];
+
+		if (chip.idle_skip_enabled and find_idle_loop(chip, entry)) {
+			return entry;
+		}
+		if (chip.fusion_enabled) {
+			fuse(chip, entry);
+		}
+	}
+
+	return entry;
+}
+
+
+auto ISA::peek(const chip8& chip, size_t n) noexcept -> instruction {
+	// A sequence can't be fused past the end of the ROM or across a breakpoint, since those are checked per cycle
+	const size_t address = chip.state.pc + (2 * n);
+
+	if ((address >= chip.rom_end) or chip.breakpoints.contains((address - chip.rom_start) / 2)) {
+		return instruction{Opcodes::invalid, 0};
+	}
+	return instruction{chip.state.memory[address], chip.state.memory[address + 1]};
+}
+
+
+auto ISA::fuse(const chip8& chip, decoded_instruction& entry) noexcept -> void {
+	const auto first = entry.instr;
+	auto fused = instruction{Opcodes::invalid, 0};
+
+	switch (first.opcode) {
+		case Opcodes::gdly_vx: {
+			const auto second = peek(chip, 1);
+			if (second.opcode != Opcodes::se_vx_nn) {
+				return;
+			}
+			const auto third = peek(chip, 2);
+			if (third.opcode != Opcodes::jmp_nnn) {
+				return;
+			}
+
+			fused.x   = first.x;
+			fused.y   = second.x;
+			fused.nn  = second.nn;
+			fused.nnn = third.nnn;
+			entry.handler = gdly_se_jmp;
+			break;
+		}
+
+		case Opcodes::mov_vx_nn: {
+			const auto second = peek(chip, 1);
+			if (second.opcode != Opcodes::add_i_vx) {
+				return;
+			}
+
+			fused.x  = first.x;
+			fused.nn = first.nn;
+			fused.y  = second.x;
+			entry.handler = mov_add_i;
+			break;
+		}
+
+		case Opcodes::se_vx_nn:
+		case Opcodes::sne_vx_nn:
+		case Opcodes::se_vx_vy:
+		case Opcodes::sne_vx_vy: {
+			const auto second = peek(chip, 1);
+			if (second.opcode != Opcodes::jmp_nnn) {
+				return;
+			}
+
+			fused = first;
+			fused.opcode = Opcodes::invalid;
+			fused.nnn = second.nnn;
+
+			switch (first.opcode) {
+				case Opcodes::se_vx_nn:  entry.handler = se_nn_jmp;  break;
+				case Opcodes::sne_vx_nn: entry.handler = sne_nn_jmp; break;
+				case Opcodes::se_vx_vy:  entry.handler = se_vy_jmp;  break;
+				default:                 entry.handler = sne_vy_jmp; break;
+			}
+			break;
+		}
+
+		default:
+			return;
+	}
+
+	entry.instr = fused;
+}
+
+
+auto ISA::find_idle_loop(const chip8& chip, decoded_instruction& entry) noexcept -> bool {
+	// The loop must jump back to the instruction at the PC, and do nothing but poll in between
+	const auto jumps_back = [&](size_t n) {
+		const auto instr = peek(chip, n);
+		return (instr.opcode == Opcodes::jmp_nnn) and (instr.nnn == chip.state.pc);
+	};
+
+	const auto first = entry.instr;
+	auto fused = instruction{Opcodes::invalid, 0};
+
+	switch (first.opcode) {
+		case Opcodes::jmp_nnn:
+			if (first.nnn != chip.state.pc) {
+				return false;
+			}
+			fused.nnn = first.nnn;
+			entry.handler = idle_jmp;
+			break;
+
+		case Opcodes::gdly_vx: {
+			const auto second = peek(chip, 1);
+			if ((second.opcode != Opcodes::se_vx_nn) or !jumps_back(2)) {
+				return false;
+			}
+			fused.x   = first.x;
+			fused.y   = second.x;
+			fused.nn  = second.nn;
+			fused.nnn = chip.state.pc;
+			entry.handler = idle_gdly_se_jmp;
+			break;
+		}
+
+		case Opcodes::skp_vx:
+		case Opcodes::sknp_vx:
+			if (!jumps_back(1)) {
+				return false;
+			}
+			fused.x   = first.x;
+			fused.nnn = chip.state.pc;
+			entry.handler = (first.opcode == Opcodes::skp_vx) ? idle_skp_jmp : idle_sknp_jmp;
+			break;
+
+		default:
+			return false;
+	}
+
+	entry.instr = fused;
+	return true;
 }
 
 
 auto ISA::increment_pc(chip8& chip) noexcept -> void {
-	chip.pc += 2;
+	chip.state.pc += 2;
+}
+
+
+auto ISA::skip_next(chip8& chip) noexcept -> void {
+	const size_t next = chip.state.pc + 2;
+	const bool long_load = (chip.state.memory[next & chip.state.address_mask] == 0xF0) and (chip.state.memory[(next + 1) & chip.state.address_mask] == 0x00);
+
+	chip.state.pc += long_load ? 4 : 2;
+}
+
+
+auto ISA::invalid(chip8& chip, [[maybe_unused]] instruction instr) -> void {
+
+	// The instruction couldn't be decoded. Pause execution
+	// at the instruction so it can be inspected.
+
+	const auto raw = (static_cast<uint16_t>(chip.state.memory[chip.state.pc]) << 8) | chip.state.memory[chip.state.pc + 1];
+	std::cout << std::format("Invalid instruction 0x{:04X} at address 0x{:04X}\n", raw, chip.state.pc);
+	chip.halt(HaltReason::invalid_instruction);
+}
+
+
+auto ISA::scd_n(chip8& chip, instruction instr) -> void {
+
+	// 0x00Cn - scd n
+	// Scroll the display down by n pixels (SUPER-CHIP)
+
+	// The rows are moved down n rows, and the top n rows are cleared.
+
+	chip.state.display.scroll_down(instr.n);
+	increment_pc(chip);
 }
 
 
@@ -20,7 +418,9 @@ auto ISA::cls(chip8& chip, instruction instr) -> void {
 	// 0x00E0 - cls
 	// Clear the display
 
-	chip.display.clear();
+	// XO-CHIP: Only the selected planes are cleared.
+
+	chip.state.display.clear_planes();
 	increment_pc(chip);
 }
 
@@ -33,8 +433,67 @@ auto ISA::ret(chip8& chip, instruction instr) -> void {
 	// The interpreter sets the program counter to the address at the
 	// top of the stack, then subtracts 1 from the stack pointer.
 
-	chip.pc = chip.stack.back();
-	chip.stack.pop_back();
+	if (chip.state.sp == 0) {
+		chip.halt(HaltReason::invalid_instruction);
+		return;
+	}
+
+	chip.state.pc = chip.state.stack[--chip.state.sp];
+	increment_pc(chip);
+}
+
+
+auto ISA::scr(chip8& chip, [[maybe_unused]] instruction instr) -> void {
+
+	// 0x00FB - scr
+	// Scroll the display right by 4 pixels (SUPER-CHIP)
+
+	chip.state.display.scroll_right(4);
+	increment_pc(chip);
+}
+
+
+auto ISA::scl(chip8& chip, [[maybe_unused]] instruction instr) -> void {
+
+	// 0x00FC - scl
+	// Scroll the display left by 4 pixels (SUPER-CHIP)
+
+	chip.state.display.scroll_left(4);
+	increment_pc(chip);
+}
+
+
+auto ISA::exit(chip8& chip, [[maybe_unused]] instruction instr) -> void {
+
+	// 0x00FD - exit
+	// Exit the interpreter (SUPER-CHIP)
+
+	// Execution stops at the instruction.
+
+	chip.halt(HaltReason::exited);
+}
+
+
+auto ISA::low(chip8& chip, [[maybe_unused]] instruction instr) -> void {
+
+	// 0x00FE - low
+	// Switch to the 64x32 low resolution mode (SUPER-CHIP)
+
+	// The display is cleared when the resolution changes.
+
+	chip.state.display.set_hires(false);
+	increment_pc(chip);
+}
+
+
+auto ISA::high(chip8& chip, [[maybe_unused]] instruction instr) -> void {
+
+	// 0x00FF - high
+	// Switch to the 128x64 high resolution mode (SUPER-CHIP)
+
+	// The display is cleared when the resolution changes.
+
+	chip.state.display.set_hires(true);
 	increment_pc(chip);
 }
 
@@ -57,7 +516,7 @@ auto ISA::jmp_nnn(chip8& chip, instruction instr) -> void {
 
 	// The interpreter sets the program counter to nnn.
 
-	chip.pc = instr.nnn;
+	chip.state.pc = instr.nnn;
 }
 
 
@@ -69,8 +528,13 @@ auto ISA::call_nnn(chip8& chip, instruction instr) -> void {
 	// The interpreter increments the stack pointer, then puts the
 	// current pc on the top of the stack. The pc is then set to nnn.
 
-	chip.stack.push_back(chip.pc);
-	chip.pc = instr.nnn;
+	if (chip.state.sp == chip.state.stack.size()) {
+		chip.halt(HaltReason::stack_overflow);
+		return;
+	}
+
+	chip.state.stack[chip.state.sp++] = chip.state.pc;
+	chip.state.pc = instr.nnn;
 }
 
 
@@ -82,8 +546,8 @@ auto ISA::se_vx_nn(chip8& chip, instruction instr) -> void {
 	// The interpreter compares register vx to nn, and if they are
 	// equal, increments the program counter by 2.
 
-	if (chip.v[instr.x] == instr.nn) {
-		increment_pc(chip);
+	if (chip.state.v[instr.x] == instr.nn) {
+		skip_next(chip);
 	}
 	increment_pc(chip);
 }
@@ -97,8 +561,8 @@ auto ISA::sne_vx_nn(chip8& chip, instruction instr) -> void {
 	// The interpreter compares register vx to nn, and if they are
 	// not equal, increments the program counter by 2.
 
-	if (chip.v[instr.x] != instr.nn) {
-		increment_pc(chip);
+	if (chip.state.v[instr.x] != instr.nn) {
+		skip_next(chip);
 	}
 	increment_pc(chip);
 }
@@ -112,9 +576,48 @@ auto ISA::se_vx_vy(chip8& chip, instruction instr) -> void {
 	// The interpreter compares register vx to register vy, and if they are
 	// equal, increments the program counter by 2.
 
-	if (chip.v[instr.x] == chip.v[instr.y]) {
-		increment_pc(chip);
+	if (chip.state.v[instr.x] == chip.state.v[instr.y]) {
+		skip_next(chip);
+	}
+	increment_pc(chip);
+}
+
+
+auto ISA::save_vx_vy(chip8& chip, instruction instr) -> void {
+
+	// 0x5xy2 - save vx, vy
+	// Store registers vx through vy in memory starting at location i (XO-CHIP)
+
+	// The registers are stored in reverse order when x is greater than y.
+	// i isn't modified.
+
+	const int step  = (instr.x <= instr.y) ? 1 : -1;
+	const int count = std::abs(instr.x - instr.y) + 1;
+
+	for (int n = 0; n < count; ++n) {
+		chip.state.memory[(chip.state.i + n) & chip.state.address_mask] = chip.state.v[instr.x + (n * step)];
 	}
+	chip.invalidate_code(chip.state.i & chip.state.address_mask, count);
+
+	increment_pc(chip);
+}
+
+
+auto ISA::load_vx_vy(chip8& chip, instruction instr) -> void {
+
+	// 0x5xy3 - load vx, vy
+	// Read registers vx through vy from memory starting at location i (XO-CHIP)
+
+	// The registers are read in reverse order when x is greater than y.
+	// i isn't modified.
+
+	const int step  = (instr.x <= instr.y) ? 1 : -1;
+	const int count = std::abs(instr.x - instr.y) + 1;
+
+	for (int n = 0; n < count; ++n) {
+		chip.state.v[instr.x + (n * step)] = chip.state.memory[(chip.state.i + n) & chip.state.address_mask];
+	}
+
 	increment_pc(chip);
 }
 
@@ -126,7 +629,7 @@ auto ISA::mov_vx_nn(chip8& chip, instruction instr) -> void {
 
 	// The interpreter puts the value nn into register vx.
 
-	chip.v[instr.x] = instr.nn;
+	chip.state.v[instr.x] = instr.nn;
 	increment_pc(chip);
 }
 
@@ -138,7 +641,7 @@ auto ISA::add_vx_nn(chip8& chip, instruction instr) -> void {
 
 	// Adds the value nn to the value of register vx, then stores the result in vx.
 
-	chip.v[instr.x] += instr.nn;
+	chip.state.v[instr.x] += instr.nn;
 	increment_pc(chip);
 }
 
@@ -150,11 +653,12 @@ auto ISA::mov_vx_vy(chip8& chip, instruction instr) -> void {
 
 	// Stores the value of register vy in register vx.
 
-	chip.v[instr.x] = chip.v[instr.y];
+	chip.state.v[instr.x] = chip.state.v[instr.y];
 	increment_pc(chip);
 }
 
 
+template<quirks Quirks>
 auto ISA::or_vx_vy(chip8& chip, instruction instr) -> void {
 
 	// 0x8xy1 - or vx, vy
@@ -162,12 +666,20 @@ auto ISA::or_vx_vy(chip8& chip, instruction instr) -> void {
 
 	// Performs a bitwise OR on the values of vx and vy,
 	// then stores the result in vx.
+	//
+	// VF RESET: vf is set to 0.
+
+	chip.state.v[instr.x] = (chip.state.v[instr.x] | chip.state.v[instr.y]);
+
+	if constexpr (Quirks.vf_reset) {
+		chip.state.v[0xF] = 0;
+	}
 
-	chip.v[instr.x] = (chip.v[instr.x] | chip.v[instr.y]);
 	increment_pc(chip);
 }
 
 
+template<quirks Quirks>
 auto ISA::and_vx_vy(chip8& chip, instruction instr) -> void {
 
 	// 0x8xy2 - and vx, vy
@@ -175,12 +687,20 @@ auto ISA::and_vx_vy(chip8& chip, instruction instr) -> void {
 
 	// Performs a bitwise AND on the values of vx and vy,
 	// then stores the result in vx.
+	//
+	// VF RESET: vf is set to 0.
+
+	chip.state.v[instr.x] = (chip.state.v[instr.x] & chip.state.v[instr.y]);
+
+	if constexpr (Quirks.vf_reset) {
+		chip.state.v[0xF] = 0;
+	}
 
-	chip.v[instr.x] = (chip.v[instr.x] & chip.v[instr.y]);
 	increment_pc(chip);
 }
 
 
+template<quirks Quirks>
 auto ISA::xor_vx_vy(chip8& chip, instruction instr) -> void {
 
 	// 0x8xy3 - xor vx, vy
@@ -188,8 +708,15 @@ auto ISA::xor_vx_vy(chip8& chip, instruction instr) -> void {
 
 	// Performs a bitwise exclusive OR on the values of
 	// vx and vy, then stores the result in vx.
+	//
+	// VF RESET: vf is set to 0.
+
+	chip.state.v[instr.x] = (chip.state.v[instr.x] ^ chip.state.v[instr.y]);
+
+	if constexpr (Quirks.vf_reset) {
+		chip.state.v[0xF] = 0;
+	}
 
-	chip.v[instr.x] = (chip.v[instr.x] ^ chip.v[instr.y]);
 	increment_pc(chip);
 }
 
@@ -204,10 +731,11 @@ auto ISA::add_vx_vy(chip8& chip, instruction instr) -> void {
 	// is stored in vx. If the result overflows, vf is set to 1,
 	// otherwise 0.
 
-	const uint8_t result = chip.v[instr.x] + chip.v[instr.y];
+	const uint8_t result = chip.state.v[instr.x] + chip.state.v[instr.y];
+	const bool carry = (result < chip.state.v[instr.x]); //overflow if (a + b) < a
 
-	chip.v[instr.x] = result;
-	chip.v[0xF] = (result < chip.v[instr.x]); //overflow if (a + b) < a
+	chip.state.v[instr.x] = result;
+	chip.state.v[0xF] = carry;
 
 	increment_pc(chip);
 }
@@ -222,32 +750,33 @@ auto ISA::sub_vx_vy(chip8& chip, instruction instr) -> void {
 	// If vx > vy, then vf is set to 1, otherwise 0. Then vy is
 	// subtracted from vx, and the results stored in vx.
 
-	chip.v[0xF]     = (chip.v[instr.x] > chip.v[instr.y]) ? 1 : 0;
-	chip.v[instr.x] = chip.v[instr.x] - chip.v[instr.y];
+	chip.state.v[0xF]     = (chip.state.v[instr.x] > chip.state.v[instr.y]) ? 1 : 0;
+	chip.state.v[instr.x] = chip.state.v[instr.x] - chip.state.v[instr.y];
 
 	increment_pc(chip);
 }
 
 
+template<quirks Quirks>
 auto ISA::shr_vx(chip8& chip, instruction instr) -> void {
 
 	// 0x8xy6 - shr vx {, vy}
 	// vx = vy >> 1
 	// vf = LSB(vy)
 
-	// NON-LEGACY MODE: vf is set to the value of the least significant bit of vx.
-	// Then, vx is set to the value of itself shifted right by 1. 
+	// vf is set to the value of the least significant bit of vx.
+	// Then, vx is set to the value of itself shifted right by 1.
 	//
-	// LEGACY MODE: vf is set to the value of the least significant bit of vy.
+	// SHIFT VY: vf is set to the value of the least significant bit of vy.
 	// Then vx is set to the value of vy shifted right by 1.
 
-	if (chip.is_legacy_mode()) {
-		chip.v[0xF]     = chip.v[instr.y] &  1;
-		chip.v[instr.x] = chip.v[instr.y] >> 1;
+	if constexpr (Quirks.shift_vy) {
+		chip.state.v[0xF]     = chip.state.v[instr.y] &  1;
+		chip.state.v[instr.x] = chip.state.v[instr.y] >> 1;
 	}
 	else {
-		chip.v[0xF]     = chip.v[instr.x] &  1;
-		chip.v[instr.x] = chip.v[instr.x] >> 1;
+		chip.state.v[0xF]     = chip.state.v[instr.x] &  1;
+		chip.state.v[instr.x] = chip.state.v[instr.x] >> 1;
 	}
 
 	increment_pc(chip);
@@ -263,34 +792,35 @@ auto ISA::subn_vx_vy(chip8& chip, instruction instr) -> void {
 	// If vy > vx, then vf is set to 1, otherwise 0. Then vx is
 	// subtracted from vy, and the results stored in vx.
 
-	chip.v[0xF]     = (chip.v[instr.y] > chip.v[instr.x]) ? 1 : 0;
-	chip.v[instr.x] = chip.v[instr.y] - chip.v[instr.x];
+	chip.state.v[0xF]     = (chip.state.v[instr.y] > chip.state.v[instr.x]) ? 1 : 0;
+	chip.state.v[instr.x] = chip.state.v[instr.y] - chip.state.v[instr.x];
 
 	increment_pc(chip);
 }
 
 
+template<quirks Quirks>
 auto ISA::shl_vx(chip8& chip, instruction instr) -> void {
 
 	// 0x8xyE - shl vx {, vy}
 	// vx = vy << 1
 	// vf = MSB(vy)
 
-	// NON-LEGACY MODE: vf is set to the value of the most significant bit of vx.
-	// Then, vx is set to the value of itself shifted left by 1. 
+	// vf is set to the value of the most significant bit of vx.
+	// Then, vx is set to the value of itself shifted left by 1.
 	//
-	// LEGACY MODE: vf is set to the value of the most significant bit of vy.
+	// SHIFT VY: vf is set to the value of the most significant bit of vy.
 	// Then vx is set to the value of vy shifted left by 1.
 
-	using reg_t = std::decay_t<decltype(chip.v[0])>;
+	using reg_t = std::decay_t<decltype(chip.state.v[0])>;
 
-	if (chip.is_legacy_mode()) {
-		chip.v[0xF]     = chip.v[instr.y] >> ((sizeof(reg_t) * 8) - 1);
-		chip.v[instr.x] = chip.v[instr.y] << 1;
+	if constexpr (Quirks.shift_vy) {
+		chip.state.v[0xF]     = chip.state.v[instr.y] >> ((sizeof(reg_t) * 8) - 1);
+		chip.state.v[instr.x] = chip.state.v[instr.y] << 1;
 	}
 	else {
-		chip.v[0xF]     = chip.v[instr.x] >> ((sizeof(reg_t) * 8) - 1);
-		chip.v[instr.x] = chip.v[instr.x] << 1;
+		chip.state.v[0xF]     = chip.state.v[instr.x] >> ((sizeof(reg_t) * 8) - 1);
+		chip.state.v[instr.x] = chip.state.v[instr.x] << 1;
 	}
 
 	increment_pc(chip);
@@ -305,8 +835,8 @@ auto ISA::sne_vx_vy(chip8& chip, instruction instr) -> void {
 	// The values of vx and vy are compared, and if they are not equal,
 	// the program counter is increased by 2.
 
-	if (chip.v[instr.x] != (chip.v[instr.y])) {
-		increment_pc(chip);
+	if (chip.state.v[instr.x] != (chip.state.v[instr.y])) {
+		skip_next(chip);
 	}
 
 	increment_pc(chip);
@@ -320,19 +850,28 @@ auto ISA::mov_i_nnn(chip8& chip, instruction instr) -> void {
 
 	// The value of register i is set to nnn.
 
-	chip.i = instr.nnn;
+	chip.state.i = instr.nnn;
 	increment_pc(chip);
 }
 
 
+template<quirks Quirks>
 auto ISA::jmp_v0_nnn(chip8& chip, instruction instr) -> void {
 
 	// 0xBnnn - jmp v0, addr
 	// Jump to location nnn + V0
 
 	// The program counter is set to nnn plus the value of V0.
+	//
+	// JUMP VX: The program counter is set to nnn plus the value of vx,
+	// where x is the highest nibble of nnn (SUPER-CHIP).
 
-	chip.pc = instr.nnn + chip.v[0];
+	if constexpr (Quirks.jump_vx) {
+		chip.state.pc = instr.nnn + chip.state.v[instr.x];
+	}
+	else {
+		chip.state.pc = instr.nnn + chip.state.v[0];
+	}
 }
 
 
@@ -344,15 +883,13 @@ auto ISA::rnd_vx_nn(chip8& chip, instruction instr) -> void {
 	// The interpreter generates a random number from 0 to 255, which
 	// is then ANDed with the value nn. The results are stored in vx.
 
-	static std::random_device rd;
-	static std::mt19937 gen(rd());
-	static std::uniform_int_distribution dist(0, 255);
-
-	chip.v[instr.x] = dist(gen) & instr.nn;
+	// The high bits of a PCG32 output are the most random
+	chip.state.v[instr.x] = static_cast<uint8_t>(chip.state.rng() >> 24) & instr.nn;
 	increment_pc(chip);
 }
 
 
+template<quirks Quirks>
 auto ISA::drw_vx_vy_n(chip8& chip, instruction instr) -> void {
 
 	// 0xDxyn - drw vx, vy, n
@@ -361,25 +898,61 @@ auto ISA::drw_vx_vy_n(chip8& chip, instruction instr) -> void {
 	// The interpreter reads n bytes from memory, starting at the address stored in i.
 	// These bytes are then displayed as sprites on screen at coordinates (vx, vy).
 	// Sprites are XORed onto the existing screen. If this causes any pixels to be erased,
-	// vf is set to 1, otherwise it is set to 0. If the sprite is positioned so part of it is
-	// outside the coordinates of the display, it wraps around to the opposite side of the screen.
+	// vf is set to 1, otherwise it is set to 0. The coordinates wrap around the display.
+	//
+	// WRAP: If the sprite is positioned so part of it is outside the coordinates of the
+	// display, it wraps around to the opposite side of the screen. Otherwise it's clipped.
+	//
+	// DISPLAY WAIT: The interpreter waits for the next 60Hz frame before drawing, so the
+	// instruction uses the rest of the current frame's instructions.
+	//
+	// SUPER-CHIP: When n is 0, a 16x16 sprite is drawn instead. Each row is 2 bytes.
+	//
+	// XO-CHIP: The sprite is drawn to each selected plane. When both planes are
+	// selected, the sprite for plane 0 is followed by the sprite for plane 1.
 
 	bool erased = false;
-	const uint8_t vx = chip.v[instr.x];
-	const uint8_t vy = chip.v[instr.y];
-
-	for (uint8_t y = 0; y < instr.n; ++y) {
-		const uint8_t byte = chip.memory[chip.i + y];
+	const size_t   vx     = chip.state.v[instr.x] % chip.state.display.size_x();
+	const size_t   vy     = chip.state.v[instr.y] % chip.state.display.size_y();
+	const uint8_t  planes = chip.state.display.get_planes();
+	const uint16_t mask   = chip.state.address_mask;
+
+	// The address of the sprite for each plane. An unselected plane doesn't use any bytes.
+	const size_t sprite_size = (instr.n == 0) ? 32 : instr.n;
+	const size_t plane0 = chip.state.i;
+	const size_t plane1 = chip.state.i + ((planes & 0b01) ? sprite_size : 0);
+
+	// Read a row of a plane's sprite, or nothing if the plane isn't selected
+	const auto row = [&](size_t address, uint8_t plane, size_t offset, size_t bytes) -> uint32_t {
+		if (!(planes & plane)) {
+			return 0;
+		}
+		uint32_t bits = chip.state.memory[(address + offset) & mask];
+		if (bytes == 2) {
+			bits = (bits << 8) | chip.state.memory[(address + offset + 1) & mask];
+		}
+		return bits;
+	};
 
-		// Test each bit of the byte. Flip the appropriate pixel if it's 1 (AKA: xor operation)
-		for (uint8_t x = 0; x < 8; ++x) {
-			if ((byte & (1 << x)) != 0) {
-				erased |= chip.display.flip(vx + (7-x), vy + y);
-			}
+	if (instr.n == 0) {
+		// Each pair of bytes is a row of 16 pixels, which is XORed onto the display in one operation
+		for (uint8_t y = 0; y < 16; ++y) {
+			erased |= chip.state.display.xor_row<Quirks.wrap>(vx, vy + y, row(plane0, 0b01, 2 * y, 2), row(plane1, 0b10, 2 * y, 2), 16);
+		}
+	}
+	else {
+		// Each byte is a row of 8 pixels, which is XORed onto the display in one operation
+		for (uint8_t y = 0; y < instr.n; ++y) {
+			erased |= chip.state.display.xor_row<Quirks.wrap>(vx, vy + y, row(plane0, 0b01, y, 1), row(plane1, 0b10, y, 1), 8);
 		}
 	}
 
-	chip.v[0xF] = erased;
+	chip.state.v[0xF] = erased;
+
+	// One instruction is counted by chip8::run_cycle
+	if constexpr (Quirks.display_wait) {
+		chip.state.cycle_count += chip.instructions_until_frame() - 1;
+	}
 
 	increment_pc(chip);
 }
@@ -393,10 +966,8 @@ auto ISA::skp_vx(chip8& chip, instruction instr) -> void {
 	// Checks the keyboard, and if the key corresponding to the value
 	// of vx is currently in the down position, pc is increased by 2.
 
-	const auto key = static_cast<Keys>(chip.v[instr.x]);
-
-	if (chip.input.is_key_pressed(key)){
-		increment_pc(chip);
+	if (chip.state.is_key_pressed(chip.state.v[instr.x])) {
+		skip_next(chip);
 	}
 	increment_pc(chip);
 }
@@ -410,15 +981,40 @@ auto ISA::sknp_vx(chip8& chip, instruction instr) -> void {
 	// Checks the keyboard, and if the key corresponding to the value
 	// of vx is currently in the up position, pc is increased by 2.
 
-	const auto key = static_cast<Keys>(chip.v[instr.x]);
-
-	if (!chip.input.is_key_pressed(key)) {
-		increment_pc(chip);
+	if (!chip.state.is_key_pressed(chip.state.v[instr.x])) {
+		skip_next(chip);
 	}
 	increment_pc(chip);
 }
 
 
+auto ISA::mov_i_nnnn(chip8& chip, [[maybe_unused]] instruction instr) -> void {
+
+	// 0xF000 nnnn - mov i, long addr
+	// i = nnnn (XO-CHIP)
+
+	// The value of register i is set to the 16 bit address in the word after
+	// the instruction. The instruction is 4 bytes long.
+
+	const size_t operand = chip.state.pc + 2;
+	chip.state.i  = static_cast<uint16_t>((chip.state.memory[operand & chip.state.address_mask] << 8) | chip.state.memory[(operand + 1) & chip.state.address_mask]);
+	chip.state.pc += 4;
+}
+
+
+auto ISA::plane_x(chip8& chip, instruction instr) -> void {
+
+	// 0xFx01 - plane x
+	// Select the planes used by drawing, clearing, and scrolling (XO-CHIP)
+
+	// x is a bitmask of planes. 0 selects no planes, 1 selects plane 0,
+	// 2 selects plane 1, and 3 selects both planes.
+
+	chip.state.display.set_planes(instr.x);
+	increment_pc(chip);
+}
+
+
 auto ISA::gdly_vx(chip8& chip, instruction instr) -> void {
 
 	// 0xFx07 - gdly vx
@@ -426,7 +1022,7 @@ auto ISA::gdly_vx(chip8& chip, instruction instr) -> void {
 
 	// The value of DT is placed into vx.
 
-	chip.v[instr.x] = chip.timer.get_delay();
+	chip.state.v[instr.x] = chip.state.timers.delay;
 	increment_pc(chip);
 }
 
@@ -439,15 +1035,9 @@ auto ISA::key_vx(chip8& chip, instruction instr) -> void {
 	// All execution stops until a key is pressed, then the value
 	// of that key is stored in vx.
 
-	chip.pause();
-
-	auto func = [&](Keys key) {
-		chip.v[instr.x] = static_cast<uint8_t>(key);
-		chip.resume();
-		increment_pc(chip);
-	};
-
-	chip.input.register_keypress_event(func);
+	// The key is stored, and the pc incremented, when it's pressed (see chip8::set_key_state)
+	chip.halt(HaltReason::key_wait);
+	chip.state.key_register = instr.x;
 }
 
 
@@ -458,7 +1048,7 @@ auto ISA::sdly_vx(chip8& chip, instruction instr) -> void {
 
 	// DT is set to the value of vx.
 
-	chip.timer.set_delay(chip.v[instr.x]);
+	chip.state.timers.delay = chip.state.v[instr.x];
 	increment_pc(chip);
 }
 
@@ -470,7 +1060,7 @@ auto ISA::ssnd_vx(chip8& chip, instruction instr) -> void {
 
 	// ST is set to the value of vx.
 
-	chip.timer.set_sound(chip.v[instr.x]);
+	chip.state.timers.sound = chip.state.v[instr.x];
 	increment_pc(chip);
 }
 
@@ -485,10 +1075,10 @@ auto ISA::add_i_vx(chip8& chip, instruction instr) -> void {
 	// vf is set to 1 when there is a range overflow (i+vx > 0xFFF),
 	// and to 0 when there isn't.
 
-	const uint16_t sum = chip.i + chip.v[instr.x];
+	const uint16_t sum = chip.state.i + chip.state.v[instr.x];
 
-	chip.v[0xF] = (sum < chip.i) ? 1 : 0;    //overflow if (a + b) < a
-	chip.i      = chip.v[instr.x] + chip.i;
+	chip.state.v[0xF] = (sum < chip.state.i) ? 1 : 0;    //overflow if (a + b) < a
+	chip.state.i      = chip.state.v[instr.x] + chip.state.i;
 
 	increment_pc(chip);
 }
@@ -503,7 +1093,22 @@ auto ISA::font_vx(chip8& chip, instruction instr) -> void {
 	// of the character corresponding to the value of vx.
 
 	// it's VX * 5 because every font is 5 bytes long.
-	chip.i = chip.v[instr.x] * 5;
+	chip.state.i = chip.state.v[instr.x] * 5;
+
+	increment_pc(chip);
+}
+
+
+auto ISA::hfont_vx(chip8& chip, instruction instr) -> void {
+
+	// Fx30 - hfont vx
+	// i = location of the large sprite for digit vx (SUPER-CHIP)
+
+	// The value of i is set to the location for the 8x10 hexadecimal
+	// sprite of the character corresponding to the value of vx.
+
+	// it's VX * 10 because every large font is 10 bytes long.
+	chip.state.i = static_cast<uint16_t>(chip8::big_font_start + ((chip.state.v[instr.x] & 0xF) * 10));
 
 	increment_pc(chip);
 }
@@ -518,16 +1123,18 @@ auto ISA::bcd_vx(chip8& chip, instruction instr) -> void {
 	// hundreds digit in memory at location in i, the tens digit at
 	// location i+1, and the ones digit at location i+2.
 
-	const uint8_t val = chip.v[instr.x];
+	const uint8_t val = chip.state.v[instr.x];
 
-	chip.memory[chip.i]     = val / 100;
-	chip.memory[chip.i + 1] = (val / 10) % 10;
-	chip.memory[chip.i + 2] = val % 10;
+	chip.state.memory[chip.state.i & chip.state.address_mask]       = val / 100;
+	chip.state.memory[(chip.state.i + 1) & chip.state.address_mask] = (val / 10) % 10;
+	chip.state.memory[(chip.state.i + 2) & chip.state.address_mask] = val % 10;
+	chip.invalidate_code(chip.state.i & chip.state.address_mask, 3);
 
 	increment_pc(chip);
 }
 
 
+template<quirks Quirks>
 auto ISA::str_v0_vx(chip8& chip, instruction instr) -> void {
 
 	// 0xFx55 - str v0, vx
@@ -536,20 +1143,22 @@ auto ISA::str_v0_vx(chip8& chip, instruction instr) -> void {
 	// The interpreter copies the values of registers v0 through vx
 	// into memory, starting at the address in i.
 	//
-	// LEGACY MODE: i is set to i + x + 1 after this operation.
+	// INCREMENT I: i is set to i + x + 1 after this operation.
 
 	for (uint8_t i = 0; i <= instr.x; ++i) {
-		chip.memory[chip.i + i] = chip.v[i];
+		chip.state.memory[(chip.state.i + i) & chip.state.address_mask] = chip.state.v[i];
 	}
+	chip.invalidate_code(chip.state.i & chip.state.address_mask, instr.x + 1);
 
-	if (chip.is_legacy_mode()) {
-		chip.i = chip.i + instr.x + 1;
+	if constexpr (Quirks.increment_i) {
+		chip.state.i = chip.state.i + instr.x + 1;
 	}
 
 	increment_pc(chip);
 }
 
 
+template<quirks Quirks>
 auto ISA::ld_v0_vx(chip8& chip, instruction instr) -> void {
 
 	// 0xFx65 - ld_v0_vx
@@ -558,15 +1167,223 @@ auto ISA::ld_v0_vx(chip8& chip, instruction instr) -> void {
 	// The interpreter reads values from memory starting at location i
 	// into registers V0 through vx.
 	//
-	// LEGACY MODE: i is set to i + x + 1 after this operation.
+	// INCREMENT I: i is set to i + x + 1 after this operation.
 
 	for (uint8_t i = 0; i <= instr.x; ++i) {
-		chip.v[i] = chip.memory[chip.i + i];
+		chip.state.v[i] = chip.state.memory[(chip.state.i + i) & chip.state.address_mask];
 	}
 
-	if (chip.is_legacy_mode()) {
-		chip.i = chip.i + instr.x + 1;
+	if constexpr (Quirks.increment_i) {
+		chip.state.i = chip.state.i + instr.x + 1;
 	}
 
 	increment_pc(chip);
 }
+
+
+auto ISA::strf_vx(chip8& chip, instruction instr) -> void {
+
+	// 0xFx75 - strf vx
+	// Store registers v0 through vx in the RPL user flags (SUPER-CHIP)
+
+	// The flags are saved to disk when a flags directory is set (see chip8::set_flags_directory).
+
+	for (uint8_t i = 0; i <= instr.x; ++i) {
+		chip.state.rpl_flags[i] = chip.state.v[i];
+	}
+	chip.save_flags();
+
+	increment_pc(chip);
+}
+
+
+auto ISA::ldf_vx(chip8& chip, instruction instr) -> void {
+
+	// 0xFx85 - ldf vx
+	// Read registers v0 through vx from the RPL user flags (SUPER-CHIP)
+
+	for (uint8_t i = 0; i <= instr.x; ++i) {
+		chip.state.v[i] = chip.state.rpl_flags[i];
+	}
+
+	increment_pc(chip);
+}
+
+
+
+//----------------------------------------------------------------------------------
+// Superinstructions
+//----------------------------------------------------------------------------------
+//
+// Each superinstruction has the same effect as executing its sequence one
+// instruction at a time. One instruction is counted by chip8::run_cycle, and
+// the superinstruction counts the rest of the instructions it executes.
+//
+// The operands of the sequence are packed into the fields of the instruction,
+// as described by each function.
+//
+//----------------------------------------------------------------------------------
+
+auto ISA::gdly_se_jmp(chip8& chip, instruction instr) -> void {
+
+	// gdly vx; se vy, nn; jmp nnn
+	// x = gdly register, y = se register, nn = se value, nnn = jmp address
+
+	chip.state.v[instr.x] = chip.state.timers.delay;
+
+	if (chip.state.v[instr.y] == instr.nn) {
+		chip.state.pc += 6;
+		chip.state.cycle_count += 1;
+		chip.fusion.record(FusedOp::gdly_se_jmp, 2);
+	}
+	else {
+		chip.state.pc = instr.nnn;
+		chip.state.cycle_count += 2;
+		chip.fusion.record(FusedOp::gdly_se_jmp, 3);
+	}
+}
+
+
+auto ISA::mov_add_i(chip8& chip, instruction instr) -> void {
+
+	// mov vx, nn; add i, vy
+	// x = mov register, nn = mov value, y = add register
+
+	chip.state.v[instr.x] = instr.nn;
+
+	const uint16_t sum = chip.state.i + chip.state.v[instr.y];
+
+	chip.state.v[0xF] = (sum < chip.state.i) ? 1 : 0;
+	chip.state.i      = chip.state.v[instr.y] + chip.state.i;
+
+	chip.state.pc += 4;
+	chip.state.cycle_count += 1;
+	chip.fusion.record(FusedOp::mov_add_i, 2);
+}
+
+
+auto ISA::skip_jmp(chip8& chip, instruction instr, bool skip) noexcept -> uint64_t {
+	if (skip) {
+		chip.state.pc += 4;
+		return 1;
+	}
+
+	chip.state.pc = instr.nnn;
+	return 2;
+}
+
+
+auto ISA::se_nn_jmp(chip8& chip, instruction instr) -> void {
+
+	// se vx, nn; jmp nnn
+
+	const auto count = skip_jmp(chip, instr, chip.state.v[instr.x] == instr.nn);
+	chip.state.cycle_count += count - 1;
+	chip.fusion.record(FusedOp::se_nn_jmp, count);
+}
+
+
+auto ISA::sne_nn_jmp(chip8& chip, instruction instr) -> void {
+
+	// sne vx, nn; jmp nnn
+
+	const auto count = skip_jmp(chip, instr, chip.state.v[instr.x] != instr.nn);
+	chip.state.cycle_count += count - 1;
+	chip.fusion.record(FusedOp::sne_nn_jmp, count);
+}
+
+
+auto ISA::se_vy_jmp(chip8& chip, instruction instr) -> void {
+
+	// se vx, vy; jmp nnn
+
+	const auto count = skip_jmp(chip, instr, chip.state.v[instr.x] == chip.state.v[instr.y]);
+	chip.state.cycle_count += count - 1;
+	chip.fusion.record(FusedOp::se_vy_jmp, count);
+}
+
+
+auto ISA::sne_vy_jmp(chip8& chip, instruction instr) -> void {
+
+	// sne vx, vy; jmp nnn
+
+	const auto count = skip_jmp(chip, instr, chip.state.v[instr.x] != chip.state.v[instr.y]);
+	chip.state.cycle_count += count - 1;
+	chip.fusion.record(FusedOp::sne_vy_jmp, count);
+}
+
+
+//----------------------------------------------------------------------------------
+// Idle Loops
+//----------------------------------------------------------------------------------
+//
+// An idle loop jumps back to its first instruction, and only polls the delay
+// timer or a key in between. The timers and keys don't change within a
+// cycle, so once the loop decides to continue, every iteration up to the next
+// timer tick has the same result. Those iterations are counted at once, and
+// leave the state exactly as executing them would. Otherwise, only the first
+// instruction of the loop is executed, and the rest are decoded as usual.
+//
+// The operands are packed like the superinstructions, and nnn is always the
+// address of the first instruction of the loop.
+//
+//----------------------------------------------------------------------------------
+
+auto ISA::skip_idle_loop(chip8& chip, uint64_t length) noexcept -> bool {
+	const uint64_t count = (chip.instructions_until_tick() / length) * length;
+	if (count == 0) {
+		return false;
+	}
+
+	// One instruction is counted by chip8::run_cycle
+	chip.state.cycle_count += count - 1;
+	chip.idle_instructions += count;
+	return true;
+}
+
+
+auto ISA::idle_jmp(chip8& chip, instruction instr) -> void {
+
+	// jmp nnn
+
+	if (!skip_idle_loop(chip, 1)) {
+		jmp_nnn(chip, instr);
+	}
+}
+
+
+auto ISA::idle_gdly_se_jmp(chip8& chip, instruction instr) -> void {
+
+	// gdly vx; se vy, nn; jmp nnn
+	// x = gdly register, y = se register, nn = se value, nnn = jmp address
+
+	const uint8_t value = (instr.x == instr.y) ? chip.state.timers.delay : chip.state.v[instr.y];
+
+	if ((value != instr.nn) and skip_idle_loop(chip, 3)) {
+		chip.state.v[instr.x] = chip.state.timers.delay;
+		return;
+	}
+	gdly_vx(chip, instr);
+}
+
+
+auto ISA::idle_skp_jmp(chip8& chip, instruction instr) -> void {
+
+	// skp vx; jmp nnn
+
+	if (!chip.state.is_key_pressed(chip.state.v[instr.x]) and skip_idle_loop(chip, 2)) {
+		return;
+	}
+	skp_vx(chip, instr);
+}
+
+
+auto ISA::idle_sknp_jmp(chip8& chip, instruction instr) -> void {
+
+	// sknp vx; jmp nnn
+
+	if (chip.state.is_key_pressed(chip.state.v[instr.x]) and skip_idle_loop(chip, 2)) {
+		return;
+	}
+	sknp_vx(chip, instr);
+}
@@ -1,9 +1,16 @@
 #pragma once
 
-#include <functional>
-#include <unordered_map>
+#include <array>
+#include "decode_cache.h"
+#include "quirks.h"
 #include "instruction/instruction.h"
 
+// Select the instruction dispatch engine. The table engine is used when the
+// build doesn't specify one. The map engine is kept as a reference.
+#if !defined(CHIP8_DISPATCH_TABLE) && !defined(CHIP8_DISPATCH_SWITCH) && !defined(CHIP8_DISPATCH_MAP)
+#define CHIP8_DISPATCH_TABLE
+#endif
+
 class chip8;
 
 
@@ -12,18 +19,48 @@ class chip8;
  * 
  * @brief Defines the functionality of the CHIP-8 instruction set
  * 
- * @details ISA is essentially a static class with one public function which
- *          executes a single cycle on an instance of a chip8.
+ * @details ISA is essentially a static class. The interpreter is a template
+ *          of the @ref quirks it follows, and is instantiated once for each
+ *          @ref QuirkProfile. The engine for a chip8's profile is selected by
+ *          select_engine when the profile changes, and the chip8 executes its
+ *          cycles through it, so the handlers never check a quirk at runtime.
+ * 
+ *          The dispatch from an opcode to its handler is selected at build time:
+ *            - CHIP8_DISPATCH_TABLE:  Index a dense function pointer table (default)
+ *            - CHIP8_DISPATCH_SWITCH: Jump directly to the handler from a switch
+ *            - CHIP8_DISPATCH_MAP:    Look up an std::function in a hash map (reference)
+ *
+ *          The table and switch engines decode each address once and keep the
+ *          result in the chip8's DecodeCache. The map engine decodes the
+ *          instruction on every cycle.
+ *
+ *          When fusion is enabled, the table and switch engines also replace
+ *          common instruction sequences with a single superinstruction (see
+ *          FusedOp). A superinstruction has the same effect as executing the
+ *          sequence one instruction at a time.
+ *
+ *          When idle loop skipping is enabled, loops that only poll the delay
+ *          timer or a key are replaced the same way. Their superinstruction
+ *          counts every iteration up to the next timer tick at once (see
+ *          chip8::set_idle_skip_enabled).
  */
 class ISA {
+    friend class AOTAccess;
+    friend class JIT;
+
 public:
 
     /**
-     * @brief Execute a cycle
+     * @brief Select the interpreter instantiated for the quirk profile of a chip8
      *
-     * @param[in] chip  An instance of chip8 to execute a cycle of
+     * @details Sets the function that executes a cycle (chip8::interpret) and
+     *          the handler table (chip8::handlers) of the chip. The decoded
+     *          instructions hold handlers of the previous engine, so the
+     *          decode cache must be cleared after the engine changes.
+     *
+     * @param[in] chip  The chip8 to select the engine of
      */
-    static auto execute_cycle(chip8& chip) -> void;
+    static auto select_engine(chip8& chip) noexcept -> void;
 
 private:
 
@@ -31,11 +68,54 @@ private:
     ISA() = default;
     ~ISA() = default;
 
+    using handler_t = instruction_handler;
+    using handler_table_t = std::array<handler_t, opcode_count>;
+
+    // Execute a cycle on a chip8 with the interpreter for a set of quirks
+    template<quirks Quirks>
+    static auto execute_cycle(chip8& chip) -> void;
+
+    // Use the interpreter for a set of quirks to execute the cycles of a chip8
+    template<quirks Quirks>
+    static auto use_engine(chip8& chip) noexcept -> void;
+
+    // Map the dense index of each opcode enum to the handler for a set of quirks
+    template<quirks Quirks>
+    [[nodiscard]]
+    static auto get_handler_table() noexcept -> const handler_table_t&;
+
+    // Decode the instruction at the PC, using the cached result if there is one
+    template<quirks Quirks>
+    [[nodiscard]]
+    static auto fetch(chip8& chip) noexcept -> const decoded_instruction&;
+
+    // Decode the instruction n instructions after the PC. Returns an invalid instruction past the end of the ROM or at a breakpoint.
+    [[nodiscard]]
+    static auto peek(const chip8& chip, size_t n) noexcept -> instruction;
+
+    // Replace the entry for the instruction at the PC with a superinstruction if it begins a fusable sequence
+    static auto fuse(const chip8& chip, decoded_instruction& entry) noexcept -> void;
+
+    // Replace the entry for the instruction at the PC with an idle loop superinstruction if it begins one. Returns true if it was replaced.
+    static auto find_idle_loop(const chip8& chip, decoded_instruction& entry) noexcept -> bool;
+
     static auto increment_pc(chip8& chip) noexcept -> void;
 
+    // Move the PC past the next instruction, which is 4 bytes long if it's the XO-CHIP long load (0xF000)
+    static auto skip_next(chip8& chip) noexcept -> void;
+
+    // Unrecognized instruction
+    static auto invalid(chip8& chip, instruction instr) -> void;
+
     // 0x0---
+    static auto scd_n(chip8& chip, instruction instr) -> void;   //0x00Cn
     static auto cls(chip8& chip, instruction instr) -> void;     //0x00E0
     static auto ret(chip8& chip, instruction instr) -> void;     //0x00EE
+    static auto scr(chip8& chip, instruction instr) -> void;     //0x00FB
+    static auto scl(chip8& chip, instruction instr) -> void;     //0x00FC
+    static auto exit(chip8& chip, instruction instr) -> void;    //0x00FD
+    static auto low(chip8& chip, instruction instr) -> void;     //0x00FE
+    static auto high(chip8& chip, instruction instr) -> void;    //0x00FF
     static auto sys_nnn(chip8& chip, instruction instr) -> void; //0x0nnn
 
     // 0x1nnn
@@ -50,8 +130,10 @@ private:
     // 0x4xnn
     static auto sne_vx_nn(chip8& chip, instruction instr) -> void;
 
-    // 0x5xy0
-    static auto se_vx_vy(chip8& chip, instruction instr) -> void;
+    // 0x5---
+    static auto se_vx_vy(chip8& chip, instruction instr) -> void;   //0x5xy0
+    static auto save_vx_vy(chip8& chip, instruction instr) -> void; //0x5xy2
+    static auto load_vx_vy(chip8& chip, instruction instr) -> void; //0x5xy3
 
     // 0x6xnn
     static auto mov_vx_nn(chip8& chip, instruction instr) -> void;
@@ -61,13 +143,18 @@ private:
 
     // 0x8---
     static auto mov_vx_vy(chip8& chip, instruction instr) -> void;  //0x8xy0
+    template<quirks Quirks>
     static auto or_vx_vy(chip8& chip, instruction instr) -> void;   //0x8xy1
+    template<quirks Quirks>
     static auto and_vx_vy(chip8& chip, instruction instr) -> void;  //0x8xy2
+    template<quirks Quirks>
     static auto xor_vx_vy(chip8& chip, instruction instr) -> void;  //0x8xy3
     static auto add_vx_vy(chip8& chip, instruction instr) -> void;  //0x8xy4
     static auto sub_vx_vy(chip8& chip, instruction instr) -> void;  //0x8xy5
+    template<quirks Quirks>
     static auto shr_vx(chip8& chip, instruction instr) -> void;     //0x8xy6
     static auto subn_vx_vy(chip8& chip, instruction instr) -> void; //0x8xy7
+    template<quirks Quirks>
     static auto shl_vx(chip8& chip, instruction instr) -> void;     //0x8xyE
 	
     // 0x9xy0
@@ -77,12 +164,14 @@ private:
     static auto mov_i_nnn(chip8& chip, instruction instr) -> void;
 
     // 0xBnnn
+    template<quirks Quirks>
     static auto jmp_v0_nnn(chip8& chip, instruction instr) -> void;
 
     // 0xCxnn
     static auto rnd_vx_nn(chip8& chip, instruction instr) -> void;
 
     // 0xDxyn
+    template<quirks Quirks>
     static auto drw_vx_vy_n(chip8& chip, instruction instr) -> void;
 
     // 0xE---
@@ -90,53 +179,41 @@ private:
     static auto sknp_vx(chip8& chip, instruction instr) -> void; //0xExA1
 
     // 0xF---
+    static auto mov_i_nnnn(chip8& chip, instruction instr) -> void; //0xF000 nnnn
+    static auto plane_x(chip8& chip, instruction instr) -> void;   //0xFx01
     static auto gdly_vx(chip8& chip, instruction instr) -> void;   //0xFx07
     static auto key_vx(chip8& chip, instruction instr) -> void;    //0xFx0A
     static auto sdly_vx(chip8& chip, instruction instr) -> void;   //0xFx15
     static auto ssnd_vx(chip8& chip, instruction instr) -> void;   //0xFx18
     static auto add_i_vx(chip8& chip, instruction instr) -> void;  //0xFx1E
     static auto font_vx(chip8& chip, instruction instr) -> void;   //0xFx29
+    static auto hfont_vx(chip8& chip, instruction instr) -> void;  //0xFx30
     static auto bcd_vx(chip8& chip, instruction instr) -> void;    //0xFx33
+    template<quirks Quirks>
     static auto str_v0_vx(chip8& chip, instruction instr) -> void; //0xFx55
+    template<quirks Quirks>
     static auto ld_v0_vx(chip8& chip, instruction instr) -> void;  //0xFx65
+    static auto strf_vx(chip8& chip, instruction instr) -> void;   //0xFx75
+    static auto ldf_vx(chip8& chip, instruction instr) -> void;    //0xFx85
+
+    // Superinstructions
+    static auto gdly_se_jmp(chip8& chip, instruction instr) -> void; //gdly vx; se vy nn; jmp nnn
+    static auto mov_add_i(chip8& chip, instruction instr) -> void;   //mov vx nn; add i vy
+    static auto se_nn_jmp(chip8& chip, instruction instr) -> void;   //se vx nn; jmp nnn
+    static auto sne_nn_jmp(chip8& chip, instruction instr) -> void;  //sne vx nn; jmp nnn
+    static auto se_vy_jmp(chip8& chip, instruction instr) -> void;   //se vx vy; jmp nnn
+    static auto sne_vy_jmp(chip8& chip, instruction instr) -> void;  //sne vx vy; jmp nnn
+
+    // Execute a skip followed by a jump. Returns the number of instructions executed.
+    static auto skip_jmp(chip8& chip, instruction instr, bool skip) noexcept -> uint64_t;
+
+    // Idle loops, which jump back to their first instruction
+    static auto idle_jmp(chip8& chip, instruction instr) -> void;         //jmp nnn
+    static auto idle_gdly_se_jmp(chip8& chip, instruction instr) -> void; //gdly vx; se vy nn; jmp nnn
+    static auto idle_skp_jmp(chip8& chip, instruction instr) -> void;     //skp vx; jmp nnn
+    static auto idle_sknp_jmp(chip8& chip, instruction instr) -> void;    //sknp vx; jmp nnn
 
+    // Count the iterations of an idle loop that end before the timers next tick. Returns false if none do.
+    static auto skip_idle_loop(chip8& chip, uint64_t length) noexcept -> bool;
 
-    // Map each opcode enum to the appropriate function
-    static inline const std::unordered_map<Opcodes, std::function<void(chip8&, instruction)>> opcode_map = {
-        {Opcodes::cls,         cls},
-        {Opcodes::ret,         ret},
-        {Opcodes::sys_nnn,     sys_nnn},
-        {Opcodes::jmp_nnn,     jmp_nnn},
-        {Opcodes::call_nnn,    call_nnn},
-        {Opcodes::se_vx_nn,    se_vx_nn},
-        {Opcodes::sne_vx_nn,   sne_vx_nn},
-        {Opcodes::se_vx_vy,    se_vx_vy},
-        {Opcodes::mov_vx_nn,   mov_vx_nn},
-        {Opcodes::add_vx_nn,   add_vx_nn},
-        {Opcodes::mov_vx_vy,   mov_vx_vy},
-        {Opcodes::or_vx_vy,    or_vx_vy},
-        {Opcodes::and_vx_vy,   and_vx_vy},
-        {Opcodes::xor_vx_vy,   xor_vx_vy},
-        {Opcodes::add_vx_vy,   add_vx_vy},
-        {Opcodes::sub_vx_vy,   sub_vx_vy},
-        {Opcodes::shr_vx,      shr_vx},
-        {Opcodes::subn_vx_vy,  subn_vx_vy},
-        {Opcodes::shl_vx,      shl_vx},
-        {Opcodes::sne_vx_vy,   sne_vx_vy},
-        {Opcodes::mov_i_nnn,   mov_i_nnn},
-        {Opcodes::jmp_v0_nnn,  jmp_v0_nnn},
-        {Opcodes::rnd_vx_nn,   rnd_vx_nn},
-        {Opcodes::drw_vx_vy_n, drw_vx_vy_n},
-        {Opcodes::skp_vx,      skp_vx},
-        {Opcodes::sknp_vx,     sknp_vx},
-        {Opcodes::gdly_vx,     gdly_vx},
-        {Opcodes::key_vx,      key_vx},
-        {Opcodes::sdly_vx,     sdly_vx},
-        {Opcodes::ssnd_vx,     ssnd_vx},
-        {Opcodes::add_i_vx,    add_i_vx},
-        {Opcodes::font_vx,     font_vx},
-        {Opcodes::bcd_vx,      bcd_vx},
-        {Opcodes::str_v0_vx,   str_v0_vx},
-        {Opcodes::ld_v0_vx,    ld_v0_vx},
-    };
 };
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+
+/**
+ * @enum QuirkProfile
+ *
+ * @brief The interpreters whose behavior the instructions can follow
+ *
+ * @details CHIP-8 interpreters disagree on the details of a few instructions,
+ *          and ROMs are written for the behavior of a particular interpreter.
+ *          Each profile is the set of @ref quirks of one interpreter.
+ */
+enum class QuirkProfile : uint8_t {
+    cosmac_vip, //The original COSMAC VIP interpreter
+    schip,      //SUPER-CHIP 1.1 on the HP48
+    xo_chip,    //XO-CHIP, as implemented by Octo
+};
+
+/// The number of values in @ref QuirkProfile
+inline constexpr size_t quirk_profile_count = 3;
+
+
+/// Convert a @ref QuirkProfile to a string
+[[nodiscard]]
+constexpr auto to_string(QuirkProfile profile) noexcept -> std::string_view {
+    switch (profile) {
+        case QuirkProfile::cosmac_vip: return "vip";
+        case QuirkProfile::schip:      return "schip";
+        case QuirkProfile::xo_chip:    return "xo-chip";
+        default:                       return "unknown";
+    }
+}
+
+/// Convert a string produced by to_string(QuirkProfile) to a @ref QuirkProfile
+[[nodiscard]]
+constexpr auto to_quirk_profile(std::string_view str) noexcept -> std::optional<QuirkProfile> {
+    for (uint8_t idx = 0; idx < quirk_profile_count; ++idx) {
+        if (to_string(static_cast<QuirkProfile>(idx)) == str) {
+            return static_cast<QuirkProfile>(idx);
+        }
+    }
+    return {};
+}
+
+
+/**
+ * @struct quirks
+ *
+ * @brief The behaviors of the instructions that differ between interpreters
+ *
+ * @details The interpreter is instantiated for each profile with its quirks
+ *          as a template argument, so the handlers don't check them at runtime.
+ */
+struct quirks {
+    // shr and shl (8xy6, 8xyE) shift vy into vx, instead of shifting vx in place
+    bool shift_vy = false;
+
+    // str and ld (Fx55, Fx65) add x + 1 to i
+    bool increment_i = false;
+
+    // or, and, and xor (8xy1, 8xy2, 8xy3) set vf to 0
+    bool vf_reset = false;
+
+    // jmp v0 (Bnnn) jumps to xnn + vx, instead of nnn + v0
+    bool jump_vx = false;
+
+    // Sprites wrap around the edges of the display, instead of being clipped
+    bool wrap = false;
+
+    // drw (Dxyn) waits for the next 60Hz frame before drawing, so it uses the rest of the frame's instructions
+    bool display_wait = false;
+};
+
+
+/// Get the quirks of a profile
+[[nodiscard]]
+constexpr auto get_quirks(QuirkProfile profile) noexcept -> quirks {
+    switch (profile) {
+        case QuirkProfile::cosmac_vip:
+            return quirks{.shift_vy = true, .increment_i = true, .vf_reset = true, .jump_vx = false, .wrap = false, .display_wait = true};
+
+        case QuirkProfile::schip:
+            return quirks{.shift_vy = false, .increment_i = false, .vf_reset = false, .jump_vx = true, .wrap = false, .display_wait = false};
+
+        case QuirkProfile::xo_chip:
+        default:
+            return quirks{.shift_vy = true, .increment_i = true, .vf_reset = false, .jump_vx = false, .wrap = true, .display_wait = false};
+    }
+}
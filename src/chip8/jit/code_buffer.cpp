@@ -0,0 +1,54 @@
+#include "code_buffer.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+
+CodeBuffer::CodeBuffer(size_t capacity) {
+#if defined(_WIN32)
+	void* const ptr = VirtualAlloc(nullptr, capacity, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+	if (ptr) {
+		memory = static_cast<uint8_t*>(ptr);
+		total  = capacity;
+	}
+#else
+	void* const ptr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr != MAP_FAILED) {
+		memory = static_cast<uint8_t*>(ptr);
+		total  = capacity;
+	}
+#endif
+}
+
+
+CodeBuffer::~CodeBuffer() {
+	if (!memory) {
+		return;
+	}
+#if defined(_WIN32)
+	VirtualFree(memory, 0, MEM_RELEASE);
+#else
+	munmap(memory, total);
+#endif
+}
+
+
+auto CodeBuffer::append(std::span<const uint8_t> code) noexcept -> const void* {
+	// Keep each block 16-byte aligned
+	const size_t start = (used + 15) & ~size_t{15};
+
+	if (!memory or (start + code.size()) > total) {
+		return nullptr;
+	}
+
+	std::memcpy(memory + start, code.data(), code.size());
+	used = start + code.size();
+
+	return memory + start;
+}
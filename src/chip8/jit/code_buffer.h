@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+
+/**
+ * @class CodeBuffer
+ *
+ * @brief A fixed size region of executable memory which code is appended to
+ *
+ * @details Code is never freed individually. When the buffer is full, the
+ *          owner discards everything with reset() at a point where none of
+ *          the code is executing.
+ */
+class CodeBuffer {
+public:
+    explicit CodeBuffer(size_t capacity);
+    ~CodeBuffer();
+
+    CodeBuffer(const CodeBuffer&) = delete;
+    CodeBuffer(CodeBuffer&&) = delete;
+    auto operator=(const CodeBuffer&) -> CodeBuffer& = delete;
+    auto operator=(CodeBuffer&&) -> CodeBuffer& = delete;
+
+    /**
+     * @brief Copy machine code into the buffer
+     *
+     * @param[in] code  The machine code to copy
+     *
+     * @return A pointer to the executable copy, or nullptr if there isn't enough space.
+     */
+    [[nodiscard]]
+    auto append(std::span<const uint8_t> code) noexcept -> const void*;
+
+    /// Discard all code in the buffer
+    auto reset() noexcept -> void {
+        used = 0;
+    }
+
+    /// Check if the executable memory was allocated successfully
+    [[nodiscard]]
+    auto is_valid() const noexcept -> bool {
+        return memory != nullptr;
+    }
+
+    [[nodiscard]]
+    auto size() const noexcept -> size_t {
+        return used;
+    }
+
+    [[nodiscard]]
+    auto capacity() const noexcept -> size_t {
+        return total;
+    }
+
+private:
+
+    uint8_t* memory = nullptr;
+    size_t total = 0;
+    size_t used = 0;
+};
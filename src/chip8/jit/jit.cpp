@@ -0,0 +1,285 @@
+#include "jit.h"
+#include "chip8/isa/isa.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+
+// The ISA handlers are called with the instruction passed by value in a register
+static_assert(sizeof(instruction) == sizeof(uint64_t));
+static_assert(std::is_trivially_copyable_v<instruction>);
+
+
+JIT::JIT(const chip8& chip) : code(code_cache_size) {
+	const auto* base = reinterpret_cast<const uint8_t*>(&chip);
+
+	v_offset  = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(chip.state.v.data()) - base);
+	i_offset  = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&chip.state.i) - base);
+	pc_offset = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&chip.state.pc) - base);
+}
+
+
+auto JIT::execute(chip8& chip) -> uint32_t {
+	const uint16_t start = chip.state.pc;
+
+	if (!blocks[start].entry and !compile(chip, start)) {
+		// The code cache is full. No block is running at this point, so it can be safely discarded.
+		clear();
+
+		if (!compile(chip, start)) {
+			chip.interpret(chip);
+			return 1;
+		}
+	}
+
+	// Read the block info before running it, since the block may invalidate itself
+	const auto& blk = blocks[start];
+	const uint32_t count = blk.instruction_count;
+
+	blk.entry(&chip);
+
+	return count;
+}
+
+
+auto JIT::invalidate(size_t address, size_t count) noexcept -> void {
+	const size_t last = std::min(address + count, chip8::max_memory_size);
+
+	if (address >= last or std::none_of(compiled_bytes.begin() + address, compiled_bytes.begin() + last, std::identity{})) {
+		return;
+	}
+
+	// Any block that overlaps the range must start within one block length before it
+	const size_t max_block_bytes = max_block_instructions * 2;
+	const size_t first = (address >= max_block_bytes) ? (address - max_block_bytes + 1) : 0;
+
+	for (size_t start = first; start < last; ++start) {
+		if (blocks[start].entry and blocks[start].end > address) {
+			blocks[start] = block{};
+		}
+	}
+}
+
+
+auto JIT::clear() noexcept -> void {
+	blocks.fill(block{});
+	compiled_bytes.fill(false);
+	code.reset();
+}
+
+
+auto JIT::compile(const chip8& chip, uint16_t start) -> bool {
+	// The profile can only change by clearing the compiled blocks, so every block follows the current quirks
+	handlers      = chip.handlers;
+	active_quirks = get_quirks(chip.get_quirk_profile());
+
+	emitter.clear();
+	emitter.prologue();
+
+	uint16_t address = start;
+	uint16_t count = 0;
+	bool terminated = false;
+
+	// One past the last byte the block depends on. A skip, which always ends a
+	// block, also depends on the next word, since it selects whether the skip
+	// is 2 or 4 bytes. The word after the last instruction is always included.
+	size_t end = start;
+
+	while (!terminated and (static_cast<size_t>(address) + 1) < chip8::max_memory_size) {
+		const auto instr = instruction{chip.state.memory[address], chip.state.memory[address + 1]};
+
+		// End the block before the end of the ROM or a breakpoint, so chip8::run_cycle checks them.
+		// The timers are advanced after the block, so an instruction that uses them starts a new one.
+		if (count > 0) {
+			if ((address >= chip.rom_end) or (count == max_block_instructions) or uses_timers(instr.opcode)) {
+				break;
+			}
+			if (chip.breakpoints.contains((address - chip8::rom_start) / 2)) {
+				break;
+			}
+		}
+
+		// The XO-CHIP long load (0xF000 nnnn) is the only 4 byte instruction
+		const size_t next = static_cast<size_t>(address) + 2;
+		const bool long_load = (chip.state.memory[next & chip.state.address_mask] == 0xF0) and (chip.state.memory[(next + 1) & chip.state.address_mask] == 0x00);
+
+		terminated = emit_instruction(instr, address, long_load ? 4 : 2);
+
+		end = std::max(end, static_cast<size_t>(address) + (terminated ? 4 : 2));
+		address += 2;
+		++count;
+	}
+	end = std::min(end, chip8::max_memory_size);
+
+	// Continue from the next instruction if the block didn't end with a branch
+	if (!terminated) {
+		emitter.mov_m16_imm(pc_offset, address);
+	}
+
+	emitter.epilogue();
+
+	const void* const entry = code.append(emitter.code());
+	if (!entry) {
+		return false;
+	}
+
+	auto& blk = blocks[start];
+	blk.entry = reinterpret_cast<decltype(blk.entry)>(const_cast<void*>(entry));
+	blk.end = static_cast<uint32_t>(end);
+	blk.instruction_count = count;
+
+	std::fill(compiled_bytes.begin() + start, compiled_bytes.begin() + end, true);
+
+	return true;
+}
+
+
+auto JIT::emit_instruction(instruction instr, uint16_t address, uint16_t next_size) -> bool {
+	using Reg = X64Emitter::Reg;
+	using Cond = X64Emitter::Cond;
+	using AluOp = X64Emitter::AluOp;
+
+	const int32_t vx = v_offset + instr.x;
+	const int32_t vy = v_offset + instr.y;
+	const int32_t vf = v_offset + 0xF;
+
+	// Set the PC to skip the next instruction if the flags match the condition
+	const auto emit_skip = [&](Cond cond) {
+		emitter.cmovcc(cond, Reg::rax, Reg::rcx);
+		emitter.mov_m16_r16(pc_offset, Reg::rax);
+	};
+
+	switch (instr.opcode) {
+		case Opcodes::sys_nnn:
+			return false;
+
+		case Opcodes::jmp_nnn:
+			emitter.mov_m16_imm(pc_offset, instr.nnn);
+			return true;
+
+		case Opcodes::se_vx_nn:
+		case Opcodes::sne_vx_nn:
+			emitter.mov_r32_imm(Reg::rax, address + 2);
+			emitter.mov_r32_imm(Reg::rcx, address + 2 + next_size);
+			emitter.cmp_m8_imm(vx, instr.nn);
+			emit_skip((instr.opcode == Opcodes::se_vx_nn) ? Cond::equal : Cond::not_equal);
+			return true;
+
+		case Opcodes::se_vx_vy:
+		case Opcodes::sne_vx_vy:
+			emitter.mov_r32_imm(Reg::rax, address + 2);
+			emitter.mov_r32_imm(Reg::rcx, address + 2 + next_size);
+			emitter.mov_r8_m8(Reg::rdx, vx);
+			emitter.alu_r8_m8(AluOp::cmp, Reg::rdx, vy);
+			emit_skip((instr.opcode == Opcodes::se_vx_vy) ? Cond::equal : Cond::not_equal);
+			return true;
+
+		case Opcodes::mov_vx_nn:
+			emitter.mov_m8_imm(vx, instr.nn);
+			return false;
+
+		case Opcodes::add_vx_nn:
+			emitter.add_m8_imm(vx, instr.nn);
+			return false;
+
+		case Opcodes::mov_vx_vy:
+			emitter.mov_r8_m8(Reg::rax, vy);
+			emitter.mov_m8_r8(vx, Reg::rax);
+			return false;
+
+		case Opcodes::or_vx_vy:
+		case Opcodes::and_vx_vy:
+		case Opcodes::xor_vx_vy: {
+			const auto op = (instr.opcode == Opcodes::or_vx_vy)  ? AluOp::or_
+			              : (instr.opcode == Opcodes::and_vx_vy) ? AluOp::and_
+			              : AluOp::xor_;
+			emitter.mov_r8_m8(Reg::rax, vx);
+			emitter.alu_r8_m8(op, Reg::rax, vy);
+			emitter.mov_m8_r8(vx, Reg::rax);
+			if (active_quirks.vf_reset) {
+				emitter.mov_m8_imm(vf, 0);
+			}
+			return false;
+		}
+
+		case Opcodes::add_vx_vy:
+			emitter.mov_r8_m8(Reg::rax, vx);
+			emitter.alu_r8_m8(AluOp::add, Reg::rax, vy);
+			emitter.setcc(Cond::below, Reg::rcx);
+			emitter.mov_m8_r8(vx, Reg::rax);
+			emitter.mov_m8_r8(vf, Reg::rcx);
+			return false;
+
+		case Opcodes::sub_vx_vy:
+		case Opcodes::subn_vx_vy: {
+			// vf is written before the subtraction, so the operands are reloaded after it
+			const bool subn = (instr.opcode == Opcodes::subn_vx_vy);
+			const int32_t lhs = subn ? vy : vx;
+			const int32_t rhs = subn ? vx : vy;
+
+			emitter.mov_r8_m8(Reg::rax, lhs);
+			emitter.alu_r8_m8(AluOp::cmp, Reg::rax, rhs);
+			emitter.setcc(Cond::above, Reg::rcx);
+			emitter.mov_m8_r8(vf, Reg::rcx);
+			emitter.mov_r8_m8(Reg::rax, lhs);
+			emitter.alu_r8_m8(AluOp::sub, Reg::rax, rhs);
+			emitter.mov_m8_r8(vx, Reg::rax);
+			return false;
+		}
+
+		case Opcodes::mov_i_nnn:
+			emitter.mov_m16_imm(i_offset, instr.nnn);
+			return false;
+
+		case Opcodes::font_vx:
+			emitter.movzx_r32_m8(Reg::rax, vx);
+			emitter.lea_times5(Reg::rax);
+			emitter.mov_m16_r16(i_offset, Reg::rax);
+			return false;
+
+		case Opcodes::add_i_vx:
+			// vf is written before i, so vx is reloaded after it
+			emitter.movzx_r32_m16(Reg::rax, i_offset);
+			emitter.movzx_r32_m8(Reg::rcx, vx);
+			emitter.add_r16_r16(Reg::rax, Reg::rcx);
+			emitter.setcc(Cond::below, Reg::rdx);
+			emitter.mov_m8_r8(vf, Reg::rdx);
+			emitter.movzx_r32_m8(Reg::rcx, vx);
+			emitter.add_m16_r16(i_offset, Reg::rcx);
+			return false;
+
+		// Instructions that change control flow or memory end the block
+		case Opcodes::ret:
+		case Opcodes::call_nnn:
+		case Opcodes::jmp_v0_nnn:
+		case Opcodes::drw_vx_vy_n:
+		case Opcodes::skp_vx:
+		case Opcodes::sknp_vx:
+		case Opcodes::exit:
+		case Opcodes::key_vx:
+		case Opcodes::bcd_vx:
+		case Opcodes::str_v0_vx:
+		case Opcodes::save_vx_vy:
+		case Opcodes::mov_i_nnnn:
+		case Opcodes::invalid:
+			emit_fallback(instr, address);
+			return true;
+
+		default:
+			emit_fallback(instr, address);
+			return false;
+	}
+}
+
+
+auto JIT::emit_fallback(instruction instr, uint16_t address) -> void {
+	// The handler expects the PC to point at its instruction
+	emitter.mov_m16_imm(pc_offset, address);
+
+	uint64_t arg = 0;
+	std::memcpy(&arg, &instr, sizeof(instr));
+
+	const auto handler = (*handlers)[to_index(instr.opcode)];
+	emitter.call(reinterpret_cast<const void*>(handler), arg);
+}
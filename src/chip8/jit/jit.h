@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "code_buffer.h"
+#include "x64_emitter.h"
+#include "chip8/chip8.h"
+#include "instruction/instruction.h"
+
+
+/**
+ * @class JIT
+ *
+ * @brief Compiles CHIP-8 basic blocks to x86-64 machine code
+ *
+ * @details A block starts at the PC and ends after the first instruction that
+ *          changes control flow or memory (jumps, calls, returns, skips,
+ *          key waits, draws, and stores), before a breakpoint, at the end of
+ *          the ROM, before an instruction that uses the timers (see
+ *          uses_timers), or after a maximum number of instructions. Simple
+ *          register operations are translated directly. All other
+ *          instructions call their ISA handler.
+ *
+ *          Compiled blocks are kept in an executable code cache keyed by
+ *          their start address, and are discarded when any byte they were
+ *          compiled from is written.
+ */
+class JIT {
+public:
+
+    /// Check if the JIT can run on the host architecture
+    [[nodiscard]]
+    static constexpr auto is_supported() noexcept -> bool {
+#if defined(__x86_64__) || defined(_M_X64)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @param[in] chip  The chip8 that the JIT will execute code for
+     */
+    explicit JIT(const chip8& chip);
+
+    /**
+     * @brief Execute the block at the chip's PC, compiling it first if needed
+     *
+     * @param[in] chip  The chip8 to execute. Must be the one the JIT was created for.
+     *
+     * @return The number of instructions executed
+     */
+    auto execute(chip8& chip) -> uint32_t;
+
+    /**
+     * @brief Discard any blocks compiled from the specified memory range
+     *
+     * @param[in] address  The first address that was written
+     * @param[in] count    The number of bytes that were written
+     */
+    auto invalidate(size_t address, size_t count) noexcept -> void;
+
+    /// Discard all compiled blocks
+    auto clear() noexcept -> void;
+
+private:
+
+    struct block {
+        // The compiled function, or nullptr if there's no block at this address
+        auto (*entry)(chip8*) -> void = nullptr;
+
+        // One past the last byte the block was compiled from
+        uint32_t end = 0;
+
+        // The number of CHIP-8 instructions in the block
+        uint16_t instruction_count = 0;
+    };
+
+    // Compile the block that starts at the address. Returns false if the code cache is full.
+    auto compile(const chip8& chip, uint16_t start) -> bool;
+
+    // Emit the code for a single instruction. Returns true if the instruction ends the block.
+    // next_size is the size of the following instruction, which a skip jumps over.
+    auto emit_instruction(instruction instr, uint16_t address, uint16_t next_size) -> bool;
+
+    // Emit a call to the ISA handler for an instruction
+    auto emit_fallback(instruction instr, uint16_t address) -> void;
+
+
+    // The maximum number of instructions compiled into a single block
+    static constexpr uint16_t max_block_instructions = 64;
+
+    // The size of the executable code cache
+    static constexpr size_t code_cache_size = 1024 * 1024;
+
+    // The ISA handlers and quirks of the chip8 that the blocks are compiled for
+    const std::array<instruction_handler, opcode_count>* handlers = nullptr;
+    quirks active_quirks = {};
+
+    // Offsets of the chip8 state from the start of the object
+    int32_t v_offset  = 0;
+    int32_t i_offset  = 0;
+    int32_t pc_offset = 0;
+
+    // Compiled blocks, indexed by their start address
+    std::array<block, chip8::max_memory_size> blocks = {};
+
+    // Marks each memory address that any block has been compiled from
+    std::array<bool, chip8::max_memory_size> compiled_bytes = {};
+
+    // Executable memory holding the compiled code
+    CodeBuffer code;
+
+    // The block that is currently being compiled
+    X64Emitter emitter;
+};
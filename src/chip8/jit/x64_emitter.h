@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+
+/**
+ * @class X64Emitter
+ *
+ * @brief Encodes the small subset of x86-64 instructions used by the JIT
+ *
+ * @details Memory operands are always addressed as [rbx + disp32], where rbx
+ *          holds the address of the chip8 being executed. Register operands
+ *          are given by their encoding number (see @ref Reg).
+ */
+class X64Emitter {
+public:
+
+    /// Register encoding numbers. The same number selects the 8, 16, or 32-bit form of the register.
+    enum Reg : uint8_t {
+        rax = 0,
+        rcx = 1,
+        rdx = 2,
+        rbx = 3,
+    };
+
+    /// Condition codes used by setcc and cmovcc
+    enum Cond : uint8_t {
+        below     = 0x2, //carry
+        equal     = 0x4,
+        not_equal = 0x5,
+        above     = 0x7,
+    };
+
+    /// Opcodes of the "op r8, r/m8" ALU instructions
+    enum AluOp : uint8_t {
+        add = 0x02,
+        or_ = 0x0A,
+        and_ = 0x22,
+        sub = 0x2A,
+        xor_ = 0x32,
+        cmp = 0x3A,
+    };
+
+
+    //--------------------------------------------------------------------------------
+    // Function Frame
+    //--------------------------------------------------------------------------------
+
+    /// Save rbx, move the first argument into it, and reserve shadow space for calls
+    auto prologue() -> void {
+        emit(0x53);                   //push rbx
+#if defined(_WIN64)
+        emit(0x48, 0x89, 0xCB);       //mov rbx, rcx
+#else
+        emit(0x48, 0x89, 0xFB);       //mov rbx, rdi
+#endif
+        emit(0x48, 0x83, 0xEC, 0x20); //sub rsp, 32
+    }
+
+    /// Undo the prologue and return
+    auto epilogue() -> void {
+        emit(0x48, 0x83, 0xC4, 0x20); //add rsp, 32
+        emit(0x5B);                   //pop rbx
+        emit(0xC3);                   //ret
+    }
+
+    /// Call a function with rbx as the first argument and an immediate as the second
+    auto call(const void* function, uint64_t arg1) -> void {
+#if defined(_WIN64)
+        emit(0x48, 0x89, 0xD9);       //mov rcx, rbx
+        emit(0x48, 0xBA);             //mov rdx, imm64
+#else
+        emit(0x48, 0x89, 0xDF);       //mov rdi, rbx
+        emit(0x48, 0xBE);             //mov rsi, imm64
+#endif
+        emit_imm(arg1);
+
+        emit(0x48, 0xB8);             //mov rax, imm64
+        emit_imm(reinterpret_cast<uint64_t>(function));
+        emit(0xFF, 0xD0);             //call rax
+    }
+
+
+    //--------------------------------------------------------------------------------
+    // 8-bit Operations
+    //--------------------------------------------------------------------------------
+
+    /// mov byte [rbx + disp], imm
+    auto mov_m8_imm(int32_t disp, uint8_t imm) -> void {
+        emit(0xC6);
+        emit_mem(0, disp);
+        emit(imm);
+    }
+
+    /// add byte [rbx + disp], imm
+    auto add_m8_imm(int32_t disp, uint8_t imm) -> void {
+        emit(0x80);
+        emit_mem(0, disp);
+        emit(imm);
+    }
+
+    /// cmp byte [rbx + disp], imm
+    auto cmp_m8_imm(int32_t disp, uint8_t imm) -> void {
+        emit(0x80);
+        emit_mem(7, disp);
+        emit(imm);
+    }
+
+    /// mov r8, byte [rbx + disp]
+    auto mov_r8_m8(Reg reg, int32_t disp) -> void {
+        emit(0x8A);
+        emit_mem(reg, disp);
+    }
+
+    /// mov byte [rbx + disp], r8
+    auto mov_m8_r8(int32_t disp, Reg reg) -> void {
+        emit(0x88);
+        emit_mem(reg, disp);
+    }
+
+    /// op r8, byte [rbx + disp]
+    auto alu_r8_m8(AluOp op, Reg reg, int32_t disp) -> void {
+        emit(op);
+        emit_mem(reg, disp);
+    }
+
+    /// setcc r8
+    auto setcc(Cond cond, Reg reg) -> void {
+        emit(0x0F, static_cast<uint8_t>(0x90 | cond), static_cast<uint8_t>(0xC0 | reg));
+    }
+
+
+    //--------------------------------------------------------------------------------
+    // 16 and 32-bit Operations
+    //--------------------------------------------------------------------------------
+
+    /// mov word [rbx + disp], imm
+    auto mov_m16_imm(int32_t disp, uint16_t imm) -> void {
+        emit(0x66, 0xC7);
+        emit_mem(0, disp);
+        emit_imm(imm);
+    }
+
+    /// mov word [rbx + disp], r16
+    auto mov_m16_r16(int32_t disp, Reg reg) -> void {
+        emit(0x66, 0x89);
+        emit_mem(reg, disp);
+    }
+
+    /// add word [rbx + disp], r16
+    auto add_m16_r16(int32_t disp, Reg reg) -> void {
+        emit(0x66, 0x01);
+        emit_mem(reg, disp);
+    }
+
+    /// add dst16, src16
+    auto add_r16_r16(Reg dst, Reg src) -> void {
+        emit(0x66, 0x01, static_cast<uint8_t>(0xC0 | (src << 3) | dst));
+    }
+
+    /// movzx r32, byte [rbx + disp]
+    auto movzx_r32_m8(Reg reg, int32_t disp) -> void {
+        emit(0x0F, 0xB6);
+        emit_mem(reg, disp);
+    }
+
+    /// movzx r32, word [rbx + disp]
+    auto movzx_r32_m16(Reg reg, int32_t disp) -> void {
+        emit(0x0F, 0xB7);
+        emit_mem(reg, disp);
+    }
+
+    /// mov r32, imm
+    auto mov_r32_imm(Reg reg, uint32_t imm) -> void {
+        emit(static_cast<uint8_t>(0xB8 | reg));
+        emit_imm(imm);
+    }
+
+    /// cmovcc dst32, src32
+    auto cmovcc(Cond cond, Reg dst, Reg src) -> void {
+        emit(0x0F, static_cast<uint8_t>(0x40 | cond), static_cast<uint8_t>(0xC0 | (dst << 3) | src));
+    }
+
+    /// lea r32, [r + r*4]
+    auto lea_times5(Reg reg) -> void {
+        emit(0x8D, static_cast<uint8_t>((reg << 3) | 0x4), static_cast<uint8_t>(0x80 | (reg << 3) | reg));
+    }
+
+
+    //--------------------------------------------------------------------------------
+    // Output
+    //--------------------------------------------------------------------------------
+
+    /// Get the encoded machine code
+    [[nodiscard]]
+    auto code() const noexcept -> std::span<const uint8_t> {
+        return bytes;
+    }
+
+    /// Discard the encoded machine code
+    auto clear() noexcept -> void {
+        bytes.clear();
+    }
+
+private:
+
+    template<typename... ArgsT>
+    auto emit(ArgsT... values) -> void {
+        (bytes.push_back(static_cast<uint8_t>(values)), ...);
+    }
+
+    template<typename T>
+    auto emit_imm(T value) -> void {
+        uint8_t raw[sizeof(T)];
+        std::memcpy(raw, &value, sizeof(T)); //x86 is little endian, same as the immediate encoding
+        bytes.insert(bytes.end(), raw, raw + sizeof(T));
+    }
+
+    // ModRM for [rbx + disp32] with the given reg field
+    auto emit_mem(uint8_t reg, int32_t disp) -> void {
+        emit(static_cast<uint8_t>(0x80 | (reg << 3) | Reg::rbx));
+        emit_imm(disp);
+    }
+
+
+    std::vector<uint8_t> bytes;
+};
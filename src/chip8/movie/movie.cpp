@@ -0,0 +1,293 @@
+#include "movie.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#include "util/fnv1a/fnv1a.h"
+#include "util/mapped_file/mapped_file.h"
+#include "util/varint/varint.h"
+
+
+// Identifies a movie file
+static constexpr std::array<char, 8> movie_magic = {'C', 'H', 'I', 'P', '8', 'M', 'O', 'V'};
+
+// The number of bits of an encoded event that hold the key and its state
+static constexpr unsigned event_key_bits = 5;
+
+
+// Compute the checksum of a header and the events that follow it
+[[nodiscard]]
+static auto compute_checksum(const movie_header& header, std::span<const uint8_t> events) noexcept -> uint64_t {
+	const auto hash = fnv1a({reinterpret_cast<const uint8_t*>(&header), offsetof(movie_header, checksum)});
+	return fnv1a(events, hash);
+}
+
+
+//----------------------------------------------------------------------------------
+// Movie
+//----------------------------------------------------------------------------------
+
+Movie::Movie(const chip8& chip) {
+	const auto& state = chip.get_state();
+
+	header.magic                  = movie_magic;
+	header.version                = movie_version;
+	header.platform               = chip.platform;
+	header.quirk_profile          = chip.quirk_profile;
+	header.clock_mode             = chip.clock_mode;
+	header.initial_keys           = state.keys;
+	header.clock_rate             = chip.clock_rate;
+	header.instructions_per_frame = chip.instructions_per_frame;
+	header.rng_seed               = state.rng_seed;
+	header.length                 = chip.get_cycle_count();
+	header.final_hash             = chip.hash_state();
+	header.rom_size               = static_cast<uint32_t>(chip.rom_end - chip8::rom_start);
+	header.rpl_flags              = state.rpl_flags;
+	header.rom_digest             = chip.rom_digest;
+}
+
+
+auto Movie::finish(const chip8& chip, const InputLog& input) -> void {
+	const auto all_events = input.get_events();
+	const auto last = input.find(chip.get_cycle_count() + 1);
+
+	events.assign(all_events.begin(), all_events.begin() + static_cast<ptrdiff_t>(last));
+
+	header.length      = chip.get_cycle_count();
+	header.final_hash  = chip.hash_state();
+	header.event_count = static_cast<uint32_t>(events.size());
+}
+
+
+auto Movie::write(const std::filesystem::path& file) const -> bool {
+	auto encoded = std::vector<uint8_t>{};
+	encoded.reserve(events.size() * 3);
+
+	uint64_t cycle = 0;
+	for (const auto& event : events) {
+		const uint64_t flags = (uint64_t{event.pressed} << 4) | static_cast<uint8_t>(event.key);
+		write_varint(((event.cycle - cycle) << event_key_bits) | flags, encoded);
+		cycle = event.cycle;
+	}
+
+	auto out_header = header;
+	out_header.event_bytes = static_cast<uint32_t>(encoded.size());
+	out_header.checksum    = compute_checksum(out_header, encoded);
+
+	auto error = std::error_code{};
+	if (file.has_parent_path()) {
+		std::filesystem::create_directories(file.parent_path(), error);
+	}
+
+	auto temp_file = file;
+	temp_file += ".tmp";
+
+	{
+		std::ofstream out(temp_file, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&out_header), sizeof(out_header));
+		out.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+		if (!out) {
+			std::cout << "Error writing the movie " << file << '\n';
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temp_file, file, error);
+	if (error) {
+		std::cout << "Error writing the movie " << file << ": " << error.message() << '\n';
+		std::filesystem::remove(temp_file, error);
+		return false;
+	}
+
+	return true;
+}
+
+
+auto Movie::parse(std::span<const uint8_t> data) -> std::optional<Movie> {
+	if (data.size() < sizeof(movie_header)) {
+		std::cout << "Error loading the movie: The file is too small\n";
+		return std::nullopt;
+	}
+
+	auto movie = Movie{};
+	std::memcpy(&movie.header, data.data(), sizeof(movie_header));
+	const auto& header = movie.header;
+	auto encoded = data.subspan(sizeof(movie_header));
+
+	if (header.magic != movie_magic) {
+		std::cout << "Error loading the movie: The file isn't a movie\n";
+		return std::nullopt;
+	}
+	if (header.version != movie_version) {
+		std::cout << "Error loading the movie: It has version " << header.version << ", but version " << movie_version << " is supported\n";
+		return std::nullopt;
+	}
+	if ((header.platform > Platform::xo_chip) or (header.quirk_profile > QuirkProfile::xo_chip)
+	    or (header.clock_mode > ClockMode::instructions_per_frame) or (encoded.size() != header.event_bytes)
+	    or (header.clock_rate == 0) or (header.clock_rate > chip8::max_clock_rate)
+	    or (header.instructions_per_frame == 0) or (header.instructions_per_frame > chip8::max_instructions_per_frame)
+	    or (header.event_count > header.event_bytes)) {
+		std::cout << "Error loading the movie: The file is malformed\n";
+		return std::nullopt;
+	}
+	if (compute_checksum(header, encoded) != header.checksum) {
+		std::cout << "Error loading the movie: The checksum doesn't match\n";
+		return std::nullopt;
+	}
+
+	movie.events.reserve(header.event_count);
+	uint64_t cycle = 0;
+
+	while (!encoded.empty()) {
+		const auto value = read_varint(encoded);
+		const uint64_t delta = value ? (*value >> event_key_bits) : 0;
+
+		if (!value or (delta > (header.length - cycle))) {
+			std::cout << "Error loading the movie: The file is malformed\n";
+			return std::nullopt;
+		}
+
+		cycle += delta;
+		movie.events.push_back({cycle, static_cast<Keys>(*value & 0xF), ((*value >> 4) & 1) != 0});
+	}
+
+	if (movie.events.size() != header.event_count) {
+		std::cout << "Error loading the movie: The file is malformed\n";
+		return std::nullopt;
+	}
+
+	return movie;
+}
+
+
+auto Movie::load(const std::filesystem::path& file) -> std::optional<Movie> {
+	const auto mapping = MappedFile{file};
+	if (!mapping.is_open()) {
+		std::cout << "Error opening the movie " << file << '\n';
+		return std::nullopt;
+	}
+	return parse(mapping.get_bytes());
+}
+
+
+//----------------------------------------------------------------------------------
+// MoviePlayer
+//----------------------------------------------------------------------------------
+
+MoviePlayer::MoviePlayer(Movie movie) : movie(std::move(movie)) {
+}
+
+
+auto MoviePlayer::start(chip8& chip, const std::filesystem::path& rom) -> bool {
+	const auto& header = movie.get_header();
+
+	// Selecting the platform resets the system, so it's applied before the ROM is loaded
+	if (chip.platform != header.platform) {
+		chip.set_platform(header.platform);
+	}
+	if (!chip.load_rom(rom)) {
+		return false;
+	}
+	if (chip.rom_digest != header.rom_digest) {
+		std::cout << "Error playing the movie: It was recorded with a different ROM\n";
+		return false;
+	}
+	if (chip.platform != header.platform) {
+		std::cout << "Error playing the movie: The ROM database selects a different platform than it was recorded with\n";
+		return false;
+	}
+
+	if (chip.quirk_profile != header.quirk_profile) {
+		chip.set_quirk_profile(header.quirk_profile);
+	}
+	chip.clock_mode             = header.clock_mode;
+	chip.clock_rate             = header.clock_rate;
+	chip.instructions_per_frame = header.instructions_per_frame;
+	chip.set_timer_mode(TimerMode::virtual_time);
+	chip.set_rng_seed(header.rng_seed);
+	chip.state.rpl_flags = header.rpl_flags;
+
+	// No key is waited for yet, so setting the keys only changes the bitmask
+	for (uint8_t key = 0; key < 16; ++key) {
+		chip.set_key_state(static_cast<Keys>(key), ((header.initial_keys >> key) & 1) != 0);
+	}
+
+	next_event  = 0;
+	position    = 0;
+	late_events = 0;
+	result      = std::nullopt;
+	return true;
+}
+
+
+auto MoviePlayer::apply_input(chip8& chip, InputLog* input) -> void {
+	const auto events = movie.get_events();
+	const uint64_t cycle = chip.get_cycle_count();
+
+	// The system was rewound, so the events after the new position apply again. Applying the
+	// events stamped at the position again doesn't change anything.
+	if (cycle < position) {
+		const auto it = std::ranges::lower_bound(events, cycle, {}, &input_event::cycle);
+		next_event = static_cast<size_t>(it - events.begin());
+	}
+	position = cycle;
+
+	for (; (next_event < events.size()) and (events[next_event].cycle <= cycle); ++next_event) {
+		const auto& event = events[next_event];
+		if (event.cycle < cycle) {
+			++late_events;
+		}
+
+		chip.set_key_state(event.key, event.pressed);
+		if (input) {
+			input->record(cycle, event.key, event.pressed);
+		}
+	}
+
+	// The recorded hash includes the events applied at the end
+	const auto& header = movie.get_header();
+	if (!result and (cycle >= header.length)) {
+		result = (cycle == header.length) and (chip.hash_state() == header.final_hash);
+	}
+}
+
+
+auto MoviePlayer::run_until(chip8& chip, uint64_t target, InputLog* input) -> bool {
+	// A compiled block or a chain of superinstructions is far shorter than this, but a draw that waits for
+	// the display also skips up to a frame of instructions
+	const uint64_t step_distance = 4096 + (chip.get_timer_clock_rate() / 60);
+
+	while (true) {
+		apply_input(chip, input);
+
+		const uint64_t cycle = chip.get_cycle_count();
+		if (cycle >= target) {
+			return true;
+		}
+		if (chip.is_paused()) {
+			return false;
+		}
+
+		const uint64_t stop = next_stop();
+		if ((stop > cycle) and ((stop - cycle) > step_distance)) {
+			chip.run_cycle();
+		}
+		else {
+			chip.step();
+		}
+	}
+}
+
+
+auto MoviePlayer::next_stop() const noexcept -> uint64_t {
+	const auto events = movie.get_events();
+	const uint64_t end = result ? UINT64_MAX : movie.get_header().length;
+
+	if (next_event < events.size()) {
+		return std::min(events[next_event].cycle, end);
+	}
+	return end;
+}
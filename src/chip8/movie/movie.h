@@ -0,0 +1,279 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "chip8/chip8.h"
+#include "input/input_log.h"
+#include "util/sha1/sha1.h"
+
+
+/// The version of the movie format. Incremented whenever the header or the encoding of the events changes.
+inline constexpr uint32_t movie_version = 1;
+
+
+/**
+ * @struct movie_header
+ * @brief  The header at the start of a movie file, which is followed by the encoded input events
+ */
+struct movie_header {
+    // Identifies a movie file
+    std::array<char, 8> magic;
+
+    // The version of the format (see movie_version)
+    uint32_t version;
+
+    // The settings the movie was recorded with
+    Platform     platform;
+    QuirkProfile quirk_profile;
+    ClockMode    clock_mode;
+
+    // Zero
+    std::array<uint8_t, 3> reserved;
+
+    // The keys that were held when the recording started, as a bitmask like chip8_state::keys
+    uint16_t initial_keys;
+
+    uint32_t clock_rate;
+    uint32_t instructions_per_frame;
+
+    // The seed of the random number generator
+    uint32_t rng_seed;
+
+    // The instruction count the recording ended at, and the hash of the state there (see chip8::hash_state)
+    uint64_t length;
+    uint64_t final_hash;
+
+    // The number of input events, and the number of bytes they're encoded in
+    uint32_t event_count;
+    uint32_t event_bytes;
+
+    // The size of the ROM that was loaded
+    uint32_t rom_size;
+
+    // The RPL user flags when the recording started. They're loaded from a
+    // file with the ROM, so they may differ on the machine the movie is played on.
+    std::array<uint8_t, 16> rpl_flags;
+
+    // The SHA-1 digest of the ROM that was loaded
+    sha1_digest rom_digest;
+
+    // A 64-bit FNV-1a hash of the header up to this member, followed by the events
+    uint64_t checksum;
+};
+
+static_assert(std::has_unique_object_representations_v<movie_header>, "The header is checksummed as bytes, so it can't have padding");
+
+
+/**
+ * @class Movie
+ *
+ * @brief A recording of the input applied to a chip8 from the moment its ROM was loaded
+ *
+ * @details With TimerMode::virtual_time, a run is determined by the ROM, the
+ *          settings, the seed of the random number generator, and the input,
+ *          so a movie is everything needed to repeat a session exactly. Each
+ *          key press and release is stored with the instruction count it was
+ *          applied at (see InputLog), and the movie ends with the hash of the
+ *          state it was recorded up to, which a replay is checked against.
+ *
+ *          The events are stored in order as varints. Each one holds the
+ *          number of instructions since the previous event, shifted left by
+ *          5 bits, then a bit for the new state of the key and 4 bits for the
+ *          key, so an event typically takes 2 or 3 bytes.
+ *
+ *          Movies are replayed with a @ref MoviePlayer.
+ */
+class Movie {
+public:
+
+    /**
+     * @brief Start a recording of a system
+     *
+     * @details The settings and the initial state of the system are captured.
+     *          The system should have just loaded its ROM, and must use
+     *          virtual timers.
+     *
+     * @param[in] chip  The system to record
+     */
+    explicit Movie(const chip8& chip);
+
+    /**
+     * @brief End the recording
+     *
+     * @details The events of the input log up to the current instruction
+     *          count of the system are copied into the movie, so the log must
+     *          hold every event applied since the recording started. The
+     *          hash of the state is recorded for checking replays against.
+     *
+     * @param[in] chip   The system that was recorded
+     * @param[in] input  The input that was applied to the system
+     */
+    auto finish(const chip8& chip, const InputLog& input) -> void;
+
+    /**
+     * @brief Write the movie to a file
+     *
+     * @details The file is written under a temporary name and then renamed,
+     *          like a save state. Missing directories are created.
+     *
+     * @param[in] file  The path of the file
+     *
+     * @return True if the file was written, otherwise false.
+     */
+    [[nodiscard]]
+    auto write(const std::filesystem::path& file) const -> bool;
+
+    /**
+     * @brief Check and decode a movie in the file format
+     *
+     * @param[in] data  A movie in the file format
+     *
+     * @return The movie, or nullopt if the data was rejected.
+     */
+    [[nodiscard]]
+    static auto parse(std::span<const uint8_t> data) -> std::optional<Movie>;
+
+    /// Map a movie file and decode it (see parse)
+    [[nodiscard]]
+    static auto load(const std::filesystem::path& file) -> std::optional<Movie>;
+
+    [[nodiscard]]
+    auto get_header() const noexcept -> const movie_header& {
+        return header;
+    }
+
+    /// Get the input events, oldest first
+    [[nodiscard]]
+    auto get_events() const noexcept -> std::span<const input_event> {
+        return events;
+    }
+
+private:
+
+    Movie() = default;
+
+    movie_header header = {};
+    std::vector<input_event> events;
+};
+
+
+/**
+ * @class MoviePlayer
+ *
+ * @brief Replays the input of a Movie into a chip8
+ *
+ * @details The system is set up as it was when the recording started, then
+ *          executed as usual, and each event is applied when the instruction
+ *          count reaches the count it was recorded at. Superinstructions and
+ *          compiled blocks execute several instructions at a time, so near
+ *          an event the instructions are executed one at a time with
+ *          chip8::step instead, and the event lands between the same two
+ *          instructions as when it was recorded. The rest of the replay runs
+ *          at full speed, which makes movies usable as deterministic
+ *          workloads for benchmarks and regression tests.
+ *
+ *          A compiled block advances the timers once it finishes, and every
+ *          instruction that uses them starts a block (see uses_timers), so
+ *          the blocks leave the same state as stepping their instructions.
+ *          A movie therefore replays with the interpreter, the JIT, or AOT
+ *          programs, whichever it was recorded with.
+ *
+ *          When the instruction count reaches the end of the movie, the hash
+ *          of the state is compared with the recorded one. The system keeps
+ *          running with no further input after that.
+ */
+class MoviePlayer {
+public:
+
+    explicit MoviePlayer(Movie movie);
+
+    /**
+     * @brief Load the ROM of the movie and set up a system to replay it
+     *
+     * @details The ROM is loaded (applying its ROM database settings), then
+     *          the settings, seed, RPL flags, and held keys of the movie are
+     *          applied over it, and virtual timers are selected.
+     *
+     * @param[in] chip  The system to replay the movie on
+     * @param[in] rom   The ROM file. Must be the ROM the movie was recorded with.
+     *
+     * @return True if the system is ready to replay, otherwise false.
+     */
+    [[nodiscard]]
+    auto start(chip8& chip, const std::filesystem::path& rom) -> bool;
+
+    /**
+     * @brief Apply the events stamped at or before the current instruction count
+     *
+     * @details Events that should have been applied earlier are applied now,
+     *          and counted as late. Each applied event is also recorded into
+     *          the input log, if there is one, so the replayed input can be
+     *          rewound and re-executed like live input. If the system was
+     *          moved back to an earlier instruction count, the replay moves
+     *          back with it.
+     *
+     * @param[in] chip   The system the movie is replayed on
+     * @param[in] input  The input log to record the events into. May be null.
+     */
+    auto apply_input(chip8& chip, InputLog* input = nullptr) -> void;
+
+    /**
+     * @brief Execute a system until its instruction count reaches a target, applying the events along the way
+     *
+     * @details Like a series of chip8::run_cycle calls, the system may stop
+     *          a few instructions past the target, but never past an event or
+     *          the end of the movie.
+     *
+     * @param[in] chip    The system the movie is replayed on
+     * @param[in] target  The instruction count to run until
+     * @param[in] input   The input log to record the events into. May be null.
+     *
+     * @return True if the target was reached, otherwise false if the system is paused.
+     */
+    auto run_until(chip8& chip, uint64_t target, InputLog* input = nullptr) -> bool;
+
+    /// Check if the end of the movie was reached and the replay was checked against it (see get_result)
+    [[nodiscard]]
+    auto is_finished() const noexcept -> bool {
+        return result.has_value();
+    }
+
+    /// Get whether the state at the end of the replay matched the recording, or nullopt if the end wasn't reached
+    [[nodiscard]]
+    auto get_result() const noexcept -> std::optional<bool> {
+        return result;
+    }
+
+    /// Get the number of events that were applied after the instruction count they were recorded at
+    [[nodiscard]]
+    auto get_late_events() const noexcept -> size_t {
+        return late_events;
+    }
+
+    [[nodiscard]]
+    auto get_movie() const noexcept -> const Movie& {
+        return movie;
+    }
+
+private:
+
+    /// Get the instruction count of the next event, or the end of the movie if it wasn't reached yet
+    [[nodiscard]]
+    auto next_stop() const noexcept -> uint64_t;
+
+    Movie movie;
+
+    // The index of the next event to apply, and the instruction count input was last applied at
+    size_t next_event = 0;
+    uint64_t position = 0;
+
+    size_t late_events = 0;
+    std::optional<bool> result;
+};
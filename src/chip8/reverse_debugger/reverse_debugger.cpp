@@ -0,0 +1,226 @@
+#include "reverse_debugger.h"
+
+#include <format>
+#include <iostream>
+#include <utility>
+
+
+//----------------------------------------------------------------------------------
+// watch_location
+//----------------------------------------------------------------------------------
+
+auto watch_location::read(const chip8_state& state) const noexcept -> uint16_t {
+	switch (type) {
+		case kind::v_register:     return state.v[address & 0xF];
+		case kind::index_register: return state.i;
+		case kind::stack_pointer:  return state.sp;
+		case kind::memory:         return state.memory[address & state.address_mask];
+	}
+	return 0;
+}
+
+
+auto watch_location::to_string() const -> std::string {
+	switch (type) {
+		case kind::v_register:     return std::format("v{:X}", address & 0xF);
+		case kind::index_register: return "I";
+		case kind::stack_pointer:  return "SP";
+		case kind::memory:         return std::format("memory 0x{:04X}", address);
+	}
+	return {};
+}
+
+
+//----------------------------------------------------------------------------------
+// ReverseDebugger
+//----------------------------------------------------------------------------------
+
+ReverseDebugger::ReverseDebugger(RewindBuffer& history, InputLog& input) :
+	history(history),
+	input(input),
+	frame_state(std::make_unique<chip8_state>()),
+	present(std::make_unique<chip8_state>()) {
+}
+
+
+auto ReverseDebugger::can_reverse(const chip8& chip) const -> bool {
+	if (chip.get_timer_mode() != TimerMode::virtual_time) {
+		std::cout << "Reverse debugging requires virtual timers\n";
+		return false;
+	}
+	if (history.get_frame_count() == 0) {
+		std::cout << "Reverse debugging requires a history to re-execute from\n";
+		return false;
+	}
+	return true;
+}
+
+
+auto ReverseDebugger::seek(chip8& chip, uint64_t cycle) -> bool {
+	if (!can_reverse(chip) or (cycle >= chip.get_cycle_count())) {
+		return false;
+	}
+
+	const auto frame = history.find_frame(cycle);
+	if (!frame) {
+		std::cout << "Instruction " << cycle << " is older than the history\n";
+		return false;
+	}
+
+	chip.snapshot(*present);
+
+	// A draw that waits for the display skips instruction counts, so the target may not be reached exactly
+	auto boundary = std::optional<uint64_t>{};
+	const auto every_boundary = [](const chip8& system) { return std::optional{system.get_cycle_count()}; };
+
+	if (!replay(chip, *frame, cycle + 1, false, every_boundary, boundary) or !boundary) {
+		(void)chip.restore(*present);
+		chip.pause();
+		return false;
+	}
+
+	return finish(chip, *frame, *boundary);
+}
+
+
+auto ReverseDebugger::step_back(chip8& chip) -> bool {
+	if (chip.get_cycle_count() == 0) {
+		return false;
+	}
+	return seek(chip, chip.get_cycle_count() - 1);
+}
+
+
+auto ReverseDebugger::run_back_to_breakpoint(chip8& chip) -> bool {
+	if (chip.get_breakpoints().empty()) {
+		std::cout << "There are no breakpoints to run back to\n";
+		return false;
+	}
+
+	const bool found = search(chip, [](uint64_t end) {
+		return [end](const chip8& system) -> std::optional<uint64_t> {
+			// The end is the start of the next frame searched, or the current position
+			if ((system.get_cycle_count() < end) and system.is_at_breakpoint()) {
+				return system.get_cycle_count();
+			}
+			return std::nullopt;
+		};
+	});
+
+	if (!found) {
+		std::cout << "No breakpoint was reached in the history\n";
+	}
+	return found;
+}
+
+
+auto ReverseDebugger::reverse_continue(chip8& chip, watch_location watch) -> bool {
+	const bool found = search(chip, [watch](uint64_t) {
+		// A change is attributed to the instruction between the previous visit and this one
+		return [watch, last = std::optional<uint16_t>{}, last_cycle = uint64_t{0}](const chip8& system) mutable -> std::optional<uint64_t> {
+			const uint16_t value = watch.read(system.get_state());
+			const auto match = (last and (*last != value)) ? std::optional{last_cycle} : std::nullopt;
+
+			last       = value;
+			last_cycle = system.get_cycle_count();
+			return match;
+		};
+	});
+
+	if (!found) {
+		std::cout << "No change to " << watch.to_string() << " was found in the history\n";
+	}
+	return found;
+}
+
+
+template<typename Visitor>
+auto ReverseDebugger::replay(chip8& chip, size_t frame, uint64_t end, bool include_end, Visitor&& visit, std::optional<uint64_t>& match) -> bool {
+	history.read_frame(frame, *frame_state);
+	if (!chip.restore(*frame_state)) {
+		return false;
+	}
+
+	const auto events = input.get_events();
+	size_t next = input.find(chip.get_cycle_count());
+
+	while (true) {
+		const uint64_t cycle = chip.get_cycle_count();
+		if ((cycle > end) or ((cycle == end) and !include_end)) {
+			return true;
+		}
+
+		for (; (next < events.size()) and (events[next].cycle == cycle); ++next) {
+			chip.set_key_state(events[next].key, events[next].pressed);
+		}
+
+		if (const auto found = visit(std::as_const(chip))) {
+			match = found;
+		}
+
+		if (cycle == end) {
+			return true;
+		}
+
+		// Execution only stopped here if it waited for input that wasn't recorded
+		if (chip.get_state().key_register != chip8_state::no_key_wait) {
+			return false;
+		}
+
+		chip.step();
+		if (chip.get_cycle_count() == cycle) {
+			return false;
+		}
+	}
+}
+
+
+template<typename VisitorFactory>
+auto ReverseDebugger::search(chip8& chip, VisitorFactory&& make_visitor) -> bool {
+	if (!can_reverse(chip)) {
+		return false;
+	}
+
+	chip.snapshot(*present);
+
+	const auto previous_frame = [this](uint64_t cycle) -> std::optional<size_t> {
+		return (cycle > 0) ? history.find_frame(cycle - 1) : std::nullopt;
+	};
+
+	// Search each frame, from the most recent one back, up to the start of the one after it
+	uint64_t end = chip.get_cycle_count();
+
+	for (auto frame = previous_frame(end); frame; frame = previous_frame(end)) {
+		auto match = std::optional<uint64_t>{};
+		if (!replay(chip, *frame, end, true, make_visitor(end), match)) {
+			break;
+		}
+		if (match) {
+			return finish(chip, *frame, *match);
+		}
+		end = history.get_frame_cycle(*frame);
+	}
+
+	(void)chip.restore(*present);
+	chip.pause();
+	return false;
+}
+
+
+auto ReverseDebugger::finish(chip8& chip, size_t frame, uint64_t cycle) -> bool {
+	auto match = std::optional<uint64_t>{};
+	const auto no_visit = [](const chip8&) { return std::optional<uint64_t>{}; };
+
+	if (!replay(chip, frame, cycle, false, no_visit, match) or (chip.get_cycle_count() != cycle)) {
+		std::cout << "Error re-executing to instruction " << cycle << ": The recorded input doesn't reach it\n";
+		(void)chip.restore(*present);
+		chip.pause();
+		return false;
+	}
+
+	// Execution continues live from here, so the frames and input after it didn't happen
+	history.truncate(frame);
+	input.discard_from(cycle);
+	chip.pause();
+	return true;
+}
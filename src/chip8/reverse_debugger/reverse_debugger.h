@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "chip8/chip8.h"
+#include "chip8/rewind/rewind_buffer.h"
+#include "input/input_log.h"
+
+
+/**
+ * @struct watch_location
+ * @brief  A register or byte of memory that ReverseDebugger::reverse_continue looks for changes to
+ */
+struct watch_location {
+    enum class kind : uint8_t {
+        v_register,     // A V register. The address is the number of the register.
+        index_register, // The I register
+        stack_pointer,  // The stack pointer, which changes when a subroutine is called or returns
+        memory,         // A byte of memory
+    };
+
+    kind     type    = kind::v_register;
+    uint16_t address = 0;
+
+    /// Read the watched value from a state
+    [[nodiscard]]
+    auto read(const chip8_state& state) const noexcept -> uint16_t;
+
+    /// Get a description of the location, e.g. "vA" or "memory 0x0300"
+    [[nodiscard]]
+    auto to_string() const -> std::string;
+};
+
+
+/**
+ * @class ReverseDebugger
+ *
+ * @brief Moves a chip8 backward through its execution, one instruction at a time or to a point of interest
+ *
+ * @details Nothing is recorded per instruction. To reach an earlier
+ *          instruction count, the most recent frame of the RewindBuffer at or
+ *          before it is restored, and the instructions after it are executed
+ *          again one at a time with chip8::step, applying the input recorded
+ *          in the InputLog at the instruction count it was first applied at.
+ *          With TimerMode::virtual_time the timers are a function of the
+ *          instruction count and the random numbers come from the state, so
+ *          the re-executed instructions reproduce the original ones exactly.
+ *          This holds for a history recorded with the JIT or AOT programs
+ *          too, since their blocks only advance the timers once they finish,
+ *          and an instruction that uses the timers always starts a block.
+ *          Real-time timers aren't reproducible, so the debugger refuses to
+ *          run with them.
+ *
+ *          Searching backward for a breakpoint or a change to a watched
+ *          location re-executes one frame of the history at a time, starting
+ *          from the most recent, and stops at the first frame that contains a
+ *          match. Each instruction is re-executed at most once, so going back
+ *          10 seconds of emulated time costs 10 seconds worth of single steps
+ *          and a rebuild per frame, which takes milliseconds.
+ *
+ *          Once the target is reached, the history after it and the input
+ *          recorded at or after it are discarded, and the system is paused.
+ *          Execution continues live from there, like after a rewind.
+ */
+class ReverseDebugger {
+public:
+
+    /**
+     * @param[in] history  The frames the system is captured into
+     * @param[in] input    The input that's applied to the system
+     */
+    ReverseDebugger(RewindBuffer& history, InputLog& input);
+
+    /**
+     * @brief Check if a system can be re-executed, and print the reason if it can't
+     *
+     * @return True if the system uses virtual timers and has a history, otherwise false.
+     */
+    [[nodiscard]]
+    auto can_reverse(const chip8& chip) const -> bool;
+
+    /**
+     * @brief Move a system to an earlier instruction count
+     *
+     * @details A draw that waits for the display counts the instructions it
+     *          waits for, so the result is the last instruction count at or
+     *          before the target that's between two instructions.
+     *
+     * @param[in] chip   The system that was captured into the history
+     * @param[in] cycle  The instruction count to move to. Must be before the current one.
+     *
+     * @return True if the instruction count was reached, otherwise false and the system is unchanged.
+     */
+    auto seek(chip8& chip, uint64_t cycle) -> bool;
+
+    /// Undo the most recent instruction (see seek)
+    auto step_back(chip8& chip) -> bool;
+
+    /**
+     * @brief Move a system back to the most recent point where its PC was at a breakpoint
+     *
+     * @return True if a breakpoint was found in the history, otherwise false and the system is unchanged.
+     */
+    auto run_back_to_breakpoint(chip8& chip) -> bool;
+
+    /**
+     * @brief Move a system back to just before the most recent instruction that changed a location
+     *
+     * @details Stepping forward from the result executes the instruction
+     *          that made the change.
+     *
+     * @param[in] chip   The system that was captured into the history
+     * @param[in] watch  The register or memory to look for changes to
+     *
+     * @return True if a change was found in the history, otherwise false and the system is unchanged.
+     */
+    auto reverse_continue(chip8& chip, watch_location watch) -> bool;
+
+private:
+
+    /**
+     * @brief Restore a frame and re-execute the instructions after it
+     *
+     * @details Before each instruction, the input stamped with the current
+     *          instruction count is applied, then the visitor is called. The
+     *          visitor returns the instruction count of a match, if there is
+     *          one, and the last match is kept. Stops at the end, or at the
+     *          first instruction count past it.
+     *
+     * @param[in]  chip         The system to re-execute on
+     * @param[in]  frame        The frame of the history to start at
+     * @param[in]  end          The instruction count to stop at
+     * @param[in]  include_end  Apply the input at the end and call the visitor on it
+     * @param[in]  visit        Called with the system at each instruction count
+     * @param[out] match        The last match returned by the visitor
+     *
+     * @return True if the end was reached, otherwise false if the execution stopped before it.
+     */
+    template<typename Visitor>
+    auto replay(chip8& chip, size_t frame, uint64_t end, bool include_end, Visitor&& visit, std::optional<uint64_t>& match) -> bool;
+
+    /**
+     * @brief Search backward through the history for the most recent match of a visitor
+     *
+     * @details The visitor factory is called with the instruction count at the
+     *          end of each frame that's searched, and returns a visitor for
+     *          replay. The search moves back one frame at a time until a frame
+     *          contains a match, then moves the system to the match.
+     */
+    template<typename VisitorFactory>
+    auto search(chip8& chip, VisitorFactory&& make_visitor) -> bool;
+
+    /// Re-execute from a frame to an instruction count, then discard the history after it and pause
+    auto finish(chip8& chip, size_t frame, uint64_t cycle) -> bool;
+
+
+    RewindBuffer& history;
+    InputLog& input;
+
+    // The state the frames of the history are rebuilt into
+    std::unique_ptr<chip8_state> frame_state;
+
+    // The state before an operation, which is restored if it fails
+    std::unique_ptr<chip8_state> present;
+};
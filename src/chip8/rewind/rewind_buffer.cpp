@@ -0,0 +1,377 @@
+#include "rewind_buffer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+
+// The number of bytes a segment uses per frame, outside of the frame records
+static constexpr size_t frame_overhead = sizeof(uint32_t) + sizeof(uint64_t);
+
+
+// Get the number of bytes used by a segment
+[[nodiscard]]
+static auto segment_usage(const std::vector<uint8_t>& data, size_t frames) noexcept -> size_t {
+	return data.size() + (frames * frame_overhead);
+}
+
+
+RewindBuffer::RewindBuffer(size_t memory_budget, size_t keyframe_interval) :
+	memory_budget(memory_budget),
+	keyframe_interval(std::max<size_t>(keyframe_interval, 1)),
+	scratch(std::make_unique<chip8_state>()) {
+
+	// Locate the display rows within the state. The row generations follow the pixels.
+	const auto* const base = reinterpret_cast<const uint8_t*>(scratch.get());
+	const auto& display    = scratch->display;
+
+	pixels_offset          = static_cast<size_t>(reinterpret_cast<const uint8_t*>(display.get_rows().data()) - base);
+	row_generations_offset = static_cast<size_t>(reinterpret_cast<const uint8_t*>(display.get_row_generations().data()) - base);
+	row_bytes              = chip8_state::display_t::row_words * sizeof(uint64_t);
+
+	const size_t pixels_end          = pixels_offset + display.get_rows().size_bytes();
+	const size_t row_generations_end = row_generations_offset + display.get_row_generations().size_bytes();
+
+	core_ranges = {{
+		{0, pixels_offset},
+		{pixels_end, row_generations_offset},
+		{row_generations_end, offsetof(chip8_state, memory)},
+	}};
+}
+
+
+auto RewindBuffer::capture(chip8& chip) -> void {
+	// The history of another ROM can't be restored
+	if (chip.get_rom_digest() != rom_digest) {
+		clear();
+		rom_digest = chip.get_rom_digest();
+	}
+
+	const auto& state = chip.get_state();
+
+	// The system was reset, or restored to a point before the history
+	if (!segments.empty() and (state.cycle_count < segments.back().frame_cycles.back())) {
+		clear();
+	}
+
+	// The deltas only apply to the frame captured before them
+	const bool keyframe = segments.empty()
+	                      or (segments.back().frame_offsets.size() >= keyframe_interval)
+	                      or (state.address_mask != previous_address_mask)
+	                      or (chip.get_restore_count() != expected_restore_count);
+
+	if (keyframe) {
+		write_keyframe(state);
+	}
+	else {
+		write_delta(chip);
+	}
+
+	set_previous(chip);
+	enforce_budget();
+}
+
+
+auto RewindBuffer::rewind(chip8& chip, size_t frames) -> size_t {
+	if (frame_count == 0) {
+		return 0;
+	}
+	if (chip.get_rom_digest() != rom_digest) {
+		clear();
+		return 0;
+	}
+
+	frames = std::min(frames, frame_count - 1);
+	const size_t target = frame_count - 1 - frames;
+
+	truncate(target);
+	read_frame(target, *scratch);
+
+	if (!chip.restore(*scratch)) {
+		clear();
+		return 0;
+	}
+
+	set_previous(chip);
+	return frames;
+}
+
+
+auto RewindBuffer::clear() noexcept -> void {
+	segments.clear();
+	frame_count  = 0;
+	memory_usage = 0;
+}
+
+
+auto RewindBuffer::find_frame(uint64_t cycle) const noexcept -> std::optional<size_t> {
+	// The instruction counts only increase through the history
+	size_t first = frame_count;
+
+	for (auto seg = segments.rbegin(); seg != segments.rend(); ++seg) {
+		first -= seg->frame_cycles.size();
+
+		if (seg->frame_cycles.front() <= cycle) {
+			const auto it = std::ranges::upper_bound(seg->frame_cycles, cycle);
+			return first + static_cast<size_t>(it - seg->frame_cycles.begin()) - 1;
+		}
+	}
+
+	return std::nullopt;
+}
+
+
+auto RewindBuffer::get_frame_cycle(size_t frame) const noexcept -> uint64_t {
+	const auto [seg, idx] = locate(frame);
+	return segments[seg].frame_cycles[idx];
+}
+
+
+auto RewindBuffer::read_frame(size_t frame, chip8_state& out) const noexcept -> void {
+	const auto [seg, idx] = locate(frame);
+	rebuild(segments[seg], idx, out);
+}
+
+
+auto RewindBuffer::truncate(size_t frame) noexcept -> void {
+	// Discard the segments after the one that holds the frame
+	while ((frame_count - segments.back().frame_offsets.size()) > frame) {
+		pop_segment();
+	}
+
+	// Discard the frames after it
+	auto& seg = segments.back();
+	const size_t idx = frame - (frame_count - seg.frame_offsets.size());
+	const size_t end = ((idx + 1) < seg.frame_offsets.size()) ? seg.frame_offsets[idx + 1] : seg.data.size();
+
+	memory_usage -= segment_usage(seg.data, seg.frame_offsets.size());
+	frame_count  -= seg.frame_offsets.size() - (idx + 1);
+	seg.data.resize(end);
+	seg.frame_offsets.resize(idx + 1);
+	seg.frame_cycles.resize(idx + 1);
+	memory_usage += segment_usage(seg.data, seg.frame_offsets.size());
+}
+
+
+auto RewindBuffer::write_keyframe(const chip8_state& state) -> void {
+	auto seg = std::move(spare);
+	spare = segment{};
+
+	seg.data.clear();
+	seg.frame_offsets.clear();
+	seg.frame_cycles.clear();
+
+	const size_t size = state.size();
+	seg.data.resize(size);
+	std::memcpy(seg.data.data(), &state, size);
+	seg.frame_offsets.push_back(0);
+	seg.frame_cycles.push_back(state.cycle_count);
+
+	memory_usage += segment_usage(seg.data, seg.frame_offsets.size());
+	++frame_count;
+	segments.push_back(std::move(seg));
+}
+
+
+auto RewindBuffer::write_delta(const chip8& chip) -> void {
+	const auto& state = chip.get_state();
+	const auto* const base = reinterpret_cast<const uint8_t*>(&state);
+
+	// The small members that changed since the previous frame
+	core_words core;
+	gather_core(state, core);
+
+	uint64_t core_mask = 0;
+	for (size_t word = 0; word < core_word_count; ++word) {
+		if (core[word] != previous_core[word]) {
+			core_mask |= uint64_t{1} << word;
+		}
+	}
+
+	// The rows of the display that changed since the previous frame
+	std::array<uint8_t, chip8_state::display_t::max_size_y()> rows;
+	uint16_t row_count = 0;
+
+	const auto generations = state.display.get_row_generations();
+	for (size_t y = 0; y < generations.size(); ++y) {
+		if (generations[y] > previous_generation) {
+			rows[row_count++] = static_cast<uint8_t>(y);
+		}
+	}
+
+	// The blocks of memory that were written since the previous frame
+	const auto dirty = chip.get_dirty_blocks();
+	const size_t dirty_words = ((state.address_mask + size_t{1}) / chip8::memory_block_size + 63) / 64;
+
+	uint16_t block_count = 0;
+	for (size_t word = 0; word < dirty_words; ++word) {
+		block_count += static_cast<uint16_t>(std::popcount(dirty[word]));
+	}
+
+	// Record: the core mask and counts, then the changed core words, rows, and blocks
+	const size_t size = sizeof(core_mask) + sizeof(row_count) + sizeof(block_count)
+	                    + (static_cast<size_t>(std::popcount(core_mask)) * sizeof(uint64_t))
+	                    + (row_count * (sizeof(uint8_t) + row_bytes + sizeof(uint64_t)))
+	                    + (block_count * (sizeof(uint16_t) + chip8::memory_block_size));
+
+	auto& seg = segments.back();
+	const size_t start = seg.data.size();
+	seg.data.resize(start + size);
+
+	uint8_t* out = seg.data.data() + start;
+	const auto put = [&out](const void* data, size_t count) noexcept {
+		std::memcpy(out, data, count);
+		out += count;
+	};
+
+	put(&core_mask, sizeof(core_mask));
+	put(&row_count, sizeof(row_count));
+	put(&block_count, sizeof(block_count));
+
+	for (uint64_t mask = core_mask; mask != 0; mask &= mask - 1) {
+		put(&core[std::countr_zero(mask)], sizeof(uint64_t));
+	}
+
+	for (size_t idx = 0; idx < row_count; ++idx) {
+		const size_t y = rows[idx];
+		put(&rows[idx], sizeof(uint8_t));
+		put(base + pixels_offset + (y * row_bytes), row_bytes);
+		put(base + row_generations_offset + (y * sizeof(uint64_t)), sizeof(uint64_t));
+	}
+
+	for (size_t word = 0; word < dirty_words; ++word) {
+		for (uint64_t mask = dirty[word]; mask != 0; mask &= mask - 1) {
+			const auto block = static_cast<uint16_t>((word * 64) + std::countr_zero(mask));
+			put(&block, sizeof(block));
+			put(state.memory.data() + (block * chip8::memory_block_size), chip8::memory_block_size);
+		}
+	}
+
+	seg.frame_offsets.push_back(static_cast<uint32_t>(start));
+	seg.frame_cycles.push_back(state.cycle_count);
+	memory_usage += size + frame_overhead;
+	++frame_count;
+}
+
+
+auto RewindBuffer::gather_core(const chip8_state& state, core_words& out) const noexcept -> void {
+	const auto* const base = reinterpret_cast<const uint8_t*>(&state);
+	auto* const words = reinterpret_cast<uint8_t*>(out.data());
+
+	// The bytes past the end of the last range are always zero
+	out[core_word_count - 1] = 0;
+
+	size_t pos = 0;
+	for (const auto& [begin, end] : core_ranges) {
+		std::memcpy(words + pos, base + begin, end - begin);
+		pos += end - begin;
+	}
+}
+
+
+auto RewindBuffer::scatter_core(const core_words& words, chip8_state& out) const noexcept -> void {
+	auto* const base = reinterpret_cast<uint8_t*>(&out);
+	const auto* const bytes = reinterpret_cast<const uint8_t*>(words.data());
+
+	size_t pos = 0;
+	for (const auto& [begin, end] : core_ranges) {
+		std::memcpy(base + begin, bytes + pos, end - begin);
+		pos += end - begin;
+	}
+}
+
+
+auto RewindBuffer::locate(size_t frame) const noexcept -> std::pair<size_t, size_t> {
+	// Recent frames are the most likely to be requested, so the segments are searched from the back
+	size_t first = frame_count;
+	size_t seg   = segments.size();
+
+	do {
+		--seg;
+		first -= segments[seg].frame_offsets.size();
+	} while (first > frame);
+
+	return {seg, frame - first};
+}
+
+
+auto RewindBuffer::rebuild(const segment& seg, size_t frame, chip8_state& out) const noexcept -> void {
+	auto* const base = reinterpret_cast<uint8_t*>(&out);
+
+	const size_t keyframe_size = (seg.frame_offsets.size() > 1) ? seg.frame_offsets[1] : seg.data.size();
+	std::memcpy(base, seg.data.data(), keyframe_size);
+
+	if (frame == 0) {
+		return;
+	}
+
+	// The core words are applied to a copy, which is written back after the last delta
+	core_words core;
+	gather_core(out, core);
+
+	for (size_t idx = 1; idx <= frame; ++idx) {
+		const uint8_t* in = seg.data.data() + seg.frame_offsets[idx];
+		const auto get = [&in](void* data, size_t count) noexcept {
+			std::memcpy(data, in, count);
+			in += count;
+		};
+
+		uint64_t core_mask   = 0;
+		uint16_t row_count   = 0;
+		uint16_t block_count = 0;
+		get(&core_mask, sizeof(core_mask));
+		get(&row_count, sizeof(row_count));
+		get(&block_count, sizeof(block_count));
+
+		for (uint64_t mask = core_mask; mask != 0; mask &= mask - 1) {
+			get(&core[std::countr_zero(mask)], sizeof(uint64_t));
+		}
+
+		for (uint16_t row = 0; row < row_count; ++row) {
+			uint8_t y = 0;
+			get(&y, sizeof(y));
+			get(base + pixels_offset + (y * row_bytes), row_bytes);
+			get(base + row_generations_offset + (y * sizeof(uint64_t)), sizeof(uint64_t));
+		}
+
+		for (uint16_t count = 0; count < block_count; ++count) {
+			uint16_t block = 0;
+			get(&block, sizeof(block));
+			get(out.memory.data() + (block * chip8::memory_block_size), chip8::memory_block_size);
+		}
+	}
+
+	scatter_core(core, out);
+}
+
+
+auto RewindBuffer::pop_segment() noexcept -> void {
+	auto& last = segments.back();
+	frame_count  -= last.frame_offsets.size();
+	memory_usage -= segment_usage(last.data, last.frame_offsets.size());
+	spare = std::move(last);
+	segments.pop_back();
+}
+
+
+auto RewindBuffer::set_previous(chip8& chip) -> void {
+	const auto& state = chip.get_state();
+
+	gather_core(state, previous_core);
+	previous_generation    = state.display.get_generation();
+	previous_address_mask  = state.address_mask;
+	expected_restore_count = chip.get_restore_count();
+
+	chip.clear_dirty_blocks();
+}
+
+
+auto RewindBuffer::enforce_budget() -> void {
+	while ((memory_usage > memory_budget) and (segments.size() > 1)) {
+		auto& first = segments.front();
+		frame_count  -= first.frame_offsets.size();
+		memory_usage -= segment_usage(first.data, first.frame_offsets.size());
+		spare = std::move(first);
+		segments.pop_front();
+	}
+}
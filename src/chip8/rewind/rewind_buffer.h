@@ -0,0 +1,221 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "chip8/chip8.h"
+#include "util/sha1/sha1.h"
+
+
+/**
+ * @class RewindBuffer
+ *
+ * @brief A bounded history of the states of a chip8, captured once per frame, that the chip8 can be rewound through
+ *
+ * @details The history is a sequence of segments. Each segment starts with a
+ *          keyframe, which is a copy of the state in use, followed by one
+ *          delta per frame. A delta holds the 8-byte words of the registers,
+ *          timers, and other small members that changed since the previous
+ *          frame, the rows of the display that changed (found through the
+ *          row generations of the display), and the 64-byte blocks of memory
+ *          that were written (see chip8::get_dirty_blocks). Nothing is
+ *          compared or copied in bulk, so a capture takes a few hundred
+ *          nanoseconds, and a typical frame takes a few hundred bytes. An hour
+ *          of history at 60 frames per second fits in tens of MB.
+ *
+ *          When the history grows past its memory budget, the oldest segment
+ *          is discarded. A new segment is started every keyframe interval
+ *          frames, and whenever the deltas wouldn't apply to the previous
+ *          frame: after the state was restored by something other than the
+ *          buffer, or after the platform changed. Loading a different ROM, or
+ *          a reset or restore that moves the instruction count backward,
+ *          discards the history.
+ *
+ *          Rewinding rebuilds a frame by copying its keyframe and applying the
+ *          deltas that follow it, then restores the chip8 to it. The frames
+ *          after it are discarded, so the next capture continues the history
+ *          from the restored frame. The frames can also be read without
+ *          modifying the history, which the ReverseDebugger uses to find
+ *          where to start re-executing from.
+ */
+class RewindBuffer {
+public:
+
+    // The default limit on the memory used by the history
+    static constexpr size_t default_memory_budget = size_t{64} * 1024 * 1024;
+
+    // The default number of frames in each segment (5 seconds)
+    static constexpr size_t default_keyframe_interval = 300;
+
+    /**
+     * @param[in] memory_budget      The number of bytes the history may use before its oldest frames are discarded
+     * @param[in] keyframe_interval  The number of frames in each segment. Rebuilding a frame applies up to this many deltas.
+     */
+    explicit RewindBuffer(size_t memory_budget = default_memory_budget, size_t keyframe_interval = default_keyframe_interval);
+
+    /**
+     * @brief Append the current state of a system to the history
+     *
+     * @details Call once per emulated frame. The dirty blocks of the system
+     *          are cleared.
+     *
+     * @param[in] chip  The system to capture
+     */
+    auto capture(chip8& chip) -> void;
+
+    /**
+     * @brief Restore a system to a frame in the history
+     *
+     * @details The frames after the restored one are discarded. The history
+     *          can't be rewound past its oldest frame.
+     *
+     * @param[in] chip    The system that was captured
+     * @param[in] frames  The number of frames before the most recent one to restore
+     *
+     * @return The number of frames that were rewound
+     */
+    auto rewind(chip8& chip, size_t frames) -> size_t;
+
+    /// Discard the history
+    auto clear() noexcept -> void;
+
+    /**
+     * @brief Find the most recent frame that was captured at or before an instruction count
+     *
+     * @param[in] cycle  The instruction count
+     *
+     * @return The index of the frame, where 0 is the oldest frame, or nullopt
+     *         if every frame was captured after the instruction count.
+     */
+    [[nodiscard]]
+    auto find_frame(uint64_t cycle) const noexcept -> std::optional<size_t>;
+
+    /// Get the instruction count of a frame. The index must be less than get_frame_count().
+    [[nodiscard]]
+    auto get_frame_cycle(size_t frame) const noexcept -> uint64_t;
+
+    /**
+     * @brief Rebuild the state of a frame without modifying the history
+     *
+     * @param[in]  frame  The index of the frame. Must be less than get_frame_count().
+     * @param[out] out    The state of the frame
+     */
+    auto read_frame(size_t frame, chip8_state& out) const noexcept -> void;
+
+    /**
+     * @brief Discard the frames after a frame
+     *
+     * @details The next capture starts a new segment if the state was
+     *          restored since the last capture.
+     *
+     * @param[in] frame  The index of the last frame to keep. Must be less than get_frame_count().
+     */
+    auto truncate(size_t frame) noexcept -> void;
+
+    /// Get the number of frames in the history
+    [[nodiscard]]
+    auto get_frame_count() const noexcept -> size_t {
+        return frame_count;
+    }
+
+    /// Get the number of bytes used by the history
+    [[nodiscard]]
+    auto get_memory_usage() const noexcept -> size_t {
+        return memory_usage;
+    }
+
+private:
+
+    // A keyframe and the deltas of the frames after it
+    struct segment {
+        // The records of the frames, one after another
+        std::vector<uint8_t> data;
+
+        // The offset of the record of each frame in data. The first is the keyframe.
+        std::vector<uint32_t> frame_offsets;
+
+        // The instruction count of each frame
+        std::vector<uint64_t> frame_cycles;
+    };
+
+    // The number of 8-byte words the small members of the state can be split into. A delta marks the words that changed in a 64-bit mask.
+    static constexpr size_t max_core_words = 64;
+
+    // The size of the members of the state outside of the display rows and the memory (see core_ranges)
+    static constexpr size_t core_size = offsetof(chip8_state, memory)
+                                        - (decltype(std::declval<const chip8_state::display_t&>().get_rows())::extent * sizeof(uint64_t))
+                                        - (decltype(std::declval<const chip8_state::display_t&>().get_row_generations())::extent * sizeof(uint64_t));
+
+    // The number of 8-byte words the small members of the state are split into
+    static constexpr size_t core_word_count = (core_size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    static_assert(core_word_count <= max_core_words, "The small members of chip8_state don't fit in the core words of a delta");
+
+    using core_words = std::array<uint64_t, max_core_words>;
+
+    /// Start a new segment with a keyframe of the state
+    auto write_keyframe(const chip8_state& state) -> void;
+
+    /// Append the delta of the state from the previous frame to the last segment
+    auto write_delta(const chip8& chip) -> void;
+
+    /// Copy the members of a state outside of the display rows and the memory into words
+    auto gather_core(const chip8_state& state, core_words& out) const noexcept -> void;
+
+    /// Copy words produced by gather_core back into a state
+    auto scatter_core(const core_words& words, chip8_state& out) const noexcept -> void;
+
+    /// Get the segment that holds a frame, and the index of the frame within it
+    [[nodiscard]]
+    auto locate(size_t frame) const noexcept -> std::pair<size_t, size_t>;
+
+    /// Rebuild a frame of a segment
+    auto rebuild(const segment& seg, size_t frame, chip8_state& out) const noexcept -> void;
+
+    /// Discard the last segment, and keep its buffers for reuse
+    auto pop_segment() noexcept -> void;
+
+    /// Record the state that the next delta is relative to
+    auto set_previous(chip8& chip) -> void;
+
+    /// Discard the oldest segments until the history fits in the memory budget
+    auto enforce_budget() -> void;
+
+
+    size_t memory_budget;
+    size_t keyframe_interval;
+
+    std::deque<segment> segments;
+    size_t frame_count  = 0;
+    size_t memory_usage = 0;
+
+    // A discarded segment whose buffers are reused by the next keyframe
+    segment spare;
+
+    // The byte ranges of chip8_state that the core words are gathered from:
+    // everything before the memory, except the pixels and the row generations of the display
+    std::array<std::pair<size_t, size_t>, 3> core_ranges = {};
+
+    // The offsets of the display pixels and row generations in chip8_state, and the size of a row of pixels
+    size_t pixels_offset = 0;
+    size_t row_generations_offset = 0;
+    size_t row_bytes = 0;
+
+    // The previous frame: its core words, display generation, and memory size
+    core_words previous_core = {};
+    uint64_t previous_generation = 0;
+    uint16_t previous_address_mask = 0;
+
+    // The restore count of the system after the previous capture or rewind, and its ROM
+    uint64_t expected_restore_count = 0;
+    sha1_digest rom_digest = {};
+
+    // The state that frames are rebuilt into
+    std::unique_ptr<chip8_state> scratch;
+};
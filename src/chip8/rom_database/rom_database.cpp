@@ -0,0 +1,111 @@
+#include "rom_database.h"
+
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+
+// Split the next whitespace separated field off the front of a line
+[[nodiscard]]
+static auto next_field(std::string_view& line) noexcept -> std::string_view {
+	const auto start = line.find_first_not_of(" \t");
+	if (start == std::string_view::npos) {
+		line = {};
+		return {};
+	}
+
+	const auto end = line.find_first_of(" \t", start);
+	const auto field = line.substr(start, end - start);
+	line = (end == std::string_view::npos) ? std::string_view{} : line.substr(end);
+	return field;
+}
+
+
+// Parse a setting that may be "-" to leave it unchanged. Returns false if the field is invalid.
+template<typename T, typename ParseFunc>
+[[nodiscard]]
+static auto parse_setting(std::string_view field, std::optional<T>& out, ParseFunc&& parse) -> bool {
+	if (field == "-") {
+		out.reset();
+		return true;
+	}
+	out = parse(field);
+	return out.has_value();
+}
+
+
+auto RomDatabase::load(const std::filesystem::path& file) -> bool {
+	std::ifstream in(file);
+	if (!in) {
+		std::cout << "Error opening the ROM database " << file << '\n';
+		return false;
+	}
+
+	const auto parse_ipf = [](std::string_view str) -> std::optional<uint32_t> {
+		uint32_t value = 0;
+		const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+		if ((ec != std::errc{}) or (ptr != str.data() + str.size()) or (value == 0)) {
+			return {};
+		}
+		return value;
+	};
+
+	std::string buffer;
+	size_t line_number = 0;
+
+	while (std::getline(in, buffer)) {
+		++line_number;
+
+		auto line = std::string_view{buffer};
+		if (!line.empty() and line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+
+		const auto hash = next_field(line);
+		if (hash.empty() or hash.starts_with('#')) {
+			continue;
+		}
+
+		const auto digest = to_sha1_digest(hash);
+		auto info = rom_info{};
+
+		const bool valid = digest.has_value()
+		    and parse_setting(next_field(line), info.platform, to_platform)
+		    and parse_setting(next_field(line), info.quirks, to_quirk_profile)
+		    and parse_setting(next_field(line), info.instructions_per_frame, parse_ipf);
+
+		if (!valid) {
+			std::cout << "Skipping malformed entry on line " << line_number << " of the ROM database " << file << '\n';
+			continue;
+		}
+
+		// The title is the rest of the line
+		if (const auto start = line.find_first_not_of(" \t"); start != std::string_view::npos) {
+			info.title = line.substr(start);
+		}
+
+		insert(*digest, std::move(info));
+	}
+
+	return true;
+}
+
+
+auto RomDatabase::insert(const sha1_digest& digest, rom_info info) -> void {
+	entries.insert_or_assign(digest, std::move(info));
+}
+
+
+auto RomDatabase::find(std::span<const uint8_t> rom) const noexcept -> const rom_info* {
+	if (entries.empty()) {
+		return nullptr;
+	}
+	return find(sha1(rom));
+}
+
+
+auto RomDatabase::find(const sha1_digest& digest) const noexcept -> const rom_info* {
+	const auto it = entries.find(digest);
+	return (it != entries.end()) ? &it->second : nullptr;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+#include "chip8/chip8.h"
+#include "chip8/isa/quirks.h"
+#include "util/sha1/sha1.h"
+
+
+/**
+ * @struct rom_info
+ * @brief  The settings a ROM was written for, as recorded in a @ref RomDatabase
+ */
+struct rom_info {
+    // The name of the program
+    std::string title;
+
+    // The CHIP-8 variant the ROM runs on. Unchanged if not set.
+    std::optional<Platform> platform;
+
+    // The interpreter whose quirks the ROM expects. Unchanged if not set.
+    std::optional<QuirkProfile> quirks;
+
+    // The recommended number of instructions per 60Hz frame. Unchanged if not set.
+    std::optional<uint32_t> instructions_per_frame;
+};
+
+
+/**
+ * @class RomDatabase
+ *
+ * @brief Maps ROMs, identified by the SHA-1 hash of their contents, to the settings they need
+ *
+ * @details The database is loaded from a text file with one ROM per line:
+ *
+ *              <sha1> <platform> <quirks> <instructions per frame> <title>
+ *
+ *          The platform is CHIP-8, SUPER-CHIP, or XO-CHIP, and the quirk
+ *          profile is vip, schip, or xo-chip. Any of the settings may be "-"
+ *          to leave it unchanged. The title is the rest of the line. Blank
+ *          lines and lines starting with '#' are ignored.
+ *
+ *          A chip8 with a database applies the entry of each ROM it loads (see
+ *          chip8::set_rom_database). Batch tools can query the database
+ *          directly. Entries are stored in a hash table, so a lookup takes
+ *          constant time after the ROM is hashed.
+ */
+class RomDatabase {
+public:
+
+    /**
+     * @brief Add the entries in a database file
+     *
+     * @details Entries for a hash that is already in the database replace it.
+     *          Malformed lines are reported and skipped.
+     *
+     * @param[in] file  The path to the database file
+     *
+     * @return True if the file was read, otherwise false.
+     */
+    [[nodiscard]]
+    auto load(const std::filesystem::path& file) -> bool;
+
+    /// Add or replace the entry of a ROM
+    auto insert(const sha1_digest& digest, rom_info info) -> void;
+
+    /**
+     * @brief Find the entry of a ROM
+     *
+     * @param[in] rom  The contents of the ROM
+     *
+     * @return The entry, or nullptr if the ROM isn't in the database.
+     *         The entry is valid until the database is modified.
+     */
+    [[nodiscard]]
+    auto find(std::span<const uint8_t> rom) const noexcept -> const rom_info*;
+
+    /// Find the entry of a ROM by its hash. Returns nullptr if the ROM isn't in the database.
+    [[nodiscard]]
+    auto find(const sha1_digest& digest) const noexcept -> const rom_info*;
+
+    /// Get the number of ROMs in the database
+    [[nodiscard]]
+    auto size() const noexcept -> size_t {
+        return entries.size();
+    }
+
+private:
+
+    // The digest is already uniformly distributed, so its first bytes are used as the hash
+    struct digest_hash {
+        [[nodiscard]]
+        auto operator()(const sha1_digest& digest) const noexcept -> size_t {
+            size_t hash = 0;
+            std::memcpy(&hash, digest.data(), sizeof(hash));
+            return hash;
+        }
+    };
+
+    std::unordered_map<sha1_digest, rom_info, digest_hash> entries;
+};
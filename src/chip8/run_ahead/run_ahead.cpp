@@ -0,0 +1,104 @@
+#include "run_ahead.h"
+
+#include <utility>
+
+
+RunAhead::RunAhead() : saved(std::make_unique<chip8_state>()) {
+}
+
+
+auto RunAhead::set_mode(RunAheadMode new_mode) -> void {
+	mode = new_mode;
+	secondary.reset();
+	presented = nullptr;
+}
+
+
+auto RunAhead::run(chip8& chip) -> void {
+	presented = nullptr;
+	sync_time = {};
+
+	if ((mode == RunAheadMode::off) or (frames == 0) or chip.is_paused() or (chip.get_timer_mode() != TimerMode::virtual_time)) {
+		return;
+	}
+
+	if (mode == RunAheadMode::single_instance) {
+		run_single_instance(chip);
+	}
+	else {
+		run_second_instance(chip);
+	}
+}
+
+
+auto RunAhead::run_single_instance(chip8& chip) -> void {
+	const auto start = std::chrono::steady_clock::now();
+
+	chip.snapshot(*saved);
+	const uint64_t restore_count = chip.restore_count;
+
+	// The counters aren't part of the state, so they're saved with it to not count the frames ahead twice
+	const fusion_report fusion = chip.fusion;
+	const uint64_t idle_instructions = chip.idle_instructions;
+
+	// The frames ahead are thrown away, so the flags they store mustn't be written over the saved ones
+	auto flags_directory = std::exchange(chip.flags_directory, std::filesystem::path{});
+
+	const auto ran = std::chrono::steady_clock::now();
+	run_frames(chip);
+	display = chip.state.display;
+	const auto restoring = std::chrono::steady_clock::now();
+
+	(void)chip.restore(*saved);
+	chip.flags_directory = std::move(flags_directory);
+
+	// The system is back in the state that was last observed, so nothing needs to treat it as a restore.
+	// It wasn't paused before running ahead, so a pause while running ahead is undone too.
+	chip.restore_count = restore_count;
+	chip.fusion = fusion;
+	chip.idle_instructions = idle_instructions;
+	chip.resume();
+
+	sync_time = (ran - start) + (std::chrono::steady_clock::now() - restoring);
+	presented = &display;
+}
+
+
+auto RunAhead::run_second_instance(const chip8& chip) -> void {
+	const auto start = std::chrono::steady_clock::now();
+
+	if (!secondary or is_copy_outdated(chip) or !secondary->restore(chip.state)) {
+		secondary = std::make_unique<chip8>(chip.fork());
+	}
+	secondary->resume();
+
+	sync_time = std::chrono::steady_clock::now() - start;
+
+	run_frames(*secondary);
+	presented = &secondary->get_display();
+}
+
+
+auto RunAhead::run_frames(chip8& target) const -> void {
+	const uint64_t instructions = ((uint64_t{frames} * target.get_timer_clock_rate()) + 59) / 60;
+	const uint64_t end = target.get_cycle_count() + instructions;
+
+	while (!target.is_paused() and (target.get_cycle_count() < end)) {
+		target.run_cycle();
+	}
+}
+
+
+auto RunAhead::is_copy_outdated(const chip8& chip) const noexcept -> bool {
+	return (secondary->rom_digest != chip.rom_digest)
+	       or (secondary->rom_end != chip.rom_end)
+	       or (secondary->platform != chip.platform)
+	       or (secondary->quirk_profile != chip.quirk_profile)
+	       or (secondary->clock_mode != chip.clock_mode)
+	       or (secondary->clock_rate != chip.clock_rate)
+	       or (secondary->instructions_per_frame != chip.instructions_per_frame)
+	       or (secondary->is_jit_enabled() != chip.is_jit_enabled())
+	       or (secondary->aot_enabled != chip.aot_enabled)
+	       or (secondary->fusion_enabled != chip.fusion_enabled)
+	       or (secondary->idle_skip_enabled != chip.idle_skip_enabled);
+}
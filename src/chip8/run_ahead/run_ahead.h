@@ -0,0 +1,144 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "chip8/chip8.h"
+
+
+/// How RunAhead executes the frames ahead of a system
+enum class RunAheadMode : uint8_t {
+    off,              // The display of the system is presented as is
+    single_instance,  // The system runs ahead, then is restored to a snapshot
+    second_instance,  // A copy of the system is synchronized with it every frame and runs ahead instead
+};
+
+constexpr auto to_string(RunAheadMode mode) noexcept -> std::string_view {
+    switch (mode) {
+        case RunAheadMode::off:             return "Off";
+        case RunAheadMode::single_instance: return "Single Instance";
+        case RunAheadMode::second_instance: return "Second Instance";
+        default:                            return "unknown";
+    }
+}
+
+
+/**
+ * @class RunAhead
+ *
+ * @brief Presents the display of a chip8 a few frames in the future, to hide the frames a ROM takes to react to input
+ *
+ * @details Many ROMs read the keys a frame or more before they draw the
+ *          result, so a key press only shows up on screen a few frames after
+ *          it was made. Each host frame, RunAhead executes a number of
+ *          frames past the system with the input that's currently held, and
+ *          keeps the display of the last one to present instead of the
+ *          current display. The system itself is left as it was, so the
+ *          frames ahead are executed again with the actual input later.
+ *
+ *          In RunAheadMode::single_instance, the state is snapshotted, the
+ *          system runs ahead, and the snapshot is restored. Restoring only
+ *          discards the code of the memory blocks that changed, so a
+ *          snapshot and restore take well under a microsecond for CHIP-8
+ *          and a few microseconds for the 64 KB memory of XO-CHIP. The
+ *          system is back in the state that was last seen by anything that
+ *          observes it, so this isn't counted as a restore (see
+ *          chip8::get_restore_count), and the RewindBuffer keeps recording
+ *          deltas. The RPL user flags aren't persisted while running ahead,
+ *          and the fusion and idle instruction counters are restored too.
+ *
+ *          In RunAheadMode::second_instance, the system is never restored.
+ *          A copy made with chip8::fork is synchronized with its state every
+ *          frame and runs ahead instead, so its breakpoints and the files it
+ *          writes are never touched. The copy keeps its own decoded and
+ *          compiled code, and is made again when the ROM or a setting of the
+ *          system changes.
+ *
+ *          The frames ahead are only reproducible with virtual timers, so
+ *          nothing is run with real-time timers.
+ */
+class RunAhead {
+public:
+
+    RunAhead();
+
+    [[nodiscard]]
+    auto get_mode() const noexcept -> RunAheadMode {
+        return mode;
+    }
+
+    /// Select how the frames ahead are executed. Discards the copy of the system made for RunAheadMode::second_instance.
+    auto set_mode(RunAheadMode new_mode) -> void;
+
+    /// Get the number of 60Hz frames that are run ahead
+    [[nodiscard]]
+    auto get_frames() const noexcept -> uint32_t {
+        return frames;
+    }
+    auto set_frames(uint32_t count) noexcept -> void {
+        frames = count;
+    }
+
+    /**
+     * @brief Run frames ahead of a system with its current input, and keep the display of the last one
+     *
+     * @details Nothing is run while run-ahead is off, the system is paused,
+     *          or it uses real-time timers. The system is left in the same
+     *          state either way.
+     *
+     * @param[in] chip  The system to run ahead of
+     */
+    auto run(chip8& chip) -> void;
+
+    /// Present the display of the system again, until the next run
+    auto discard() noexcept -> void {
+        presented = nullptr;
+    }
+
+    /// Get the display of the last frame run ahead, or null if nothing was run ahead since the last discard
+    [[nodiscard]]
+    auto get_display() const noexcept -> const chip8::display_t* {
+        return presented;
+    }
+
+    /// Get the host time the last run spent saving and restoring states, not counting the frames it executed
+    [[nodiscard]]
+    auto get_sync_time() const noexcept -> std::chrono::duration<double> {
+        return sync_time;
+    }
+
+private:
+
+    /// Snapshot the system, run ahead, and restore it
+    auto run_single_instance(chip8& chip) -> void;
+
+    /// Synchronize the copy of the system with it, and run the copy ahead
+    auto run_second_instance(const chip8& chip) -> void;
+
+    /// Execute the frames ahead on a system, stopping early if it pauses
+    auto run_frames(chip8& target) const -> void;
+
+    /// Check if the copy of the system was made with a different ROM or settings than the system has now
+    [[nodiscard]]
+    auto is_copy_outdated(const chip8& chip) const noexcept -> bool;
+
+
+    RunAheadMode mode = RunAheadMode::off;
+    uint32_t frames = 1;
+
+    // The state of the system before a single instance runs ahead
+    std::unique_ptr<chip8_state> saved;
+
+    // The copy of the system that the second instance runs ahead on
+    std::unique_ptr<chip8> secondary;
+
+    // The display of the last frame a single instance ran ahead
+    chip8::display_t display;
+
+    // The display to present instead of the display of the system. Null if there isn't one.
+    const chip8::display_t* presented = nullptr;
+
+    std::chrono::duration<double> sync_time{0};
+};
@@ -0,0 +1,242 @@
+#include "save_state.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "util/fnv1a/fnv1a.h"
+#include "util/mapped_file/mapped_file.h"
+
+
+// Identifies a save state file
+static constexpr std::array<char, 8> save_state_magic = {'C', 'H', 'I', 'P', '8', 'S', 'A', 'V'};
+
+
+// Compute the checksum of a header and the state that follows it
+[[nodiscard]]
+static auto compute_checksum(const save_state_header& header, std::span<const uint8_t> state) noexcept -> uint64_t {
+	const auto hash = fnv1a({reinterpret_cast<const uint8_t*>(&header), offsetof(save_state_header, checksum)});
+	return fnv1a(state, hash);
+}
+
+
+//----------------------------------------------------------------------------------
+// SaveState
+//----------------------------------------------------------------------------------
+
+SaveState::SaveState(const chip8& chip) {
+	const size_t state_size = chip.state.size();
+
+	auto header = save_state_header{};
+	header.magic                  = save_state_magic;
+	header.version                = save_state_version;
+	header.layout_size            = sizeof(chip8_state);
+	header.state_size             = static_cast<uint32_t>(state_size);
+	header.platform               = chip.platform;
+	header.quirk_profile          = chip.quirk_profile;
+	header.clock_mode             = chip.clock_mode;
+	header.halt_reason            = chip.halt_reason;
+	header.clock_rate             = chip.clock_rate;
+	header.instructions_per_frame = chip.instructions_per_frame;
+	header.rom_size               = static_cast<uint32_t>(chip.rom_end - chip8::rom_start);
+	header.rom_digest             = chip.rom_digest;
+
+	bytes.resize(sizeof(header) + state_size);
+	std::memcpy(bytes.data() + sizeof(header), &chip.state, state_size);
+
+	header.checksum = compute_checksum(header, std::span{bytes}.subspan(sizeof(header)));
+	std::memcpy(bytes.data(), &header, sizeof(header));
+}
+
+
+auto SaveState::write(const std::filesystem::path& file) const -> bool {
+	auto error = std::error_code{};
+	if (file.has_parent_path()) {
+		std::filesystem::create_directories(file.parent_path(), error);
+	}
+
+	auto temp_file = file;
+	temp_file += ".tmp";
+
+	{
+		std::ofstream out(temp_file, std::ios::binary | std::ios::trunc);
+		if (!out or !out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+			std::cout << "Error writing the save state " << file << '\n';
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temp_file, file, error);
+	if (error) {
+		std::cout << "Error writing the save state " << file << ": " << error.message() << '\n';
+		std::filesystem::remove(temp_file, error);
+		return false;
+	}
+
+	return true;
+}
+
+
+auto SaveState::apply(std::span<const uint8_t> data, chip8& chip) -> bool {
+	if (data.size() < sizeof(save_state_header)) {
+		std::cout << "Error loading the save state: The file is too small\n";
+		return false;
+	}
+
+	auto header = save_state_header{};
+	std::memcpy(&header, data.data(), sizeof(header));
+	const auto state_bytes = data.subspan(sizeof(header));
+
+	if (header.magic != save_state_magic) {
+		std::cout << "Error loading the save state: The file isn't a save state\n";
+		return false;
+	}
+	if (header.version != save_state_version) {
+		std::cout << "Error loading the save state: It has version " << header.version << ", but version " << save_state_version << " is supported\n";
+		return false;
+	}
+	if (header.layout_size != sizeof(chip8_state)) {
+		std::cout << "Error loading the save state: It was saved by a build with a different state layout\n";
+		return false;
+	}
+	if ((header.platform > Platform::xo_chip) or (header.quirk_profile > QuirkProfile::xo_chip)
+	    or (header.clock_mode > ClockMode::instructions_per_frame) or (header.halt_reason > HaltReason::stack_overflow)
+	    or (header.clock_rate == 0) or (header.clock_rate > chip8::max_clock_rate)
+	    or (header.instructions_per_frame == 0) or (header.instructions_per_frame > chip8::max_instructions_per_frame)
+	    or ((chip8::rom_start + size_t{header.rom_size}) > memory_size(header.platform))
+	    or (header.state_size != (offsetof(chip8_state, memory) + memory_size(header.platform)))
+	    or (state_bytes.size() != header.state_size)) {
+		std::cout << "Error loading the save state: The file is malformed\n";
+		return false;
+	}
+	if (compute_checksum(header, state_bytes) != header.checksum) {
+		std::cout << "Error loading the save state: The checksum doesn't match\n";
+		return false;
+	}
+	if ((chip.rom_end != chip8::rom_start) and (header.rom_digest != chip.rom_digest)) {
+		std::cout << "Error loading the save state: It was saved with a different ROM\n";
+		return false;
+	}
+
+	// The state is restored straight from the data when it's aligned, which it is in a mapped file.
+	// Only the bytes in use are read, so the data doesn't need to hold the whole struct.
+	const auto* state = reinterpret_cast<const chip8_state*>(state_bytes.data());
+	auto aligned = std::unique_ptr<chip8_state>{};
+
+	if ((reinterpret_cast<uintptr_t>(state) % alignof(chip8_state)) != 0) {
+		aligned = std::make_unique<chip8_state>();
+		std::memcpy(static_cast<void*>(aligned.get()), state_bytes.data(), state_bytes.size());
+		state = aligned.get();
+	}
+
+	// The registers that index into the state must be in range
+	const bool valid_key_register = (state->key_register < 16) or (state->key_register == chip8_state::no_key_wait);
+	if ((state->address_mask != (memory_size(header.platform) - 1)) or (state->sp > chip8_state::stack_size) or !valid_key_register) {
+		std::cout << "Error loading the save state: The file is malformed\n";
+		return false;
+	}
+
+	// Selecting the platform resets the system, so it's applied first
+	if (header.platform != chip.platform) {
+		chip.set_platform(header.platform);
+	}
+	if (header.quirk_profile != chip.quirk_profile) {
+		chip.set_quirk_profile(header.quirk_profile);
+	}
+	chip.clock_mode             = header.clock_mode;
+	chip.clock_rate             = header.clock_rate;
+	chip.instructions_per_frame = header.instructions_per_frame;
+	chip.rom_end                = chip8::rom_start + header.rom_size;
+	chip.rom_digest             = header.rom_digest;
+
+	if (!chip.restore(*state)) {
+		return false;
+	}
+
+	// A key wait is halted by restore
+	if ((header.halt_reason != HaltReason::none) and (header.halt_reason != HaltReason::key_wait)) {
+		chip.halt(header.halt_reason);
+	}
+	else if (header.halt_reason == HaltReason::none) {
+		chip.resume();
+	}
+
+	return true;
+}
+
+
+auto SaveState::load(const std::filesystem::path& file, chip8& chip) -> bool {
+	const auto mapping = MappedFile{file};
+	if (!mapping.is_open()) {
+		std::cout << "Error opening the save state " << file << '\n';
+		return false;
+	}
+	return apply(mapping.get_bytes(), chip);
+}
+
+
+//----------------------------------------------------------------------------------
+// SaveStateWriter
+//----------------------------------------------------------------------------------
+
+SaveStateWriter::SaveStateWriter() : thread([this] { worker_loop(); }) {
+}
+
+
+SaveStateWriter::~SaveStateWriter() {
+	{
+		std::scoped_lock lock{mutex};
+		stopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+
+auto SaveStateWriter::submit(std::filesystem::path file, SaveState state) -> void {
+	{
+		std::scoped_lock lock{mutex};
+
+		const auto it = std::ranges::find(queue, file, [](const auto& entry) -> const auto& { return entry.first; });
+		if (it != queue.end()) {
+			it->second = std::move(state);
+		}
+		else {
+			queue.emplace_back(std::move(file), std::move(state));
+		}
+	}
+	wake.notify_one();
+}
+
+
+auto SaveStateWriter::flush() -> void {
+	std::unique_lock lock{mutex};
+	done.wait(lock, [this] { return queue.empty() and !writing; });
+}
+
+
+auto SaveStateWriter::worker_loop() -> void {
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		wake.wait(lock, [this] { return stopping or !queue.empty(); });
+
+		// The queue is drained before stopping, so no save is lost on exit
+		if (queue.empty()) {
+			return;
+		}
+
+		auto [file, state] = std::move(queue.front());
+		queue.erase(queue.begin());
+		writing = true;
+
+		lock.unlock();
+		(void)state.write(file);
+		lock.lock();
+
+		writing = false;
+		done.notify_all();
+	}
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "chip8/chip8.h"
+#include "util/sha1/sha1.h"
+
+
+/// The version of the save state format. Incremented whenever the header or the layout of chip8_state changes.
+inline constexpr uint32_t save_state_version = 1;
+
+
+/**
+ * @struct save_state_header
+ * @brief  The header at the start of a save state file, which is followed by the bytes of a chip8_state
+ */
+struct save_state_header {
+    // Identifies a save state file
+    std::array<char, 8> magic;
+
+    // The version of the format (see save_state_version)
+    uint32_t version;
+
+    // The size of chip8_state in the build that wrote the file. The state is
+    // stored as it's laid out in memory, so a build with a different layout
+    // can't read it.
+    uint32_t layout_size;
+
+    // The number of bytes of the state that follow the header (see chip8_state::size)
+    uint32_t state_size;
+
+    // The settings the state was saved with
+    Platform     platform;
+    QuirkProfile quirk_profile;
+    ClockMode    clock_mode;
+    HaltReason   halt_reason;
+    uint32_t     clock_rate;
+    uint32_t     instructions_per_frame;
+
+    // The size and SHA-1 digest of the ROM that was loaded
+    uint32_t    rom_size;
+    sha1_digest rom_digest;
+
+    // A 64-bit FNV-1a hash of the header up to this member, followed by the state
+    uint64_t checksum;
+};
+
+static_assert(std::has_unique_object_representations_v<save_state_header>, "The header is checksummed as bytes, so it can't have padding");
+static_assert((sizeof(save_state_header) % alignof(chip8_state)) == 0, "The state that follows the header must be aligned");
+
+
+/**
+ * @class SaveState
+ *
+ * @brief A snapshot of a chip8 and the settings it runs with, in the save state file format
+ *
+ * @details A save state file is a save_state_header followed by the bytes of
+ *          the chip8_state in use. The state is checksummed, and checked
+ *          against the version, the layout of chip8_state, the platform, and
+ *          the loaded ROM before it's applied.
+ *
+ *          Loading maps the file and restores the chip8 directly from the
+ *          mapping, so the state isn't copied into an intermediate buffer.
+ *          Writing can be moved off of the emulation thread with a
+ *          @ref SaveStateWriter, since capturing a SaveState only copies the
+ *          state.
+ */
+class SaveState {
+public:
+
+    /// Capture the state and settings of a system
+    explicit SaveState(const chip8& chip);
+
+    /// Get the save state in the file format
+    [[nodiscard]]
+    auto get_bytes() const noexcept -> std::span<const uint8_t> {
+        return bytes;
+    }
+
+    /**
+     * @brief Write the save state to a file
+     *
+     * @details The file is written under a temporary name and then renamed,
+     *          so an interrupted write never leaves a partial file behind.
+     *          Missing directories are created.
+     *
+     * @param[in] file  The path of the file
+     *
+     * @return True if the file was written, otherwise false.
+     */
+    [[nodiscard]]
+    auto write(const std::filesystem::path& file) const -> bool;
+
+    /**
+     * @brief Check a save state and apply it to a system
+     *
+     * @details The platform, quirk profile, and clock settings of the save
+     *          state are applied, then the state is restored (see chip8::restore).
+     *          The system resumes, unless the state was saved while it was
+     *          halted. A state saved with a different ROM than the loaded one
+     *          is rejected. The system is unchanged if the data is rejected.
+     *
+     * @param[in] data  A save state in the file format
+     * @param[in] chip  The system to apply the save state to
+     *
+     * @return True if the save state was applied, otherwise false.
+     */
+    [[nodiscard]]
+    static auto apply(std::span<const uint8_t> data, chip8& chip) -> bool;
+
+    /// Map a save state file and apply it to a system (see apply)
+    [[nodiscard]]
+    static auto load(const std::filesystem::path& file, chip8& chip) -> bool;
+
+private:
+
+    // The header and state. The allocation is aligned for the state that follows the header.
+    std::vector<uint8_t> bytes;
+};
+
+
+/**
+ * @class SaveStateWriter
+ *
+ * @brief Writes save states to files on a background thread
+ *
+ * @details Saving from the emulation or render loop only captures the state.
+ *          The file is written on the writer's thread, so periodic autosaves
+ *          don't stall the loop on disk I/O. A state that is queued for a file
+ *          which already has a queued state replaces it, so a slow disk
+ *          doesn't build up a backlog of outdated states.
+ */
+class SaveStateWriter {
+public:
+
+    SaveStateWriter();
+
+    /// Writes the queued states, then stops the thread
+    ~SaveStateWriter();
+
+    SaveStateWriter(const SaveStateWriter&) = delete;
+    auto operator=(const SaveStateWriter&) -> SaveStateWriter& = delete;
+
+    /**
+     * @brief Queue a save state to be written to a file
+     *
+     * @param[in] file   The path of the file
+     * @param[in] state  The save state to write
+     */
+    auto submit(std::filesystem::path file, SaveState state) -> void;
+
+    /// Block until every queued state has been written
+    auto flush() -> void;
+
+private:
+
+    auto worker_loop() -> void;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // The states waiting to be written, in the order they were queued
+    std::vector<std::pair<std::filesystem::path, SaveState>> queue;
+
+    // True while the worker is writing a state that it took off of the queue
+    bool writing = false;
+
+    bool stopping = false;
+
+    // Constructed last, so the members above exist before the thread uses them
+    std::thread thread;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <span>
@@ -7,17 +8,70 @@
 
 /**
  * @class Display
- * 
- * @brief Holds a 2D array of values with dimensions SizeX by SizeY
- * 
- * @tparam SizeX  The size of the display in the x dimension
- * @tparam SizeY  The size of the display in the y dimension
+ *
+ * @brief A 2 bit per pixel display with a high resolution of SizeX by SizeY
+ *
+ * @details The display has two bitplanes, as used by XO-CHIP. Each pixel is
+ *          a 2 bit palette index, with plane 0 in the low bit and plane 1 in
+ *          the high bit. CHIP-8 and SUPER-CHIP programs only draw to plane 0,
+ *          so their pixels are either 0 (background) or 1 (foreground).
+ *
+ *          Each row is stored as SizeX / 32 words, with the leftmost pixel
+ *          of each word in its two most significant bits. Sprites are drawn a
+ *          row at a time with a shift, an AND to detect collisions, and an
+ *          XOR, instead of one pixel at a time. Both planes of a sprite row
+ *          are interleaved before they're drawn, so drawing to two planes
+ *          costs the same as drawing to one. The display doesn't hold any
+ *          colors. They're applied when the display is converted to RGBA (see
+ *          to_rgba), or by the consumer of the pixel indices (see to_indices).
+ *          The display is trivially copyable, so it can be saved and restored
+ *          as part of the state of the system.
+ *
+ *          Clearing and scrolling only affect the selected planes (see
+ *          set_planes). Plane 0 is selected by default.
+ *
+ *          The drawing operations take a Wrap template argument. Wrapping
+ *          causes pixels that are drawn past the extents of the display to
+ *          wrap around to the other side. Pixels drawn past the extents are
+ *          discarded when wrapping is disabled. The interpreter selects it
+ *          from its quirks at compile time (see quirks::wrap).
+ *
+ *          The display starts in low resolution mode, where only the top left
+ *          SizeX / 2 by SizeY / 2 pixels are used. The coordinates, wrapping,
+ *          and scrolling all use the active resolution. The conversions always
+ *          output the full SizeX by SizeY pixels, scaling a low resolution
+ *          display up by 2, so a consumer doesn't have to handle both sizes.
+ *
+ *          Every change to the pixels increments a generation counter, so a
+ *          consumer of the display can skip converting and uploading it when
+ *          the counter hasn't changed since the last time. Each row also
+ *          records the generation of its last change, so a consumer that
+ *          only needs the rows that changed (e.g. a rewind buffer) can find
+ *          them without comparing the pixels.
+ *
+ * @tparam SizeX  The size of the display in the x dimension. Must be a multiple of 128.
+ * @tparam SizeY  The size of the display in the y dimension. Must be a multiple of 2.
  */
 template<size_t SizeX, size_t SizeY>
 class Display {
+	static_assert((SizeX % 128) == 0, "The width of the display must be a multiple of 128");
+	static_assert((SizeY % 2) == 0, "The height of the display must be a multiple of 2");
+
 public:
+	// The number of words in each row
+	static constexpr size_t row_words = SizeX / 32;
+
+	// The number of pixels in each word
+	static constexpr size_t word_pixels = 32;
+
+	// The plane selection that contains both planes
+	static constexpr uint8_t all_planes = 0b11;
+
+	// The default colors of each palette index: background, plane 0, plane 1, and both planes
+	static constexpr std::array<uint32_t, 4> default_palette = {0x000000FF, 0xFFFFFFFF, 0xAAAAAAFF, 0x555555FF};
+
 	Display() {
-		pixels.fill(bg_color);
+		clear();
 	}
 
 	//--------------------------------------------------------------------------------
@@ -25,150 +79,258 @@ public:
 	//--------------------------------------------------------------------------------
 
 	/**
-	 * @brief Enable or disable wrapping
-	 * 
-	 * @details Wrapping will cause pixels that are drawn past the extents of
-	 *          the display to wrap around to the other side.
-	 * 
-	 * @param[in] state  The wrapping state to set
+	 * @brief Select the planes that are affected by clearing and scrolling
+	 *
+	 * @param[in] planes  A bitmask of planes. Bit 0 selects plane 0, and bit 1 selects plane 1.
 	 */
-	auto set_wrapping(bool state) noexcept -> void {
-		wrapping = state;
+	auto set_planes(uint8_t planes) noexcept -> void {
+		selected_planes = planes & all_planes;
 	}
 
 	/**
-	 * @brief Get the wrapping state
-	 * @return The wrapping state
+	 * @brief  Get the selected planes
+	 * @return A bitmask of planes. Bit 0 is plane 0, and bit 1 is plane 1.
 	 */
-	auto get_wrapping() const noexcept -> bool {
-		return wrapping;
+	[[nodiscard]]
+	auto get_planes() const noexcept -> uint8_t {
+		return selected_planes;
 	}
 
 
 	/**
 	 * @brief Draw a pixel (set to foreground color) at the specified location
-	 * 
+	 *
+	 * @tparam Wrap  Wrap the coordinates around the display when true, or discard the pixel when it's outside the display
+	 *
 	 * @param[in] x  The x coordinate of the pixel
 	 * @param[in] y  The y coordinate of the pixel
 	 */
-	auto draw(size_t x, size_t y) -> void {
-		if (wrapping) {
-			x %= SizeX;
-			y %= SizeY;
+	template<bool Wrap = true>
+	auto draw(size_t x, size_t y) noexcept -> void {
+		if (locate<Wrap>(x, y)) {
+			word(x, y) |= bit(x);
+			touch_row(y);
 		}
-
-		row(y)[x] = fg_color;
 	}
 
 	/**
 	 * @brief Erase a pixel (set to background color) at the specified location
-	 * 
+	 *
+	 * @tparam Wrap  Wrap the coordinates around the display when true, or discard the pixel when it's outside the display
+	 *
 	 * @param[in] x  The x coordinate of the pixel
 	 * @param[in] y  The y coordinate of the pixel
 	 */
-	auto erase(size_t x, size_t y) -> void {
-		if (wrapping) {
-			x %= SizeX;
-			y %= SizeY;
+	template<bool Wrap = true>
+	auto erase(size_t x, size_t y) noexcept -> void {
+		if (locate<Wrap>(x, y)) {
+			word(x, y) &= ~(bit(x) * all_planes);
+			touch_row(y);
 		}
-
-		row(y)[x] = bg_color;
 	}
 
 	/**
 	 * @brief  Flip the color of the pixels at the specified location
-	 * 
+	 *
+	 * @tparam Wrap  Wrap the coordinates around the display when true, or discard the pixel when it's outside the display
+	 *
 	 * @param[in] x  The x coordinate of the pixel
 	 * @param[in] y  The y coordinate of the pixel
-	 * 
+	 *
 	 * @return True if the pixel was flipped from the foreground color to the background color, otherwise false.
 	 */
+	template<bool Wrap = true>
 	[[nodiscard]]
-	auto flip(size_t x, size_t y) -> bool {
-		if (wrapping) {
-			x %= SizeX;
-			y %= SizeY;
+	auto flip(size_t x, size_t y) noexcept -> bool {
+		if (!locate<Wrap>(x, y)) {
+			return false;
 		}
 
-		if (row(y)[x] == bg_color) {
-			row(y)[x] = fg_color;
+		auto& w = word(x, y);
+		const bool erased = (w & bit(x)) != 0;
+		w ^= bit(x);
+		touch_row(y);
+		return erased;
+	}
+
+	/**
+	 * @brief XOR a row of a sprite onto the display
+	 *
+	 * @details The two planes of the sprite row are interleaved, shifted to
+	 *          their position within the row of the display, and XORed onto
+	 *          the one or two words that they overlap. With wrapping enabled,
+	 *          the part of the row that is past the right edge of the display
+	 *          is drawn at the left edge. Otherwise it's discarded.
+	 *
+	 * @tparam Wrap  Wrap the sprite row around the display when true, or clip it at the edges
+	 *
+	 * @param[in] x       The x coordinate of the leftmost pixel of the sprite row
+	 * @param[in] y       The y coordinate of the sprite row
+	 * @param[in] plane0  The pixels of the sprite row in plane 0. The most significant of the low @p width bits is the leftmost pixel.
+	 * @param[in] plane1  The pixels of the sprite row in plane 1, in the same format as @p plane0
+	 * @param[in] width   The number of pixels in the sprite row, from 1 to 32
+	 *
+	 * @return True if any pixel in either plane was flipped from set to unset, otherwise false.
+	 */
+	template<bool Wrap = true>
+	[[nodiscard]]
+	auto xor_row(size_t x, size_t y, uint32_t plane0, uint32_t plane1, size_t width) noexcept -> bool {
+		if (!locate<Wrap>(x, y) or ((plane0 | plane1) == 0)) {
 			return false;
 		}
-		else {
-			row(y)[x] = bg_color;
-			return true;
+		touch_row(y);
+
+		// Interleave the planes, and align the leftmost pixel of the sprite with the most significant bits
+		const uint64_t sprite = (spread(plane0) | (spread(plane1) << 1)) << (64 - (2 * width));
+		const size_t   first  = x / word_pixels;
+		const size_t   shift  = 2 * (x % word_pixels);
+
+		uint64_t* const words = &pixels[y * row_words];
+		bool erased = false;
+
+		// The part of the sprite in the word that contains x
+		const uint64_t head = sprite >> shift;
+		erased |= (words[first] & head) != 0;
+		words[first] ^= head;
+
+		// The part that spills into the next word, which is the first word of the row when wrapping
+		if (shift != 0) {
+			const uint64_t tail = sprite << (64 - shift);
+			const size_t   next = first + 1;
+
+			if (next < active_words()) {
+				erased |= (words[next] & tail) != 0;
+				words[next] ^= tail;
+			}
+			else if constexpr (Wrap) {
+				erased |= (words[0] & tail) != 0;
+				words[0] ^= tail;
+			}
 		}
+
+		return erased;
 	}
 
 	/**
-	 * @brief Clear the entire screen
+	 * @brief Clear every plane of the entire screen
 	 */
 	auto clear() noexcept -> void {
-		pixels.fill(bg_color);
+		pixels.fill(0);
+		touch_all_rows();
+	}
+
+	/**
+	 * @brief Clear the selected planes of the entire screen
+	 */
+	auto clear_planes() noexcept -> void {
+		const uint64_t mask = plane_mask();
+		for (auto& w : pixels) {
+			w &= ~mask;
+		}
+		touch_all_rows();
 	}
 
 
 	//--------------------------------------------------------------------------------
-	// Background Color
+	// Scrolling
 	//--------------------------------------------------------------------------------
 
 	/**
-	 * @brief  Get the display's background color
-	 * @return The background color of the display
+	 * @brief Scroll the display down
+	 *
+	 * @details The selected planes of the rows are moved down, and the rows
+	 *          that are scrolled in at the top are cleared.
+	 *
+	 * @param[in] rows  The number of rows to scroll by
 	 */
-	[[nodiscard]]
-	auto get_background_color() const noexcept -> uint32_t {
-		return bg_color;
+	auto scroll_down(size_t rows) noexcept -> void {
+		rows = std::min(rows, active_height);
+		const uint64_t mask = plane_mask();
+
+		for (size_t w = active_height * row_words; w-- > rows * row_words;) {
+			pixels[w] = merge(pixels[w], pixels[w - (rows * row_words)], mask);
+		}
+		for (size_t w = 0; w < rows * row_words; ++w) {
+			pixels[w] &= ~mask;
+		}
+		touch_all_rows();
 	}
 
 	/**
-	 * @brief  Set the display's background color
-	 * 
-	 * @param[in] new_color  The new background color for the display
+	 * @brief Scroll the display right
+	 *
+	 * @details Each row is shifted a word at a time, carrying the bits that
+	 *          are shifted out of a word into the next one. The pixels that
+	 *          are scrolled past the right edge are discarded. Only the
+	 *          selected planes are moved.
+	 *
+	 * @param[in] columns  The number of columns to scroll by, from 1 to 31
 	 */
-	auto set_background_color(uint32_t new_color) noexcept -> void {
-		for (size_t y = 0; y < SizeY; ++y) {
-			for (size_t x = 0; x < SizeX; ++x) {
-				if (row(y)[x] == bg_color) {
-					row(y)[x] = new_color;
-				}
+	auto scroll_right(size_t columns) noexcept -> void {
+		const size_t   words = active_words();
+		const size_t   bits  = 2 * columns;
+		const uint64_t mask  = plane_mask();
+
+		for (size_t y = 0; y < active_height; ++y) {
+			uint64_t* const row = &pixels[y * row_words];
+			for (size_t w = words - 1; w > 0; --w) {
+				row[w] = merge(row[w], (row[w] >> bits) | (row[w - 1] << (64 - bits)), mask);
 			}
+			row[0] = merge(row[0], row[0] >> bits, mask);
 		}
+		touch_all_rows();
+	}
 
-		bg_color = new_color;
+	/**
+	 * @brief Scroll the display left
+	 *
+	 * @details Each row is shifted a word at a time, carrying the bits that
+	 *          are shifted out of a word into the previous one. The pixels
+	 *          that are scrolled past the left edge are discarded. Only the
+	 *          selected planes are moved.
+	 *
+	 * @param[in] columns  The number of columns to scroll by, from 1 to 31
+	 */
+	auto scroll_left(size_t columns) noexcept -> void {
+		const size_t   words = active_words();
+		const size_t   bits  = 2 * columns;
+		const uint64_t mask  = plane_mask();
+
+		for (size_t y = 0; y < active_height; ++y) {
+			uint64_t* const row = &pixels[y * row_words];
+			for (size_t w = 0; w + 1 < words; ++w) {
+				row[w] = merge(row[w], (row[w] << bits) | (row[w + 1] >> (64 - bits)), mask);
+			}
+			row[words - 1] = merge(row[words - 1], row[words - 1] << bits, mask);
+		}
+		touch_all_rows();
 	}
 
 
 	//--------------------------------------------------------------------------------
-	// Foreground Color
+	// Resolution
 	//--------------------------------------------------------------------------------
 
 	/**
-	 * @brief  Get the display's foreground color
-	 * @return The foreground color of the display
+	 * @brief Switch between the low and high resolutions
+	 *
+	 * @details Switching the resolution clears the display.
+	 *
+	 * @param[in] state  True for SizeX by SizeY, or false for SizeX / 2 by SizeY / 2
 	 */
-	[[nodiscard]]
-	auto get_foreground_color() const noexcept -> uint32_t {
-		return fg_color;
+	auto set_hires(bool state) noexcept -> void {
+		active_width  = state ? SizeX : (SizeX / 2);
+		active_height = state ? SizeY : (SizeY / 2);
+		clear();
 	}
 
-
 	/**
-	 * @brief  Set the display's foreground color
-	 * 
-	 * @param[in] new_color  The new foreground color for the display
+	 * @brief  Check if the display is in high resolution mode
+	 * @return True if the display is in high resolution mode
 	 */
-	auto set_foreground_color(uint32_t new_color) noexcept -> void {
-		// Update drawn pixels
-		for (size_t y = 0; y < SizeY; ++y) {
-			for (size_t x = 0; x < SizeX; ++x) {
-				if (row(y)[x] == fg_color) {
-					row(y)[x] = new_color;
-				}
-			}
-		}
-
-		fg_color = new_color;
+	[[nodiscard]]
+	auto is_hires() const noexcept -> bool {
+		return active_width == SizeX;
 	}
 
 
@@ -177,31 +339,49 @@ public:
 	//--------------------------------------------------------------------------------
 
 	/**
-	 * @brief  Get the X dimension of the display
+	 * @brief  Get the X dimension of the display at the active resolution
 	 * @return The X dimension
 	 */
 	[[nodiscard]]
 	auto size_x() const noexcept -> size_t {
-		return SizeX;
+		return active_width;
 	}
 
 	/**
-	 * @brief  Get the Y dimension of the display
+	 * @brief  Get the Y dimension of the display at the active resolution
 	 * @return The Y dimension
 	 */
 	[[nodiscard]]
 	auto size_y() const noexcept -> size_t {
+		return active_height;
+	}
+
+	/**
+	 * @brief  Get the X dimension of the display at the high resolution
+	 * @return The X dimension
+	 */
+	[[nodiscard]]
+	static constexpr auto max_size_x() noexcept -> size_t {
+		return SizeX;
+	}
+
+	/**
+	 * @brief  Get the Y dimension of the display at the high resolution
+	 * @return The Y dimension
+	 */
+	[[nodiscard]]
+	static constexpr auto max_size_y() noexcept -> size_t {
 		return SizeY;
 	}
 
 
 	/**
-	 * @brief  Get the number of pixels in the display
-	 * @return The number of pixels. Equal to sizeX() * sizeY().
+	 * @brief  Get the number of pixels in the display at the high resolution
+	 * @return The number of pixels. Equal to max_size_x() * max_size_y().
 	 */
 	[[nodiscard]]
-	auto size() const noexcept -> size_t {
-		return pixels.size();
+	static constexpr auto max_size() noexcept -> size_t {
+		return SizeX * SizeY;
 	}
 
 
@@ -210,36 +390,186 @@ public:
 	//--------------------------------------------------------------------------------
 
 	/**
-	 * @brief  Get a raw pointer to the pixel array
-	 * @return A pointer to the array of pixels
+	 * @brief  Get the display's generation
+	 *
+	 * @details The generation is incremented whenever a pixel may have
+	 *          changed. Two reads that return the same value saw the same
+	 *          pixels, unless the display was replaced by a copy in between.
+	 *          The copy carries the generation of its source.
+	 *
+	 * @return The number of changes made to the pixels
 	 */
 	[[nodiscard]]
-	auto data() const noexcept -> const uint32_t* {
-		return pixels.data();
+	auto get_generation() const noexcept -> uint64_t {
+		return generation;
 	}
 
 	/**
-	 * @brief  Get a raw pointer to the pixel array
-	 * @return A pointer to the array of pixels
+	 * @brief  Get the generation of the last change to each row
+	 *
+	 * @details Row y changed after a read of get_generation() returned G if
+	 *          its row generation is greater than G. Like the generation,
+	 *          the row generations are carried by copies of the display.
+	 *
+	 * @return The generation of the display after each row last changed, from the top row to the bottom row
 	 */
 	[[nodiscard]]
-	auto data() noexcept -> uint32_t* {
-		return pixels.data();
+	auto get_row_generations() const noexcept -> std::span<const uint64_t, SizeY> {
+		return row_generations;
+	}
+
+	/**
+	 * @brief  Check if a pixel is set in any plane
+	 *
+	 * @param[in] x  The x coordinate of the pixel. Must be less than size_x().
+	 * @param[in] y  The y coordinate of the pixel. Must be less than size_y().
+	 *
+	 * @return True if the pixel isn't set to the background color
+	 */
+	[[nodiscard]]
+	auto get_pixel(size_t x, size_t y) const noexcept -> bool {
+		return get_index(x, y) != 0;
+	}
+
+	/**
+	 * @brief  Get the palette index of a pixel
+	 *
+	 * @param[in] x  The x coordinate of the pixel. Must be less than size_x().
+	 * @param[in] y  The y coordinate of the pixel. Must be less than size_y().
+	 *
+	 * @return The palette index, with plane 0 in bit 0 and plane 1 in bit 1
+	 */
+	[[nodiscard]]
+	auto get_index(size_t x, size_t y) const noexcept -> uint8_t {
+		const uint64_t w = pixels[(y * row_words) + (x / word_pixels)];
+		return static_cast<uint8_t>((w >> (62 - (2 * (x % word_pixels)))) & all_planes);
+	}
+
+	/**
+	 * @brief  Get the packed pixels
+	 *
+	 * @details Each row is row_words long at either resolution. Only the
+	 *          first size_x() / 32 words of the first size_y() rows are used.
+	 *
+	 * @return The words of every row, from the top row to the bottom row
+	 */
+	[[nodiscard]]
+	auto get_rows() const noexcept -> std::span<const uint64_t, row_words * SizeY> {
+		return pixels;
+	}
+
+	/**
+	 * @brief Convert the display to 32-bit RGBA pixels
+	 *
+	 * @param[out] out      The pixels at the high resolution, in row-major order
+	 * @param[in]  palette  The color of each palette index (see default_palette)
+	 */
+	auto to_rgba(std::span<uint32_t, SizeX * SizeY> out, std::span<const uint32_t, 4> palette = default_palette) const noexcept -> void {
+		const size_t scale = is_hires() ? 1 : 2;
+
+		for (size_t y = 0; y < SizeY; ++y) {
+			for (size_t x = 0; x < SizeX; ++x) {
+				out[(y * SizeX) + x] = palette[get_index(x / scale, y / scale)];
+			}
+		}
+	}
+
+	/**
+	 * @brief Convert the display to 8-bit palette indices
+	 *
+	 * @details Each pixel is 0 for the background color, 1 for the foreground
+	 *          color, or 2 and 3 for the pixels set in plane 1.
+	 *
+	 * @param[out] out  The indices at the high resolution, in row-major order
+	 */
+	auto to_indices(std::span<uint8_t, SizeX * SizeY> out) const noexcept -> void {
+		const size_t scale = is_hires() ? 1 : 2;
+
+		for (size_t y = 0; y < SizeY; ++y) {
+			for (size_t x = 0; x < SizeX; ++x) {
+				out[(y * SizeX) + x] = get_index(x / scale, y / scale);
+			}
+		}
 	}
 
 private:
 
-	auto row(size_t n) -> std::span<uint32_t, SizeX> {
-		return std::span<uint32_t, SizeX>{&pixels[SizeX * n], SizeX};
+	// The plane 0 bit of a pixel within its word
+	[[nodiscard]]
+	static constexpr auto bit(size_t x) noexcept -> uint64_t {
+		return uint64_t{1} << (62 - (2 * (x % word_pixels)));
+	}
+
+	// Move each bit of a sprite row to the even bit at twice its position, making room for the other plane
+	[[nodiscard]]
+	static constexpr auto spread(uint64_t bits) noexcept -> uint64_t {
+		bits = (bits | (bits << 16)) & 0x0000FFFF0000FFFF;
+		bits = (bits | (bits << 8))  & 0x00FF00FF00FF00FF;
+		bits = (bits | (bits << 4))  & 0x0F0F0F0F0F0F0F0F;
+		bits = (bits | (bits << 2))  & 0x3333333333333333;
+		bits = (bits | (bits << 1))  & 0x5555555555555555;
+		return bits;
+	}
+
+	// Replace the bits of a word in the selected planes
+	[[nodiscard]]
+	static constexpr auto merge(uint64_t old_bits, uint64_t new_bits, uint64_t mask) noexcept -> uint64_t {
+		return (new_bits & mask) | (old_bits & ~mask);
+	}
+
+	// The bits of a word that belong to the selected planes
+	[[nodiscard]]
+	auto plane_mask() const noexcept -> uint64_t {
+		return ((selected_planes & 0b01) ? 0x5555555555555555 : 0) | ((selected_planes & 0b10) ? 0xAAAAAAAAAAAAAAAA : 0);
+	}
+
+	// The number of words in each row that are used at the active resolution
+	[[nodiscard]]
+	auto active_words() const noexcept -> size_t {
+		return active_width / word_pixels;
+	}
+
+	// Wrap the coordinates, or check that they're within the display when not wrapping
+	template<bool Wrap>
+	[[nodiscard]]
+	auto locate(size_t& x, size_t& y) const noexcept -> bool {
+		if constexpr (Wrap) {
+			x %= active_width;
+			y %= active_height;
+			return true;
+		}
+		return (x < active_width) and (y < active_height);
+	}
+
+	[[nodiscard]]
+	auto word(size_t x, size_t y) noexcept -> uint64_t& {
+		return pixels[(y * row_words) + (x / word_pixels)];
+	}
+
+	// Count a change to a row
+	auto touch_row(size_t y) noexcept -> void {
+		row_generations[y] = ++generation;
+	}
+
+	// Count a change to every row
+	auto touch_all_rows() noexcept -> void {
+		row_generations.fill(++generation);
 	}
 
 	//--------------------------------------------------------------------------------
 	// Member Variables
 	//--------------------------------------------------------------------------------
-	uint32_t bg_color = 0x000000FF;
-	uint32_t fg_color = 0xFFFFFFFF;
+	// The planes affected by clearing and scrolling
+	uint8_t selected_planes = 0b01;
+
+	// The active resolution
+	size_t active_width  = SizeX / 2;
+	size_t active_height = SizeY / 2;
+
+	uint64_t generation = 0;
 
-	bool wrapping = true;
+	std::array<uint64_t, row_words * SizeY> pixels;
 
-	std::array<uint32_t, SizeX * SizeY> pixels;
+	// The generation of the last change to each row
+	std::array<uint64_t, SizeY> row_generations = {};
 };
@@ -1,23 +1,43 @@
 #include "chip8_emulator.h"
 
+#include <algorithm>
+
 
 auto Chip8Emulator::run() -> void {
     bool stop = false;
-    auto clock_dt = std::chrono::duration<double>{0};
 
     while (!stop) {
         // Update the timer
         timer.tick();
-        clock_dt += timer.delta_time();
 
-        // If not paused and the elapsed time is greater than the clock period, then update.
-        if (clock_dt.count() >= (1.0 / chip.get_clock_rate()) and !chip.is_paused()) {
-            chip.run_cycle();
-            clock_dt = std::chrono::duration<double>{0};
+        // The UI may have reset the CHIP-8 or moved it back since the last frame
+        sync_input_log();
+
+        // Step back through the history while the rewind key is held. Otherwise,
+        // execute the instructions owed since the last frame and record the result.
+        if (media_layer.is_rewind_held()) {
+            rewind_buffer.rewind(chip, 1);
+            cycle_budget = 0.0;
+        }
+        else {
+            const uint64_t start = chip.get_cycle_count();
+            run_cycles(timer.delta_time());
+            if (chip.get_cycle_count() != start) {
+                rewind_buffer.capture(chip);
+            }
         }
+        sync_input_log();
 
         // Process SDL events
-        media_layer.process_events(chip, stop);
+        media_layer.process_events(chip, input_log, stop);
+
+        // Run ahead with the input that was just applied, so it shows up in the frame presented now
+        if (media_layer.is_rewind_held()) {
+            run_ahead.discard();
+        }
+        else {
+            run_ahead.run(chip);
+        }
 
         // Render the UI
         render();
@@ -25,6 +45,64 @@ auto Chip8Emulator::run() -> void {
 }
 
 
+auto Chip8Emulator::run_cycles(std::chrono::duration<double> dt) -> void {
+    // A movie applies its input before checking for a pause, since its input may complete a key wait
+    MoviePlayer* const player = media_layer.get_movie_player();
+    if (player) {
+        player->apply_input(chip, &input_log);
+    }
+
+    // Time spent paused isn't owed to the CHIP-8
+    if (chip.is_paused()) {
+        cycle_budget = 0.0;
+        return;
+    }
+
+    if (chip.get_clock_mode() == ClockMode::instructions_per_frame) {
+        cycle_budget += chip.get_instructions_per_frame();
+    }
+    else {
+        cycle_budget += std::min(dt, max_frame_time).count() * chip.get_clock_rate();
+    }
+
+    if (cycle_budget < 1.0) {
+        return;
+    }
+
+    // A cycle may execute a compiled block of several instructions, so the
+    // budget is measured with the instruction count rather than the cycles run.
+    const uint64_t owed  = static_cast<uint64_t>(cycle_budget);
+    const uint64_t start = chip.get_cycle_count();
+
+    if (player) {
+        (void)player->run_until(chip, start + owed, &input_log);
+    }
+    else {
+        while (!chip.is_paused() and ((chip.get_cycle_count() - start) < owed)) {
+            chip.run_cycle();
+        }
+    }
+
+    cycle_budget -= static_cast<double>(chip.get_cycle_count() - start);
+
+    // Don't carry a debt or surplus across a pause (e.g. a breakpoint or a key wait)
+    if (chip.is_paused()) {
+        cycle_budget = 0.0;
+    }
+}
+
+
 auto Chip8Emulator::render() -> void {
-    media_layer.render(chip);
+    media_layer.render(chip, input_log, debugger, run_ahead);
+}
+
+
+auto Chip8Emulator::sync_input_log() -> void {
+    const uint64_t cycle = chip.get_cycle_count();
+
+    // The input recorded at the restored instruction count was applied after the state was captured
+    if (cycle < input_log_cycle) {
+        input_log.discard_from(cycle);
+    }
+    input_log_cycle = cycle;
 }
@@ -1,12 +1,38 @@
 #pragma once
 
+#include <chrono>
+#include <filesystem>
+#include <memory>
+
 #include "chip8/chip8.h"
+#include "chip8/movie/movie.h"
+#include "chip8/reverse_debugger/reverse_debugger.h"
+#include "chip8/rewind/rewind_buffer.h"
+#include "chip8/rom_database/rom_database.h"
+#include "chip8/run_ahead/run_ahead.h"
+#include "input/input_log.h"
 #include "media_layer/media_layer.h"
 
 
 class Chip8Emulator {
 public:
 
+    Chip8Emulator() {
+        // Persist the SUPER-CHIP RPL user flags of each ROM between runs
+        chip.set_flags_directory("rpl");
+
+        // Count the timers down with the instructions, so the reverse debugger can re-execute them
+        chip.set_timer_mode(TimerMode::virtual_time);
+
+        // Select the platform, quirks, and clock of known ROMs when they're loaded
+        if (std::filesystem::exists(rom_database_path)) {
+            auto database = std::make_shared<RomDatabase>();
+            if (database->load(rom_database_path)) {
+                chip.set_rom_database(std::move(database));
+            }
+        }
+    }
+
     /**
      * @copydoc chip8::load_rom
      */
@@ -22,9 +48,33 @@ public:
 
 private:
 
+    /**
+     * @brief Execute the instructions owed to the CHIP-8 for the time since the last host frame
+     *
+     * @details In ClockMode::hz, the elapsed time is converted into a number of
+     *          instructions. The fractional remainder is carried over to the next
+     *          frame, so the clock rate is met on average regardless of the host
+     *          frame rate. In ClockMode::instructions_per_frame, a fixed number
+     *          of instructions are executed.
+     *
+     * @param[in] dt  The time elapsed since the last host frame
+     */
+    auto run_cycles(std::chrono::duration<double> dt) -> void;
+
     /// Renders the user interface
     auto render() -> void;
 
+    /// Discard the recorded input that's ahead of the chip8, after it was rewound, reset, or loaded an earlier state
+    auto sync_input_log() -> void;
+
+    // The longest host frame that is caught up on. The rest of a longer stall
+    // (e.g. while the window is being dragged) is dropped rather than executed
+    // in one large batch.
+    static constexpr std::chrono::duration<double> max_frame_time{0.25};
+
+    // The database of the settings of known ROMs, loaded at startup if it exists
+    static inline const std::filesystem::path rom_database_path = "roms/rom_database.txt";
+
 
     // The CHIP-8 itself
     chip8 chip;
@@ -32,6 +82,23 @@ private:
     // The media layer, which handles rendering and I/O.
     MediaLayer media_layer;
 
+    // The state of each host frame, which is rewound one frame per host frame while the rewind key is held
+    RewindBuffer rewind_buffer;
+
+    // The key presses and releases applied to the CHIP-8, and the instruction count they're recorded up to
+    InputLog input_log;
+    uint64_t input_log_cycle = 0;
+
+    // Steps backward through the history for the debugger windows
+    ReverseDebugger debugger{rewind_buffer, input_log};
+
+    // Presents the display a few frames ahead of the CHIP-8, to hide the frames a ROM takes to react to input
+    RunAhead run_ahead;
+
     // The timer used to limit the execution rate
     Stopwatch<> timer;
+
+    // The number of instructions owed to the CHIP-8. Holds the fractional remainder
+    // between frames, and becomes negative when a compiled block overshoots it.
+    double cycle_budget = 0.0;
 };
\ No newline at end of file
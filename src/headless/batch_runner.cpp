@@ -0,0 +1,136 @@
+#include "batch_runner.h"
+#include "util/thread_pool/thread_pool.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+
+
+// Run a job on its own chip8
+static auto run_job(const batch_job& job, const batch_options& options, batch_result& result) -> void {
+	result.job = job;
+
+	// The chip8 is large, so it's kept off of the worker's stack
+	auto runner = std::make_unique<HeadlessRunner>();
+	auto& chip  = runner->get_chip();
+
+	options.system.apply(chip);
+	if (job.seed) {
+		chip.set_rng_seed(*job.seed);
+	}
+
+	if (!runner->load_rom(job.rom)) {
+		return;
+	}
+
+	result.loaded       = true;
+	result.run          = options.frames ? runner->run_frames(options.count) : runner->run_instructions(options.count);
+	result.halt_reason  = chip.get_halt_reason();
+	result.display_hash = hash_display(chip.get_display());
+}
+
+
+// Run jobs that share a ROM on the lanes of a Chip8Batch
+static auto run_lockstep(std::span<const batch_job> jobs, std::span<const size_t> indices, const batch_options& options, std::span<batch_result> results) -> void {
+	auto batch = Chip8Batch{indices.size()};
+
+	options.system.apply(batch);
+	for (size_t lane = 0; lane < indices.size(); ++lane) {
+		const auto& job = jobs[indices[lane]];
+		results[indices[lane]].job = job;
+
+		if (job.seed) {
+			batch.set_rng_seed(lane, *job.seed);
+		}
+	}
+
+	if (!batch.load_rom(jobs[indices.front()].rom)) {
+		return;
+	}
+
+	// A frame is (clock rate / 60) instructions. Each lane runs to the same instruction count as HeadlessRunner.
+	const uint64_t rate   = options.system.instructions_per_frame ? (uint64_t{*options.system.instructions_per_frame} * 60) : options.system.clock_rate;
+	const uint64_t target = options.frames ? ((options.count * rate) / 60) : options.count;
+
+	const auto start = std::chrono::steady_clock::now();
+	batch.run_until(target);
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+
+	for (size_t lane = 0; lane < indices.size(); ++lane) {
+		auto& result = results[indices[lane]];
+
+		result.loaded           = true;
+		result.run.instructions = batch.get_cycle_count(lane);
+		result.run.elapsed      = elapsed;
+		result.run.halted       = batch.is_paused(lane);
+		result.halt_reason      = batch.get_halt_reason(lane);
+		result.display_hash     = hash_display(batch, lane);
+
+		if (options.frames) {
+			result.run.frames = (result.run.halted and rate != 0) ? ((result.run.instructions * 60) / rate) : options.count;
+		}
+	}
+}
+
+
+auto run_batch(std::span<const batch_job> jobs, const batch_options& options) -> std::vector<batch_result> {
+	std::vector<batch_result> results(jobs.size());
+
+	// Each task writes only to its own results, so the results need no synchronization
+	auto pool = ThreadPool{options.threads};
+
+	if (options.lockstep) {
+		// Group the jobs by ROM
+		std::map<std::filesystem::path, std::vector<size_t>> groups;
+		for (size_t idx = 0; idx < jobs.size(); ++idx) {
+			groups[jobs[idx].rom].push_back(idx);
+		}
+
+		for (const auto& [rom, indices] : groups) {
+			pool.submit([jobs, &indices, &options, &results] {
+				run_lockstep(jobs, indices, options, results);
+			});
+		}
+
+		pool.wait();
+		return results;
+	}
+
+	for (size_t idx = 0; idx < jobs.size(); ++idx) {
+		pool.submit([&job = jobs[idx], &result = results[idx], &options] {
+			run_job(job, options, result);
+		});
+	}
+
+	pool.wait();
+
+	return results;
+}
+
+
+auto hash_display(const chip8::display_t& display) noexcept -> uint64_t {
+	uint64_t hash = 0xCBF29CE484222325;
+
+	for (size_t y = 0; y < display.size_y(); ++y) {
+		for (size_t x = 0; x < display.size_x(); ++x) {
+			hash ^= display.get_pixel(x, y) ? 1 : 0;
+			hash *= 0x100000001B3;
+		}
+	}
+
+	return hash;
+}
+
+
+auto hash_display(const Chip8Batch& batch, size_t lane) noexcept -> uint64_t {
+	uint64_t hash = 0xCBF29CE484222325;
+
+	for (size_t y = 0; y < Chip8Batch::display_height; ++y) {
+		for (size_t x = 0; x < Chip8Batch::display_width; ++x) {
+			hash ^= batch.get_pixel(lane, x, y) ? 1 : 0;
+			hash *= 0x100000001B3;
+		}
+	}
+
+	return hash;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "headless_runner.h"
+
+
+/**
+ * @struct batch_job
+ * @brief  A ROM to run as part of a batch
+ */
+struct batch_job {
+    std::filesystem::path rom;
+
+    // The seed of the random number generator. Overrides headless_options::rng_seed when set.
+    std::optional<uint32_t> seed;
+};
+
+
+/**
+ * @struct batch_result
+ * @brief  The outcome of a @ref batch_job
+ */
+struct batch_result {
+    batch_job job;
+
+    // False if the ROM couldn't be loaded. The other fields are empty in that case.
+    bool loaded = false;
+
+    // The instructions executed, frames completed, and time taken
+    headless_result run;
+
+    // The reason the system paused itself, if it halted before the run completed
+    HaltReason halt_reason = HaltReason::none;
+
+    // A hash of the final display contents (see hash_display)
+    uint64_t display_hash = 0;
+};
+
+
+/**
+ * @struct batch_options
+ * @brief  The configuration of a batch run
+ */
+struct batch_options {
+    // The configuration applied to every instance
+    headless_options system;
+
+    // The number of instructions, or frames if @ref frames is true, to run each job for
+    uint64_t count = 1'000'000;
+    bool frames = false;
+
+    // The number of worker threads. 0 selects the number of hardware threads.
+    size_t threads = 0;
+
+    // Run the jobs that share a ROM in lock-step on one Chip8Batch, instead of on a chip8 each
+    bool lockstep = false;
+};
+
+
+/**
+ * @brief Run every job on an independent chip8 instance, in parallel
+ *
+ * @details The jobs are executed on a work-stealing thread pool. Each job
+ *          gets its own instance, so the jobs don't share any mutable state.
+ *          In lock-step mode, each task is a Chip8Batch with one lane for
+ *          every job that runs the same ROM.
+ *
+ * @param[in] jobs     The ROMs to run
+ * @param[in] options  The configuration of the run
+ *
+ * @return The result of each job, in the same order as the jobs
+ */
+[[nodiscard]]
+auto run_batch(std::span<const batch_job> jobs, const batch_options& options) -> std::vector<batch_result>;
+
+/**
+ * @brief Hash the contents of a display
+ *
+ * @details Only whether each pixel is lit contributes to the hash, so it
+ *          doesn't depend on the display colors.
+ *
+ * @param[in] display  The display to hash
+ *
+ * @return A 64-bit FNV-1a hash of the display
+ */
+[[nodiscard]]
+auto hash_display(const chip8::display_t& display) noexcept -> uint64_t;
+
+/**
+ * @brief Hash the display of a lane of a Chip8Batch
+ *
+ * @details The hash is equal to the hash of a chip8 display with the same
+ *          pixels lit.
+ *
+ * @param[in] batch  The batch to hash the display of
+ * @param[in] lane   The lane to hash the display of
+ *
+ * @return A 64-bit FNV-1a hash of the display
+ */
+[[nodiscard]]
+auto hash_display(const Chip8Batch& batch, size_t lane) noexcept -> uint64_t;
@@ -0,0 +1,224 @@
+#include "headless_runner.h"
+
+#include <utility>
+
+#include "chip8/save_state/save_state.h"
+
+
+auto headless_options::apply(chip8& chip) const -> void {
+	// Selecting the platform resets the system, so it's applied first
+	chip.set_platform(platform);
+	chip.set_clock_rate(clock_rate);
+
+	if (instructions_per_frame) {
+		chip.set_clock_mode(ClockMode::instructions_per_frame);
+		chip.set_instructions_per_frame(*instructions_per_frame);
+	}
+	else {
+		chip.set_clock_mode(ClockMode::hz);
+	}
+
+	if (rng_seed) {
+		chip.set_rng_seed(*rng_seed);
+	}
+
+	chip.set_jit_enabled(jit);
+	chip.set_fusion_enabled(fusion);
+	chip.set_idle_skip_enabled(idle_skip);
+	chip.set_aot_enabled(aot);
+	chip.set_quirk_profile(quirks);
+	chip.set_rom_database(rom_database);
+}
+
+
+auto headless_options::apply(Chip8Batch& batch) const -> void {
+	batch.set_clock_rate(clock_rate);
+
+	if (instructions_per_frame) {
+		batch.set_clock_mode(ClockMode::instructions_per_frame);
+		batch.set_instructions_per_frame(*instructions_per_frame);
+	}
+	else {
+		batch.set_clock_mode(ClockMode::hz);
+	}
+
+	if (rng_seed) {
+		for (size_t lane = 0; lane < batch.get_lane_count(); ++lane) {
+			batch.set_rng_seed(lane, *rng_seed);
+		}
+	}
+
+	batch.set_quirk_profile(quirks);
+	batch.set_rom_database(rom_database);
+}
+
+
+HeadlessRunner::HeadlessRunner() {
+	chip.set_timer_mode(TimerMode::virtual_time);
+}
+
+
+auto HeadlessRunner::load_rom(const std::filesystem::path& file) -> bool {
+	if (!chip.load_rom(file)) {
+		return false;
+	}
+
+	scheduled_instructions = 0;
+	frame_remainder = 0;
+	restart_history();
+	return true;
+}
+
+
+auto HeadlessRunner::save_state(const std::filesystem::path& file) const -> bool {
+	return SaveState{chip}.write(file);
+}
+
+
+auto HeadlessRunner::load_state(const std::filesystem::path& file) -> bool {
+	if (!SaveState::load(file, chip)) {
+		return false;
+	}
+
+	scheduled_instructions = chip.get_cycle_count();
+	frame_remainder = 0;
+	restart_history();
+	return true;
+}
+
+
+auto HeadlessRunner::set_rewind_enabled(bool enabled, size_t memory_budget) -> void {
+	if (!enabled) {
+		rewind_buffer.reset();
+		return;
+	}
+
+	rewind_buffer = std::make_unique<RewindBuffer>(memory_budget);
+	rewind_buffer->capture(chip);
+}
+
+
+auto HeadlessRunner::rewind(uint64_t frames) -> uint64_t {
+	if (!rewind_buffer) {
+		return 0;
+	}
+
+	const uint64_t rewound = rewind_buffer->rewind(chip, static_cast<size_t>(frames));
+
+	scheduled_instructions = chip.get_cycle_count();
+	frame_remainder = 0;
+	return rewound;
+}
+
+
+auto HeadlessRunner::play_movie(const std::filesystem::path& file) -> bool {
+	auto movie = Movie::load(file);
+	if (!movie) {
+		return false;
+	}
+
+	// Loading the ROM again resets it, so copy the path first
+	const auto rom = chip.get_current_rom();
+
+	auto player = MoviePlayer{std::move(*movie)};
+	if (!player.start(chip, rom)) {
+		return false;
+	}
+
+	movie_player = std::move(player);
+	scheduled_instructions = 0;
+	frame_remainder = 0;
+	restart_history();
+	return true;
+}
+
+
+auto HeadlessRunner::run_instructions(uint64_t count) -> headless_result {
+	const auto start_time  = std::chrono::steady_clock::now();
+	const auto start_count = chip.get_cycle_count();
+	const auto start_idle  = chip.get_idle_instructions();
+
+	scheduled_instructions += count;
+
+	headless_result result;
+	result.halted            = !run_until(scheduled_instructions);
+	result.instructions      = chip.get_cycle_count() - start_count;
+	result.idle_instructions = chip.get_idle_instructions() - start_idle;
+	result.elapsed           = std::chrono::steady_clock::now() - start_time;
+
+	return result;
+}
+
+
+auto HeadlessRunner::run_frames(uint64_t count) -> headless_result {
+	const auto start_time  = std::chrono::steady_clock::now();
+	const auto start_count = chip.get_cycle_count();
+	const auto start_idle  = chip.get_idle_instructions();
+
+	headless_result result;
+
+	for (; result.frames < count; ++result.frames) {
+		scheduled_instructions += next_frame_instructions();
+
+		const bool completed = run_until(scheduled_instructions);
+		if (rewind_buffer) {
+			rewind_buffer->capture(chip);
+		}
+
+		if (!completed) {
+			result.halted = true;
+			break;
+		}
+	}
+
+	result.instructions      = chip.get_cycle_count() - start_count;
+	result.idle_instructions = chip.get_idle_instructions() - start_idle;
+	result.elapsed           = std::chrono::steady_clock::now() - start_time;
+
+	return result;
+}
+
+
+auto HeadlessRunner::restart_history() -> void {
+	if (rewind_buffer) {
+		rewind_buffer->clear();
+		rewind_buffer->capture(chip);
+	}
+}
+
+
+auto HeadlessRunner::run_until(uint64_t target) -> bool {
+	// The player also stops at each event, and applies it
+	if (movie_player) {
+		if (!movie_player->run_until(chip, target)) {
+			scheduled_instructions = chip.get_cycle_count();
+			return false;
+		}
+		return true;
+	}
+
+	while (chip.get_cycle_count() < target) {
+		if (chip.is_paused()) {
+			// Don't owe the remaining instructions to the next run
+			scheduled_instructions = chip.get_cycle_count();
+			return false;
+		}
+		chip.run_cycle();
+	}
+	return !chip.is_paused();
+}
+
+
+auto HeadlessRunner::next_frame_instructions() noexcept -> uint64_t {
+	if (chip.get_clock_mode() == ClockMode::instructions_per_frame) {
+		return chip.get_instructions_per_frame();
+	}
+
+	// Distribute clock_rate instructions over 60 frames without losing the remainder
+	frame_remainder += chip.get_clock_rate();
+
+	const uint64_t instructions = frame_remainder / 60;
+	frame_remainder %= 60;
+
+	return instructions;
+}
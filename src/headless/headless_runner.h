@@ -0,0 +1,234 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+#include "chip8/chip8.h"
+#include "chip8/batch/chip8_batch.h"
+#include "chip8/movie/movie.h"
+#include "chip8/rewind/rewind_buffer.h"
+#include "chip8/rom_database/rom_database.h"
+
+
+/**
+ * @struct headless_options
+ * @brief  The configuration of a chip8 that is run headless
+ */
+struct headless_options {
+    // The clock rate in Hz
+    uint32_t clock_rate = 500;
+
+    // Run a fixed number of instructions per frame instead of using the clock rate
+    std::optional<uint32_t> instructions_per_frame;
+
+    // The seed of the random number generator. Random if not set.
+    std::optional<uint32_t> rng_seed;
+
+    bool jit       = false;
+    bool fusion    = true;
+    bool aot       = true;
+    bool idle_skip = true;
+
+    // The interpreter whose quirks the instructions follow
+    QuirkProfile quirks = QuirkProfile::xo_chip;
+
+    // The settings of known ROMs, which replace the options above for the ROMs in it. Not used if null.
+    std::shared_ptr<const RomDatabase> rom_database;
+
+    // The emulated CHIP-8 variant
+    Platform platform = Platform::chip8;
+
+    /// Apply the options to a chip8. Must be called before the ROM is loaded.
+    auto apply(chip8& chip) const -> void;
+
+    /// Apply the options to every lane of a Chip8Batch. The JIT, fusion, AOT, idle skip, and platform options don't apply to a batch.
+    auto apply(Chip8Batch& batch) const -> void;
+};
+
+
+/**
+ * @struct headless_result
+ * @brief  Describes a run of a @ref HeadlessRunner
+ */
+struct headless_result {
+    // The number of instructions executed during the run
+    uint64_t instructions = 0;
+
+    // The number of 60Hz frames completed during the run
+    uint64_t frames = 0;
+
+    // The number of the executed instructions that were skipped in idle loops (see chip8::set_idle_skip_enabled)
+    uint64_t idle_instructions = 0;
+
+    // The host time taken by the run
+    std::chrono::duration<double> elapsed{0};
+
+    // True if the system paused before the run completed (e.g. the PC left the ROM,
+    // an invalid instruction was executed, or the ROM waited for a key press)
+    bool halted = false;
+
+    /// Get the number of instructions executed per second of host time
+    [[nodiscard]]
+    auto instructions_per_second() const noexcept -> double {
+        return (elapsed.count() > 0.0) ? (instructions / elapsed.count()) : 0.0;
+    }
+
+    /// Get the fraction of the executed instructions that were skipped in idle loops
+    [[nodiscard]]
+    auto idle_fraction() const noexcept -> double {
+        return (instructions > 0) ? (static_cast<double>(idle_instructions) / instructions) : 0.0;
+    }
+};
+
+
+/**
+ * @class HeadlessRunner
+ *
+ * @brief Runs a chip8 without any window, renderer, or audio
+ *
+ * @details The timers are driven by the executed instructions (see
+ *          TimerMode::virtual_time), so runs are reproducible and execute as
+ *          fast as the host allows. A frame is 1/60th of an emulated second:
+ *          (clock rate / 60) instructions in ClockMode::hz, or the configured
+ *          instructions per frame in ClockMode::instructions_per_frame.
+ */
+class HeadlessRunner {
+public:
+
+    HeadlessRunner();
+
+    /**
+     * @copydoc chip8::load_rom(const std::filesystem::path&)
+     */
+    [[nodiscard]]
+    auto load_rom(const std::filesystem::path& file) -> bool;
+
+    /**
+     * @brief Write the state of the system to a save state file
+     *
+     * @param[in] file  The path of the file
+     *
+     * @return True if the file was written, otherwise false.
+     */
+    [[nodiscard]]
+    auto save_state(const std::filesystem::path& file) const -> bool;
+
+    /**
+     * @brief Load a save state file (see SaveState::load)
+     *
+     * @details The next run continues from the restored instruction count.
+     *
+     * @param[in] file  The path of the file
+     *
+     * @return True if the save state was loaded, otherwise false.
+     */
+    [[nodiscard]]
+    auto load_state(const std::filesystem::path& file) -> bool;
+
+    /**
+     * @brief Record the state after every frame, so the run can be rewound
+     *
+     * @details The current state is captured as the first frame of the history.
+     *          Disabling the history discards it.
+     *
+     * @param[in] enabled        True to record the history
+     * @param[in] memory_budget  The number of bytes the history may use (see RewindBuffer)
+     */
+    auto set_rewind_enabled(bool enabled, size_t memory_budget = RewindBuffer::default_memory_budget) -> void;
+
+    /**
+     * @brief Restore the state of an earlier frame (see RewindBuffer::rewind)
+     *
+     * @details Only frames executed by run_frames while the history is
+     *          enabled are recorded. The next run continues from the restored
+     *          instruction count.
+     *
+     * @param[in] frames  The number of frames to go back
+     *
+     * @return The number of frames that were rewound
+     */
+    auto rewind(uint64_t frames) -> uint64_t;
+
+    /**
+     * @brief Replay the input of a movie file in the runs that follow (see MoviePlayer)
+     *
+     * @details The loaded ROM is loaded again with the settings the movie
+     *          was recorded with, and the runs start from its first
+     *          instruction. The runs stop exactly at the events and the end
+     *          of the movie, but otherwise execute as usual.
+     *
+     * @param[in] file  The path of the movie file
+     *
+     * @return True if the movie is ready to replay, otherwise false.
+     */
+    [[nodiscard]]
+    auto play_movie(const std::filesystem::path& file) -> bool;
+
+    /// Get the player of the movie being replayed, or null if there isn't one
+    [[nodiscard]]
+    auto get_movie_player() const noexcept -> const MoviePlayer* {
+        return movie_player ? &*movie_player : nullptr;
+    }
+
+    /**
+     * @brief Execute a number of instructions
+     *
+     * @details A compiled block may run past the requested count. The
+     *          difference is deducted from the next run.
+     *
+     * @param[in] count  The number of instructions to execute
+     *
+     * @return The result of the run
+     */
+    auto run_instructions(uint64_t count) -> headless_result;
+
+    /**
+     * @brief Execute a number of 60Hz frames
+     *
+     * @param[in] count  The number of frames to execute
+     *
+     * @return The result of the run
+     */
+    auto run_frames(uint64_t count) -> headless_result;
+
+    [[nodiscard]]
+    auto get_chip() noexcept -> chip8& {
+        return chip;
+    }
+
+    [[nodiscard]]
+    auto get_chip() const noexcept -> const chip8& {
+        return chip;
+    }
+
+private:
+
+    /// Run the chip until its instruction count reaches the target or it pauses. Returns false if it paused.
+    auto run_until(uint64_t target) -> bool;
+
+    /// Discard the recorded frames, and record the current state as the first one
+    auto restart_history() -> void;
+
+    /// Get the number of instructions in the next frame
+    [[nodiscard]]
+    auto next_frame_instructions() noexcept -> uint64_t;
+
+
+    // The emulated system
+    chip8 chip;
+
+    // The instruction count that the runs so far were scheduled to reach
+    uint64_t scheduled_instructions = 0;
+
+    // The fraction of an instruction carried between frames, in units of 1/60th of an instruction
+    uint64_t frame_remainder = 0;
+
+    // The state of each frame. Null when the history is disabled.
+    std::unique_ptr<RewindBuffer> rewind_buffer;
+
+    // The movie whose input is applied during the runs, if there is one
+    std::optional<MoviePlayer> movie_player;
+};
@@ -0,0 +1,20 @@
+#include "input_log.h"
+
+#include <algorithm>
+
+
+auto InputLog::record(uint64_t cycle, Keys key, bool pressed) -> void {
+	discard_from(cycle + 1);
+	events.push_back({cycle, key, pressed});
+}
+
+
+auto InputLog::discard_from(uint64_t cycle) noexcept -> void {
+	events.erase(events.begin() + static_cast<ptrdiff_t>(find(cycle)), events.end());
+}
+
+
+auto InputLog::find(uint64_t cycle) const noexcept -> size_t {
+	const auto it = std::ranges::lower_bound(events, cycle, {}, &input_event::cycle);
+	return static_cast<size_t>(it - events.begin());
+}
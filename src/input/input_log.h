@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "input/input.h"
+
+
+/**
+ * @struct input_event
+ * @brief  A change in the state of a key, stamped with the instruction count it was applied at
+ */
+struct input_event {
+    uint64_t cycle;
+    Keys     key;
+    bool     pressed;
+};
+
+
+/**
+ * @class InputLog
+ *
+ * @brief The key presses and releases applied to a chip8, in the order they were applied
+ *
+ * @details Each event is stamped with the instruction count of the system
+ *          when it was applied, which is all that's needed to apply it again
+ *          at the same point when the instructions are re-executed: with
+ *          virtual timers, the input is the only thing that isn't determined
+ *          by the state. An event stamped with the instruction count of a
+ *          state was applied after that state, so it's replayed before the
+ *          next instruction is executed.
+ *
+ *          The stamps only increase through the log. Recording an event stamped
+ *          before the last one discards the events after it, since the
+ *          system was rewound or reset.
+ */
+class InputLog {
+public:
+
+    /**
+     * @brief Append an event to the log
+     *
+     * @param[in] cycle    The instruction count of the system when the event was applied
+     * @param[in] key      The key that changed
+     * @param[in] pressed  True if the key was pressed, false if it was released
+     */
+    auto record(uint64_t cycle, Keys key, bool pressed) -> void;
+
+    /// Discard the events stamped at or after an instruction count
+    auto discard_from(uint64_t cycle) noexcept -> void;
+
+    /// Discard every event
+    auto clear() noexcept -> void {
+        events.clear();
+    }
+
+    /// Get the index of the first event stamped at or after an instruction count
+    [[nodiscard]]
+    auto find(uint64_t cycle) const noexcept -> size_t;
+
+    /// Get the events, oldest first
+    [[nodiscard]]
+    auto get_events() const noexcept -> std::span<const input_event> {
+        return events;
+    }
+
+private:
+
+    std::vector<input_event> events;
+};
@@ -133,7 +133,11 @@ auto to_instruction(std::string_view str) -> std::optional<instruction> {
         }
     }
     else if (parts[0] == "mov" and parts.size() == 3) {
-        if (parts[1][0] == 'i') {
+        if (parts[1][0] == 'i' and parts[2] == "long") {
+            // The address is the next 16-bit word of the program
+            return instruction(Opcodes::mov_i_nnnn, 0);
+        }
+        else if (parts[1][0] == 'i') {
             if (auto nnn = get_n(parts, 2)) {
                 return instruction(Opcodes::mov_i_nnn, *nnn);
             }
@@ -303,6 +307,62 @@ auto to_instruction(std::string_view str) -> std::optional<instruction> {
             return instruction(Opcodes::ld_v0_vx, *vx);
         }
     }
+    else if (parts[0] == "scd" and parts.size() == 2) {
+        if (auto n = get_n(parts, 1)) {
+            return instruction(Opcodes::scd_n, *n & 0xF);
+        }
+    }
+    else if (parts[0] == "scr" and parts.size() == 1) {
+        return instruction(Opcodes::scr, 0);
+    }
+    else if (parts[0] == "scl" and parts.size() == 1) {
+        return instruction(Opcodes::scl, 0);
+    }
+    else if (parts[0] == "exit" and parts.size() == 1) {
+        return instruction(Opcodes::exit, 0);
+    }
+    else if (parts[0] == "low" and parts.size() == 1) {
+        return instruction(Opcodes::low, 0);
+    }
+    else if (parts[0] == "high" and parts.size() == 1) {
+        return instruction(Opcodes::high, 0);
+    }
+    else if (parts[0] == "hfont" and parts.size() == 2) {
+        if (auto vx = get_vx(parts, 1)) {
+            return instruction(Opcodes::hfont_vx, *vx);
+        }
+    }
+    else if (parts[0] == "strf" and parts.size() == 2) {
+        if (auto vx = get_vx(parts, 1)) {
+            return instruction(Opcodes::strf_vx, *vx);
+        }
+    }
+    else if (parts[0] == "ldf" and parts.size() == 2) {
+        if (auto vx = get_vx(parts, 1)) {
+            return instruction(Opcodes::ldf_vx, *vx);
+        }
+    }
+    else if (parts[0] == "save" and parts.size() == 3) {
+        auto vx = get_vx(parts, 1);
+        auto vy = get_vy(parts, 2);
+
+        if (vx and vy) {
+            return instruction(Opcodes::save_vx_vy, *vx | *vy);
+        }
+    }
+    else if (parts[0] == "load" and parts.size() == 3) {
+        auto vx = get_vx(parts, 1);
+        auto vy = get_vy(parts, 2);
+
+        if (vx and vy) {
+            return instruction(Opcodes::load_vx_vy, *vx | *vy);
+        }
+    }
+    else if (parts[0] == "plane" and parts.size() == 2) {
+        if (auto n = get_n(parts, 1)) {
+            return instruction(Opcodes::plane_x, (*n & 0xF) << 8);
+        }
+    }
 
     return std::nullopt;
 }
@@ -358,7 +418,13 @@ auto decompile_program(std::span<const uint8_t> data) -> decompile_result {
         // If this is a valid instruction, then convert it to a string. Otherwise, output the raw
         // byte value as a string instead. The constants are written as 16-bit values as well since
         // instructions are aligned to 16-bit boundaries.
-        if (instr.opcode != Opcodes::invalid) {
+        if (instr.opcode == Opcodes::mov_i_nnnn and (i + 3) < data.size()) {
+            // The long load is followed by its address, which is written as a constant
+            result.program.push_back(to_string(instr));
+            result.program.push_back(std::format("0x{:04X}", (static_cast<uint16_t>(data[i + 2]) << 8) | data[i + 3]));
+            i += 2;
+        }
+        else if (instr.opcode != Opcodes::invalid) {
             result.program.push_back(to_string(instr));
         }
         else {
@@ -42,12 +42,13 @@ public:
     // The opcode without arguments
     Opcodes opcode = Opcodes::invalid;
 
-    // The arguments of the instruction
-    uint16_t nnn : 12 = 0;
-    uint8_t  nn       = 0;
-    uint8_t  n : 4    = 0;
-    uint8_t  x : 4    = 0;
-    uint8_t  y : 4    = 0;
+    // The arguments of the instruction. These are stored unpacked so the
+    // interpreter can read them without any masking or shifting.
+    uint16_t nnn = 0;
+    uint8_t  nn  = 0;
+    uint8_t  n   = 0;
+    uint8_t  x   = 0;
+    uint8_t  y   = 0;
 };
 
 
@@ -79,6 +80,11 @@ inline auto to_string(const instruction& instr) -> std::string {
     replace(op,  " nn", std::format(" 0x{:02X}", instr.nn));
     replace(op,   " n", std::format(" 0x{:01X}", instr.n));
 
+    // The plane mask of the plane instruction is stored in x
+    if (instr.opcode == Opcodes::plane_x) {
+        replace(op, " x", std::format(" {:X}", instr.x));
+    }
+
     // Remove the brackets in the shr/shl instruction
     if (instr.opcode == Opcodes::shl_vx or instr.opcode == Opcodes::shr_vx) {
         replace(op, "{", "");
@@ -39,6 +39,19 @@ auto to_string(Opcodes op) -> std::string {
         case Opcodes::bcd_vx:      return "bcd vx";
         case Opcodes::str_v0_vx:   return "str vx";
         case Opcodes::ld_v0_vx:    return "ld vx";
+        case Opcodes::scd_n:       return "scd n";
+        case Opcodes::scr:         return "scr";
+        case Opcodes::scl:         return "scl";
+        case Opcodes::exit:        return "exit";
+        case Opcodes::low:         return "low";
+        case Opcodes::high:        return "high";
+        case Opcodes::hfont_vx:    return "hfont vx";
+        case Opcodes::strf_vx:     return "strf vx";
+        case Opcodes::ldf_vx:      return "ldf vx";
+        case Opcodes::save_vx_vy:  return "save vx vy";
+        case Opcodes::load_vx_vy:  return "load vx vy";
+        case Opcodes::mov_i_nnnn:  return "mov i long";
+        case Opcodes::plane_x:     return "plane x";
         case Opcodes::invalid:     return "invalid";
         default:                   return "invalid";
     }
@@ -101,6 +114,19 @@ auto to_opcode(std::string_view op) -> Opcodes {
         {"bcd vx",      Opcodes::bcd_vx},
         {"str vx",      Opcodes::str_v0_vx},
         {"ld vx",       Opcodes::ld_v0_vx},
+        {"scd n",       Opcodes::scd_n},
+        {"scr",         Opcodes::scr},
+        {"scl",         Opcodes::scl},
+        {"exit",        Opcodes::exit},
+        {"low",         Opcodes::low},
+        {"high",        Opcodes::high},
+        {"hfont vx",    Opcodes::hfont_vx},
+        {"strf vx",     Opcodes::strf_vx},
+        {"ldf vx",      Opcodes::ldf_vx},
+        {"save vx vy",  Opcodes::save_vx_vy},
+        {"load vx vy",  Opcodes::load_vx_vy},
+        {"mov i long",  Opcodes::mov_i_nnnn},
+        {"plane x",     Opcodes::plane_x},
     };
 
     if (const auto it = opcode_map.find(op); it != opcode_map.end()) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <string_view>
@@ -7,20 +8,28 @@
 /**
  * @enum Opcodes
  * 
- * @brief The set of opcodes in the CHIP-8 instruction set
+ * @brief The set of opcodes in the CHIP-8, SUPER-CHIP, and XO-CHIP instruction sets
  * 
  * @details The value of each element is that of the associated opcode, minus
  *          any arguments.
  */
 enum class Opcodes : uint16_t {
     sys_nnn     = 0x0000,
+    scd_n       = 0x00C0, //SUPER-CHIP
     cls         = 0x00E0,
     ret         = 0x00EE,
+    scr         = 0x00FB, //SUPER-CHIP
+    scl         = 0x00FC, //SUPER-CHIP
+    exit        = 0x00FD, //SUPER-CHIP
+    low         = 0x00FE, //SUPER-CHIP
+    high        = 0x00FF, //SUPER-CHIP
     jmp_nnn     = 0x1000,
     call_nnn    = 0x2000,
     se_vx_nn    = 0x3000,
     sne_vx_nn   = 0x4000,
     se_vx_vy    = 0x5000,
+    save_vx_vy  = 0x5002, //XO-CHIP
+    load_vx_vy  = 0x5003, //XO-CHIP
     mov_vx_nn   = 0x6000,
     add_vx_nn   = 0x7000,
     mov_vx_vy   = 0x8000,
@@ -39,19 +48,121 @@ enum class Opcodes : uint16_t {
     drw_vx_vy_n = 0xD000,
     skp_vx      = 0xE09E,
     sknp_vx     = 0xE0A1,
+    mov_i_nnnn  = 0xF000, //XO-CHIP
+    plane_x     = 0xF001, //XO-CHIP
     gdly_vx     = 0xF007,
     key_vx      = 0xF00A,
     sdly_vx     = 0xF015,
     ssnd_vx     = 0xF018,
     add_i_vx    = 0xF01E,
     font_vx     = 0xF029,
+    hfont_vx    = 0xF030, //SUPER-CHIP
     bcd_vx      = 0xF033,
     str_v0_vx   = 0xF055,
     ld_v0_vx    = 0xF065,
+    strf_vx     = 0xF075, //SUPER-CHIP
+    ldf_vx      = 0xF085, //SUPER-CHIP
     invalid     = 0xFFFF,
 };
 
 
+/// The number of values in @ref Opcodes, including Opcodes::invalid
+inline constexpr size_t opcode_count = 49;
+
+
+/**
+ * @brief Convert an @ref Opcode to a dense index
+ * 
+ * @details The opcode values are sparse, so this maps each one to a unique
+ *          index in the range [0, opcode_count) for use with lookup tables.
+ *          Any unrecognized value maps to the index of Opcodes::invalid.
+ * 
+ * @param[in] op  The opcode value
+ * 
+ * @return The dense index of the opcode
+ */
+[[nodiscard]]
+constexpr auto to_index(Opcodes op) noexcept -> size_t {
+    switch (op) {
+        case Opcodes::sys_nnn:     return 0;
+        case Opcodes::cls:         return 1;
+        case Opcodes::ret:         return 2;
+        case Opcodes::jmp_nnn:     return 3;
+        case Opcodes::call_nnn:    return 4;
+        case Opcodes::se_vx_nn:    return 5;
+        case Opcodes::sne_vx_nn:   return 6;
+        case Opcodes::se_vx_vy:    return 7;
+        case Opcodes::mov_vx_nn:   return 8;
+        case Opcodes::add_vx_nn:   return 9;
+        case Opcodes::mov_vx_vy:   return 10;
+        case Opcodes::or_vx_vy:    return 11;
+        case Opcodes::and_vx_vy:   return 12;
+        case Opcodes::xor_vx_vy:   return 13;
+        case Opcodes::add_vx_vy:   return 14;
+        case Opcodes::sub_vx_vy:   return 15;
+        case Opcodes::shr_vx:      return 16;
+        case Opcodes::subn_vx_vy:  return 17;
+        case Opcodes::shl_vx:      return 18;
+        case Opcodes::sne_vx_vy:   return 19;
+        case Opcodes::mov_i_nnn:   return 20;
+        case Opcodes::jmp_v0_nnn:  return 21;
+        case Opcodes::rnd_vx_nn:   return 22;
+        case Opcodes::drw_vx_vy_n: return 23;
+        case Opcodes::skp_vx:      return 24;
+        case Opcodes::sknp_vx:     return 25;
+        case Opcodes::gdly_vx:     return 26;
+        case Opcodes::key_vx:      return 27;
+        case Opcodes::sdly_vx:     return 28;
+        case Opcodes::ssnd_vx:     return 29;
+        case Opcodes::add_i_vx:    return 30;
+        case Opcodes::font_vx:     return 31;
+        case Opcodes::bcd_vx:      return 32;
+        case Opcodes::str_v0_vx:   return 33;
+        case Opcodes::ld_v0_vx:    return 34;
+        case Opcodes::scd_n:       return 35;
+        case Opcodes::scr:         return 36;
+        case Opcodes::scl:         return 37;
+        case Opcodes::exit:        return 38;
+        case Opcodes::low:         return 39;
+        case Opcodes::high:        return 40;
+        case Opcodes::hfont_vx:    return 41;
+        case Opcodes::strf_vx:     return 42;
+        case Opcodes::ldf_vx:      return 43;
+        case Opcodes::save_vx_vy:  return 44;
+        case Opcodes::load_vx_vy:  return 45;
+        case Opcodes::mov_i_nnnn:  return 46;
+        case Opcodes::plane_x:     return 47;
+        default:                   return 48; //Opcodes::invalid
+    }
+}
+
+
+/**
+ * @brief Check if an @ref Opcode reads or writes the timers, or waits on them
+ * 
+ * @details The delay and sound timer instructions, and the draw that waits
+ *          for the display on some platforms. A compiled block only advances
+ *          the timers once it finishes, so these start a new block, where the
+ *          timers and the instruction count are up to date.
+ * 
+ * @param[in] op  The opcode value
+ * 
+ * @return True if the instruction depends on the timers
+ */
+[[nodiscard]]
+constexpr auto uses_timers(Opcodes op) noexcept -> bool {
+    switch (op) {
+        case Opcodes::gdly_vx:
+        case Opcodes::sdly_vx:
+        case Opcodes::ssnd_vx:
+        case Opcodes::drw_vx_vy_n:
+            return true;
+        default:
+            return false;
+    }
+}
+
+
 /**
  * @brief Convert an @ref Opcode to a string
  * 
@@ -92,12 +203,28 @@ constexpr auto to_opcode(uint16_t instruction) -> Opcodes {
                 switch (lsb) {
                     case 0x00E0:
                     case 0x00EE:
+                    case 0x00FB:
+                    case 0x00FC:
+                    case 0x00FD:
+                    case 0x00FE:
+                    case 0x00FF:
                         return static_cast<Opcodes>(msb + lsb);
                 }
+                if ((lsb & 0x00F0) == 0x00C0) {
+                    return Opcodes::scd_n;
+                }
             }
             return Opcodes::sys_nnn;
         }
 
+        case 0x5000: {
+            const uint16_t lsb = instruction & 0x000F;
+            if ((lsb == 0x0000) || (lsb == 0x0002) || (lsb == 0x0003)) {
+                return static_cast<Opcodes>(msb + lsb);
+            }
+            return Opcodes::invalid;
+        }
+
         case 0x8000: {
             const uint16_t lsb = instruction & 0x000F;
             if ((lsb <= 0x0007) || (lsb == 0x000E)) {
@@ -115,17 +242,26 @@ constexpr auto to_opcode(uint16_t instruction) -> Opcodes {
         }
 
         case 0xF000: {
+            // The long load is a 4 byte instruction, which is followed by the 16-bit address
+            if (instruction == 0xF000) {
+                return Opcodes::mov_i_nnnn;
+            }
+
             const uint16_t lsb = instruction & 0x00FF;
             switch (lsb) {
+                case 0x0001:
                 case 0x0007:
                 case 0x000A:
                 case 0x0015:
                 case 0x0018:
                 case 0x001E:
                 case 0x0029:
+                case 0x0030:
                 case 0x0033:
                 case 0x0055:
                 case 0x0065:
+                case 0x0075:
+                case 0x0085:
                     return static_cast<Opcodes>(msb + lsb); 
             }
             return Opcodes::invalid;
@@ -1,11 +1,13 @@
 #include "media_layer.h"
 #include "chip8/chip8.h"
+#include "chip8/jit/jit.h"
 #include "instruction/instruction.h"
 #include "util/strings.h"
 
 #include <array>
 #include <iostream>
 #include <span>
+#include <utility>
 
 #include "imgui/backends/imgui_impl_opengl3.h"
 #include "imgui/backends/imgui_impl_sdl.h"
@@ -30,6 +32,66 @@ static auto FloatArray2RGBA(std::span<const float, 4> array) -> uint32_t {
 }
 
 
+// The dimensions and size of the display texture, which has one byte per pixel. The texture
+// is always the high resolution size, and the low resolution is scaled up to fill it.
+static constexpr auto display_width  = static_cast<GLsizei>(chip8::display_t::max_size_x());
+static constexpr auto display_height = static_cast<GLsizei>(chip8::display_t::max_size_y());
+static constexpr auto display_bytes  = static_cast<GLsizeiptr>(chip8::display_t::max_size());
+
+
+// The display shaders. The vertex inputs match the locations used by the ImGui OpenGL3
+// backend's GLSL 410 shaders, so the program can draw ImGui's vertices.
+static constexpr const char* palette_vertex_shader =
+    "#version 410 core\n"
+    "layout (location = 0) in vec2 Position;\n"
+    "layout (location = 1) in vec2 UV;\n"
+    "uniform mat4 ProjMtx;\n"
+    "out vec2 Frag_UV;\n"
+    "void main() {\n"
+    "    Frag_UV = UV;\n"
+    "    gl_Position = ProjMtx * vec4(Position.xy, 0, 1);\n"
+    "}\n";
+
+static constexpr const char* palette_fragment_shader =
+    "#version 410 core\n"
+    "in vec2 Frag_UV;\n"
+    "uniform usampler2D Texture;\n"
+    "uniform vec4 Palette[4];\n"
+    "layout (location = 0) out vec4 Out_Color;\n"
+    "void main() {\n"
+    "    Out_Color = Palette[texture(Texture, Frag_UV).r & 3u];\n"
+    "}\n";
+
+
+static auto CompileShader(GLenum type, const char* source) -> GLuint {
+    const GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        std::array<char, 1024> log = {};
+        glGetShaderInfoLog(shader, static_cast<GLsizei>(log.size()), nullptr, log.data());
+        std::cout << "Error compiling the display shader: " << log.data() << '\n';
+    }
+
+    return shader;
+}
+
+
+// The chip8 whose memory is shown in the memory editor. MemoryEditor::WriteFn
+// doesn't take a user pointer, so this is set before the editor is drawn.
+static chip8* mem_editor_chip = nullptr;
+
+static auto MemoryEditorWrite(ImU8* data, size_t off, ImU8 value) -> void {
+    data[off] = value;
+    if (mem_editor_chip) {
+        mem_editor_chip->invalidate_code(off);
+    }
+}
+
+
 MediaLayer::MediaLayer() {
     //--------------------------------------------------------------------------------
     // SDL Init
@@ -97,29 +159,45 @@ MediaLayer::MediaLayer() {
     // Load OpenGL functions
     gladLoadGLLoader(SDL_GL_GetProcAddress);
 
-    // Create the CHIP-8 display texture
+    // Create the CHIP-8 display texture. Its storage is allocated once, and only its contents are updated.
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, display_width, display_height);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+    // Create the pixel buffers that stage the display texture uploads
+    glGenBuffers(static_cast<GLsizei>(pixel_buffers.size()), pixel_buffers.data());
+    for (const GLuint buffer : pixel_buffers) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, display_bytes, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    create_palette_program();
+
 
     //--------------------------------------------------------------------------------
     // ImGui Init
     //--------------------------------------------------------------------------------
     ImGui::CreateContext();
     ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
-    ImGui_ImplOpenGL3_Init("#version 330");
+    ImGui_ImplOpenGL3_Init("#version 410");
 
     // Enable ImGui docking features
     ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_DockingEnable;
     ImGui::GetIO().ConfigDockingWithShift = false;
 
 	ImGui::StyleColorsDark();
+
+    // Route memory editor writes through the chip so its decoded instructions are invalidated
+    mem_editor.WriteFn = MemoryEditorWrite;
 }
 
 
 MediaLayer::~MediaLayer() {
+    glDeleteProgram(palette_program);
+    glDeleteBuffers(static_cast<GLsizei>(pixel_buffers.size()), pixel_buffers.data());
     glDeleteTextures(1, &texture);
 
     ImGui_ImplOpenGL3_Shutdown();
@@ -139,7 +217,106 @@ void MediaLayer::set_display_scale(uint8_t scale) {
 }
 
 
-void MediaLayer::process_events(chip8& chip, bool& quit) {
+void MediaLayer::upload_display(const chip8& chip, const RunAhead& run_ahead) {
+    // The frames run ahead are executed again every host frame, so their display is always uploaded
+    const auto* const ahead = run_ahead.get_display();
+    const auto& display = ahead ? *ahead : chip.get_display();
+
+    const auto generation = chip.get_display().get_generation();
+    if (!ahead and (generation == uploaded_generation) and (chip.get_restore_count() == uploaded_restore_count)) {
+        ++skipped_uploads;
+        return;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffers[next_pixel_buffer]);
+    next_pixel_buffer = (next_pixel_buffer + 1) % pixel_buffers.size();
+
+    // Invalidating the buffer lets the driver hand out new memory if the GPU is still reading the old contents
+    void* const mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, display_bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+    if (mapped) {
+        display.to_indices(std::span<uint8_t, chip8::display_t::max_size()>{static_cast<uint8_t*>(mapped), chip8::display_t::max_size()});
+
+        // The texture is updated from the bound pixel buffer, so the copy happens asynchronously
+        if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexSubImage2D(
+                GL_TEXTURE_2D,
+                0,
+                0, 0,
+                display_width, display_height,
+                GL_RED_INTEGER,
+                GL_UNSIGNED_BYTE,
+                nullptr
+            );
+
+            // The texture doesn't hold the display of the chip8 after a frame ahead, so it's uploaded again when run-ahead stops
+            uploaded_generation = ahead ? std::numeric_limits<uint64_t>::max() : generation;
+            uploaded_restore_count = chip.get_restore_count();
+            ++display_uploads;
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+
+void MediaLayer::create_palette_program() {
+    const GLuint vertex_shader   = CompileShader(GL_VERTEX_SHADER, palette_vertex_shader);
+    const GLuint fragment_shader = CompileShader(GL_FRAGMENT_SHADER, palette_fragment_shader);
+
+    palette_program = glCreateProgram();
+    glAttachShader(palette_program, vertex_shader);
+    glAttachShader(palette_program, fragment_shader);
+    glLinkProgram(palette_program);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(palette_program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        std::array<char, 1024> log = {};
+        glGetProgramInfoLog(palette_program, static_cast<GLsizei>(log.size()), nullptr, log.data());
+        std::cout << "Error linking the display shader: " << log.data() << '\n';
+    }
+
+    glDetachShader(palette_program, vertex_shader);
+    glDetachShader(palette_program, fragment_shader);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    proj_mtx_location = glGetUniformLocation(palette_program, "ProjMtx");
+    palette_location  = glGetUniformLocation(palette_program, "Palette");
+
+    // The texture is always bound to unit 0 by the ImGui backend
+    glUseProgram(palette_program);
+    glUniform1i(glGetUniformLocation(palette_program, "Texture"), 0);
+    glUseProgram(0);
+}
+
+
+void MediaLayer::bind_palette_program(const ImDrawList*, const ImDrawCmd* cmd) {
+    const auto* const self = static_cast<const MediaLayer*>(cmd->UserCallbackData);
+    const ImDrawData* const draw_data = ImGui::GetDrawData();
+
+    // The same orthographic projection as the ImGui backend
+    const float left   = draw_data->DisplayPos.x;
+    const float right  = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
+    const float top    = draw_data->DisplayPos.y;
+    const float bottom = draw_data->DisplayPos.y + draw_data->DisplaySize.y;
+
+    const float ortho_projection[4][4] = {
+        { 2.0f / (right - left),           0.0f,                             0.0f, 0.0f },
+        { 0.0f,                            2.0f / (top - bottom),            0.0f, 0.0f },
+        { 0.0f,                            0.0f,                            -1.0f, 0.0f },
+        { (right + left) / (left - right), (top + bottom) / (bottom - top),  0.0f, 1.0f },
+    };
+
+    glUseProgram(self->palette_program);
+    glUniformMatrix4fv(self->proj_mtx_location, 1, GL_FALSE, &ortho_projection[0][0]);
+    glUniform4fv(self->palette_location, static_cast<GLsizei>(self->palette.size()), self->palette.front().data());
+}
+
+
+void MediaLayer::process_events(chip8& chip, InputLog& input, bool& quit) {
     SDL_Event event;
 
     while (SDL_PollEvent(&event)) {
@@ -152,17 +329,38 @@ void MediaLayer::process_events(chip8& chip, bool& quit) {
             break;
 
             case SDL_KEYDOWN: {
+                if (event.key.keysym.scancode == SDL_SCANCODE_F5) {
+                    save_state(chip, false);
+                    break;
+                }
+                if (event.key.keysym.scancode == SDL_SCANCODE_F9) {
+                    load_state(chip, false);
+                    break;
+                }
+                if (event.key.keysym.scancode == SDL_SCANCODE_BACKSPACE) {
+                    rewind_held = !ImGui::GetIO().WantCaptureKeyboard;
+                    break;
+                }
+
+                // The keys are driven by the movie while it's played
                 const auto it = key_map.find(event.key.keysym.scancode);
-                if (it != key_map.end()) {
-                    chip.input.set_key_state(it->second, true);
+                if ((it != key_map.end()) and !movie_player) {
+                    input.record(chip.get_cycle_count(), it->second, true);
+                    chip.set_key_state(it->second, true);
                 }
             }
             break;
 
             case SDL_KEYUP: {
+                if (event.key.keysym.scancode == SDL_SCANCODE_BACKSPACE) {
+                    rewind_held = false;
+                    break;
+                }
+
                 const auto it = key_map.find(event.key.keysym.scancode);
-                if (it != key_map.end()) {
-                    chip.input.set_key_state(it->second, false);
+                if ((it != key_map.end()) and !movie_player) {
+                    input.record(chip.get_cycle_count(), it->second, false);
+                    chip.set_key_state(it->second, false);
                 }
             }
             break;
@@ -172,7 +370,7 @@ void MediaLayer::process_events(chip8& chip, bool& quit) {
     }
 
     // Process sound output
-    if (chip.timer.is_sound()) {
+    if (chip.get_sound_timer() > 0) {
         beeper.start_beep();
     }
     else {
@@ -181,13 +379,162 @@ void MediaLayer::process_events(chip8& chip, bool& quit) {
 }
 
 
-void MediaLayer::render(chip8& chip) {
+void MediaLayer::render(chip8& chip, InputLog& input, ReverseDebugger& debugger, RunAhead& run_ahead) {
+    update_autosave(chip);
+    update_movie(chip);
+
     begin_frame();
-    render_ui(chip);
+    render_ui(chip, input, debugger, run_ahead);
     end_frame();
 }
 
 
+std::filesystem::path MediaLayer::get_state_file(const chip8& chip, bool autosave) {
+    const auto& rom = chip.get_current_rom();
+    if (rom.empty()) {
+        return {};
+    }
+
+    auto file = std::filesystem::path{"states"} / rom.stem();
+    file += autosave ? ".auto.state" : ".state";
+    return file;
+}
+
+
+void MediaLayer::save_state(const chip8& chip, bool autosave) {
+    auto file = get_state_file(chip, autosave);
+    if (!file.empty()) {
+        state_writer.submit(std::move(file), SaveState{chip});
+    }
+}
+
+
+void MediaLayer::load_state(chip8& chip, bool autosave) {
+    const auto file = get_state_file(chip, autosave);
+    if (file.empty()) {
+        return;
+    }
+
+    // A save of the same file may still be queued
+    state_writer.flush();
+    if (SaveState::load(file, chip)) {
+        cancel_movie("A save state was loaded");
+    }
+}
+
+
+void MediaLayer::update_autosave(const chip8& chip) {
+    if (!autosave_enabled) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if ((now - last_autosave) >= autosave_interval) {
+        last_autosave = now;
+        save_state(chip, true);
+    }
+}
+
+
+std::filesystem::path MediaLayer::get_movie_file(const chip8& chip) {
+    const auto& rom = chip.get_current_rom();
+    if (rom.empty()) {
+        return {};
+    }
+
+    auto file = std::filesystem::path{"movies"} / rom.stem();
+    file += ".c8m";
+    return file;
+}
+
+
+void MediaLayer::start_recording(chip8& chip, InputLog& input) {
+    if (chip.get_timer_mode() != TimerMode::virtual_time) {
+        std::cout << "Recording a movie requires virtual timers\n";
+        return;
+    }
+
+    // The movie starts from the ROM being loaded. Loading it again resets the path, so it's copied first.
+    const auto rom = chip.get_current_rom();
+    if (!chip.load_rom(rom)) {
+        return;
+    }
+
+    input.clear();
+    recording.emplace(chip);
+}
+
+
+void MediaLayer::stop_recording(const chip8& chip, const InputLog& input) {
+    recording->finish(chip, input);
+
+    const auto file = get_movie_file(chip);
+    if (recording->write(file)) {
+        std::cout << "Recorded " << recording->get_events().size() << " key events over "
+                  << chip.get_cycle_count() << " instructions to " << file << '\n';
+    }
+    recording.reset();
+}
+
+
+void MediaLayer::start_playback(chip8& chip, InputLog& input) {
+    auto movie = Movie::load(get_movie_file(chip));
+    if (!movie) {
+        return;
+    }
+
+    const auto rom = chip.get_current_rom();
+    auto player = MoviePlayer{std::move(*movie)};
+    if (!player.start(chip, rom)) {
+        return;
+    }
+
+    input.clear();
+    movie_player = std::move(player);
+}
+
+
+void MediaLayer::cancel_movie(std::string_view reason) {
+    if (recording or movie_player) {
+        std::cout << "Stopped the movie: " << reason << '\n';
+        recording.reset();
+        movie_player.reset();
+    }
+}
+
+
+void MediaLayer::update_movie(const chip8& chip) {
+    const Movie* movie = recording ? &*recording : (movie_player ? &movie_player->get_movie() : nullptr);
+    if (!movie) {
+        return;
+    }
+
+    const auto& header = movie->get_header();
+    const bool settings_match = (chip.get_rom_digest() == header.rom_digest)
+                                and (chip.get_platform() == header.platform)
+                                and (chip.get_quirk_profile() == header.quirk_profile)
+                                and (chip.get_clock_mode() == header.clock_mode)
+                                and (chip.get_clock_rate() == header.clock_rate)
+                                and (chip.get_instructions_per_frame() == header.instructions_per_frame)
+                                and (chip.get_timer_mode() == TimerMode::virtual_time);
+    if (!settings_match) {
+        cancel_movie("The ROM or its settings changed");
+        return;
+    }
+
+    // The system keeps running live after the end of the movie
+    if (movie_player and movie_player->is_finished()) {
+        if (*movie_player->get_result()) {
+            std::cout << "The movie replay matches the recording\n";
+        }
+        else {
+            std::cout << "The movie replay doesn't match the recording (" << movie_player->get_late_events() << " late key events)\n";
+        }
+        movie_player.reset();
+    }
+}
+
+
 void MediaLayer::begin_frame() {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplSDL2_NewFrame(window);
@@ -209,20 +556,10 @@ void MediaLayer::end_frame() {
 }
 
 
-void MediaLayer::render_ui(chip8& chip) {
+void MediaLayer::render_ui(chip8& chip, InputLog& input, ReverseDebugger& debugger, RunAhead& run_ahead) {
 
     // Update the CHIP-8 display texture
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RGBA,
-        64, 32,
-        false,
-        GL_RGBA,
-        GL_UNSIGNED_INT_8_8_8_8,
-        chip.display.data()
-    );
+    upload_display(chip, run_ahead);
 
     // ImGui::ShowDemoWindow();
 
@@ -234,10 +571,143 @@ void MediaLayer::render_ui(chip8& chip) {
 			file_selector.open_selector();
 		}
 
+        if (ImGui::BeginMenu("State")) {
+            const bool has_rom = !chip.get_current_rom().empty();
+
+            if (ImGui::MenuItem("Save State", "F5", false, has_rom)) {
+                save_state(chip, false);
+            }
+            if (ImGui::MenuItem("Load State", "F9", false, has_rom)) {
+                load_state(chip, false);
+            }
+            if (ImGui::MenuItem("Load Autosave", nullptr, false, has_rom)) {
+                load_state(chip, true);
+            }
+
+            ImGui::Separator();
+
+            if (ImGui::Checkbox("Autosave", &autosave_enabled)) {
+                last_autosave = std::chrono::steady_clock::now();
+            }
+
+            int interval = static_cast<int>(autosave_interval.count());
+            if (ImGui::SliderInt("Interval (s)", &interval, 1, 60)) {
+                autosave_interval = std::chrono::seconds{interval};
+            }
+
+            ImGui::EndMenu();
+        }
+
+        // Movies record the key presses and releases from the moment the ROM is loaded, and replay them exactly
+        if (ImGui::BeginMenu("Movie")) {
+            const bool has_rom = !chip.get_current_rom().empty();
+            const bool idle    = !recording and !movie_player;
+
+            if (ImGui::MenuItem("Record", nullptr, false, has_rom and idle)) {
+                start_recording(chip, input);
+            }
+            if (ImGui::MenuItem("Stop Recording", nullptr, false, recording.has_value())) {
+                stop_recording(chip, input);
+            }
+
+            ImGui::Separator();
+
+            if (ImGui::MenuItem("Play", nullptr, false, has_rom and idle)) {
+                start_playback(chip, input);
+            }
+            if (ImGui::MenuItem("Stop Playback", nullptr, false, movie_player.has_value())) {
+                cancel_movie("Playback was stopped");
+            }
+
+            if (movie_player) {
+                ImGui::TextDisabled("Playing: %llu / %llu instructions",
+                    static_cast<unsigned long long>(chip.get_cycle_count()),
+                    static_cast<unsigned long long>(movie_player->get_movie().get_header().length));
+            }
+            else if (recording) {
+                ImGui::TextDisabled("Recording: %llu instructions", static_cast<unsigned long long>(chip.get_cycle_count()));
+            }
+
+            ImGui::EndMenu();
+        }
+
         if (ImGui::BeginMenu("Options")) {
-            bool legacy = chip.is_legacy_mode();
-            if (ImGui::Checkbox("Legacy Mode", &legacy)) {
-                chip.set_legacy_mode(legacy);
+            // Changing the platform resets the system, so the ROM is reloaded into the new memory
+            if (ImGui::BeginMenu("Platform")) {
+                for (const auto platform : {Platform::chip8, Platform::schip, Platform::xo_chip}) {
+                    if (ImGui::MenuItem(to_string(platform).data(), nullptr, chip.get_platform() == platform)) {
+                        const auto rom = chip.get_current_rom();
+                        chip.set_platform(platform);
+                        if (!rom.empty()) {
+                            (void)chip.load_rom(rom);
+                        }
+                    }
+                }
+                ImGui::EndMenu();
+            }
+
+            // The quirks of the interpreter the ROM was written for, including sprite wrapping
+            if (ImGui::BeginMenu("Quirks")) {
+                for (const auto profile : {QuirkProfile::cosmac_vip, QuirkProfile::schip, QuirkProfile::xo_chip}) {
+                    if (ImGui::MenuItem(to_string(profile).data(), nullptr, chip.get_quirk_profile() == profile)) {
+                        chip.set_quirk_profile(profile);
+                    }
+                }
+                ImGui::EndMenu();
+            }
+
+            bool virtual_timers = (chip.get_timer_mode() == TimerMode::virtual_time);
+            if (ImGui::Checkbox("Virtual Timers", &virtual_timers)) {
+                chip.set_timer_mode(virtual_timers ? TimerMode::virtual_time : TimerMode::real_time);
+            }
+
+            bool fusion = chip.is_fusion_enabled();
+            if (ImGui::Checkbox("Instruction Fusion", &fusion)) {
+                chip.set_fusion_enabled(fusion);
+            }
+
+            bool idle_skip = chip.is_idle_skip_enabled();
+            if (ImGui::Checkbox("Skip Idle Loops", &idle_skip)) {
+                chip.set_idle_skip_enabled(idle_skip);
+            }
+
+            if (JIT::is_supported()) {
+                bool jit = chip.is_jit_enabled();
+                if (ImGui::Checkbox("JIT Compiler", &jit)) {
+                    chip.set_jit_enabled(jit);
+                }
+            }
+
+            bool aot = chip.is_aot_enabled();
+            if (ImGui::Checkbox("Ahead-of-Time Programs", &aot)) {
+                chip.set_aot_enabled(aot);
+            }
+            if (chip.is_aot_active()) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("(active)");
+            }
+
+            // Present the display a few frames ahead, so the ROM appears to react to input sooner
+            if (ImGui::BeginMenu("Run-Ahead")) {
+                for (const auto mode : {RunAheadMode::off, RunAheadMode::single_instance, RunAheadMode::second_instance}) {
+                    if (ImGui::MenuItem(to_string(mode).data(), nullptr, run_ahead.get_mode() == mode)) {
+                        run_ahead.set_mode(mode);
+                    }
+                }
+
+                int frames = static_cast<int>(run_ahead.get_frames());
+                if (ImGui::SliderInt("Frames", &frames, 1, 4)) {
+                    run_ahead.set_frames(static_cast<uint32_t>(frames));
+                }
+
+                if (chip.get_timer_mode() != TimerMode::virtual_time) {
+                    ImGui::TextDisabled("Requires virtual timers");
+                }
+                else if (run_ahead.get_display()) {
+                    ImGui::TextDisabled("Sync: %.2f us", run_ahead.get_sync_time().count() * 1e6);
+                }
+
+                ImGui::EndMenu();
             }
 
             ImGui::EndMenu();
@@ -263,7 +733,7 @@ void MediaLayer::render_ui(chip8& chip) {
 
         // V Registers
 		for (uint8_t i = 0; i <= 0xF; ++i) {
-            auto value_str = std::format("0x{:02X}", chip.v[i]);
+            auto value_str = std::format("0x{:02X}", chip.state.v[i]);
             ImGui::PushID(i);
 
             ImGui::Text("v%X:", i);
@@ -271,7 +741,13 @@ void MediaLayer::render_ui(chip8& chip) {
 
             ImGui::SetNextItemWidth(ImGui::CalcTextSize(value_str.c_str()).x);
             if (ImGui::InputText("##reg_v", &value_str, ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_AutoSelectAll)) {
-                chip.v[i] = str_to<uint8_t>(value_str, 16).value_or(chip.v[i]);
+                chip.state.v[i] = str_to<uint8_t>(value_str, 16).value_or(chip.state.v[i]);
+            }
+            if (ImGui::BeginPopupContextItem("##reverse_v")) {
+                if (ImGui::MenuItem("Reverse Continue Until Changed")) {
+                    (void)debugger.reverse_continue(chip, {watch_location::kind::v_register, i});
+                }
+                ImGui::EndPopup();
             }
 
             ImGui::PopID();
@@ -279,24 +755,44 @@ void MediaLayer::render_ui(chip8& chip) {
 		ImGui::Separator();
 
         // I Register
-        auto reg_i_str = std::format("0x{:04X}", chip.i);
+        auto reg_i_str = std::format("0x{:04X}", chip.state.i);
         ImGui::Text(" I:");
         ImGui::SameLine();
         ImGui::SetNextItemWidth(ImGui::CalcTextSize(reg_i_str.c_str()).x);
         if (ImGui::InputText("##reg_i", &reg_i_str, ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_AutoSelectAll)) {
-            chip.i = str_to<uint16_t>(reg_i_str, 16).value_or(chip.i);
+            chip.state.i = str_to<uint16_t>(reg_i_str, 16).value_or(chip.state.i);
+        }
+        if (ImGui::BeginPopupContextItem("##reverse_i")) {
+            if (ImGui::MenuItem("Reverse Continue Until Changed")) {
+                (void)debugger.reverse_continue(chip, {watch_location::kind::index_register, 0});
+            }
+            ImGui::EndPopup();
         }
 
         // Program Counter
-        auto pc_str = std::format("0x{:04X}", chip.pc);
+        auto pc_str = std::format("0x{:04X}", chip.state.pc);
         ImGui::Text("PC:");
         ImGui::SameLine();
         ImGui::SetNextItemWidth(ImGui::CalcTextSize(pc_str.c_str()).x);
         if (ImGui::InputText("##pc", &pc_str, ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_AutoSelectAll)) {
-            chip.pc = str_to<uint16_t>(pc_str, 16).value_or(chip.pc);
+            chip.state.pc = str_to<uint16_t>(pc_str, 16).value_or(chip.state.pc);
         }
 
         ImGui::PopStyleVar();
+		ImGui::Separator();
+
+        // Move back to the last change to a byte of memory
+        auto watch_str = std::format("0x{:04X}", watch_address);
+        ImGui::Text("Mem:");
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(ImGui::CalcTextSize(watch_str.c_str()).x + ImGui::GetStyle().FramePadding.x * 2);
+        if (ImGui::InputText("##watch_address", &watch_str, ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_AutoSelectAll)) {
+            watch_address = str_to<uint16_t>(watch_str, 16).value_or(watch_address);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Reverse Until Changed")) {
+            (void)debugger.reverse_continue(chip, {watch_location::kind::memory, watch_address});
+        }
 	}
 	ImGui::End();
 
@@ -312,8 +808,8 @@ void MediaLayer::render_ui(chip8& chip) {
         ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2{0, 0});
 
         // Print the editable stack contents
-		for (ptrdiff_t i = chip.stack.size()-1; i >= 0; --i) {
-            auto value_str = std::format("0x{:04X}", chip.stack[i]);
+		for (ptrdiff_t i = chip.state.sp - 1; i >= 0; --i) {
+            auto value_str = std::format("0x{:04X}", chip.state.stack[i]);
 
             ImGui::PushID(static_cast<int>(i));
             ImGui::Text("%02d:", (int)i);
@@ -321,12 +817,18 @@ void MediaLayer::render_ui(chip8& chip) {
 
             ImGui::SetNextItemWidth(ImGui::CalcTextSize(value_str.c_str()).x);
             if (ImGui::InputText("##stack", &value_str, ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_AutoSelectAll)) {
-                chip.stack[i] = str_to<uint16_t>(value_str, 16).value_or(chip.stack[i]);
+                chip.state.stack[i] = str_to<uint16_t>(value_str, 16).value_or(chip.state.stack[i]);
             }
             ImGui::PopID();
 		}
 
         ImGui::PopStyleVar();
+		ImGui::Separator();
+
+        // Move back to the most recent call or return
+        if (ImGui::Button("Reverse to Call/Return")) {
+            (void)debugger.reverse_continue(chip, {watch_location::kind::stack_pointer, 0});
+        }
 	}
 	ImGui::End();
 
@@ -338,7 +840,7 @@ void MediaLayer::render_ui(chip8& chip) {
 		ImGui::Text("Execution");
 		ImGui::Separator();
 
-        bool update_strings = chip.pc != last_pc;
+        bool update_strings = chip.state.pc != last_pc;
 
         update_strings |= ImGui::InputInt("Preview Count", &instruction_count);
         instructions.resize(instruction_count);
@@ -346,17 +848,18 @@ void MediaLayer::render_ui(chip8& chip) {
 
         // Update instruction list if PC changed or the user changed the preview count
         if (update_strings) {
-            last_pc = chip.pc;
+            last_pc = chip.state.pc;
 
             for (size_t i = 0; i < instruction_count; ++i) {
-                const auto instr = instruction{chip.memory[chip.pc + (2 * i)], chip.memory[chip.pc + (2 * i) + 1]};
+                const size_t address = chip.state.pc + (2 * i);
+                const auto instr = instruction{chip.state.memory[address & chip.state.address_mask], chip.state.memory[(address + 1) & chip.state.address_mask]};
                 instructions[i] = to_string(instr);
             }
         }
 
         for (size_t i = 0; i < instruction_count; ++i) {
-			if (i == 0) ImGui::Text("0x%04X - %s", chip.pc, instructions[0].data());
-			else ImGui::TextDisabled("0x%04X - %s", static_cast<uint32_t>(chip.pc + (2*i)), instructions[i].data());
+			if (i == 0) ImGui::Text("0x%04X - %s", chip.state.pc, instructions[0].data());
+			else ImGui::TextDisabled("0x%04X - %s", static_cast<uint32_t>(chip.state.pc + (2*i)), instructions[i].data());
         }
 	}
 	ImGui::End();
@@ -371,16 +874,32 @@ void MediaLayer::render_ui(chip8& chip) {
 		ImGui::Spacing();
 
         // CHIP settings
-		uint32_t clock = chip.get_clock_rate();
-		ImGui::Text("Max Clock (Hz)");
-		if (ImGui::InputInt("##clock", (int*)&clock)) {
-			chip.set_clock_rate(clock);
+		int clock_mode = static_cast<int>(chip.get_clock_mode());
+		ImGui::Text("Clock Mode");
+		if (ImGui::Combo("##clock_mode", &clock_mode, "Hz\0Instructions per Frame\0")) {
+			chip.set_clock_mode(static_cast<ClockMode>(clock_mode));
+		}
+
+		if (chip.get_clock_mode() == ClockMode::hz) {
+			uint32_t clock = chip.get_clock_rate();
+			ImGui::Text("Clock (Hz)");
+			if (ImGui::InputInt("##clock", (int*)&clock) and (static_cast<int>(clock) > 0)) {
+				chip.set_clock_rate(clock);
+			}
+		}
+		else {
+			uint32_t count = chip.get_instructions_per_frame();
+			ImGui::Text("Instructions per Frame");
+			if (ImGui::InputInt("##instructions_per_frame", (int*)&count) and (static_cast<int>(count) > 0)) {
+				chip.set_instructions_per_frame(count);
+			}
 		}
 
 		ImGui::Spacing();
 
         // Reset and reload the ROM
 		if (ImGui::Button("Reset System")) {
+            cancel_movie("The system was reset");
             const auto rom = chip.current_rom;
 			chip.reset();
             if (std::filesystem::exists(rom)) {
@@ -395,7 +914,14 @@ void MediaLayer::render_ui(chip8& chip) {
             }
             ImGui::SameLine();
             if (ImGui::Button("Step")) {
-                chip.run_cycle();
+                chip.step();
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Step Back")) {
+                (void)debugger.step_back(chip);
+            }
+            if (ImGui::Button("Run Back to Breakpoint")) {
+                (void)debugger.run_back_to_breakpoint(chip);
             }
         }
         else {
@@ -408,30 +934,46 @@ void MediaLayer::render_ui(chip8& chip) {
 		ImGui::Separator();
 		ImGui::Spacing();
 
+        // Execution statistics
+        const uint64_t cycles = chip.get_cycle_count();
+        const uint64_t fused  = chip.get_fusion_report().total_instructions();
+        ImGui::Text("Instructions: %llu", static_cast<unsigned long long>(cycles));
+        ImGui::Text("Fused: %llu (%.1f%%)", static_cast<unsigned long long>(fused), (cycles > 0) ? (100.0 * fused / cycles) : 0.0);
+
+        const uint64_t idle = chip.get_idle_instructions();
+        ImGui::Text("Idle: %llu (%.1f%%)", static_cast<unsigned long long>(idle), (cycles > 0) ? (100.0 * idle / cycles) : 0.0);
+
+        if (ImGui::TreeNode("Fusion Report")) {
+            const auto& report = chip.get_fusion_report();
+            for (size_t i = 0; i < fused_op_count; ++i) {
+                const auto name = to_string(static_cast<FusedOp>(i));
+                ImGui::Text("%.*s: %llu", static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(report.instructions[i]));
+            }
+            ImGui::TreePop();
+        }
+
+		ImGui::Spacing();
+		ImGui::Separator();
+		ImGui::Spacing();
+
         // Display settings
         static const uint8_t scale_step = 1;
 		ImGui::InputScalar("Display Scale", ImGuiDataType_U8, &display_scale, &scale_step);
 			
-		const uint32_t off = chip.display.get_background_color();
-		const uint32_t on  = chip.display.get_foreground_color();
-
-		auto off_arr = std::array<float, 4>{};
-        auto on_arr  = std::array<float, 4>{};
+        // One color for each palette index. Plane 1 is only drawn by XO-CHIP programs.
+        static constexpr std::array<const char*, 4> color_names = {"Background Color", "Foreground Color", "Plane 2 Color", "Plane 1+2 Color"};
 
-        RGBA2FloatArray(off, off_arr);
-        RGBA2FloatArray(on, on_arr);
+        for (size_t idx = 0; idx < color_names.size(); ++idx) {
+            auto color_arr = std::array<float, 4>{};
+            RGBA2FloatArray(colors[idx], color_arr);
 
-		if (ImGui::ColorEdit3("Background Color", off_arr.data())) {
-            chip.display.set_background_color(FloatArray2RGBA(off_arr));
-		}
-		if (ImGui::ColorEdit3("Foreground Color", on_arr.data())) {
-            chip.display.set_foreground_color(FloatArray2RGBA(on_arr));
-		}
+            if (ImGui::ColorEdit3(color_names[idx], color_arr.data())) {
+                colors[idx] = FloatArray2RGBA(color_arr);
+            }
+        }
 
-		bool wrap = chip.display.get_wrapping();
-		if (ImGui::Checkbox("Wrapping", &wrap)) {
-			chip.display.set_wrapping(wrap);
-		}
+        // Frames that skipped the texture upload because the display didn't change
+        ImGui::Text("Display Uploads: %llu (%llu skipped)", static_cast<unsigned long long>(display_uploads), static_cast<unsigned long long>(skipped_uploads));
 	}
 	ImGui::End();
 
@@ -440,12 +982,20 @@ void MediaLayer::render_ui(chip8& chip) {
 	//----------------------------------------------------------------------------------
 	if (ImGui::Begin("Display", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
 
-		const auto x_size = static_cast<float>(chip.display.size_x() * display_scale);
-		const auto y_size = static_cast<float>(chip.display.size_y() * display_scale);
+		// The display scale is relative to the low resolution, so the window doesn't change size with the resolution
+		const auto x_size = static_cast<float>((chip8::display_t::max_size_x() / 2) * display_scale);
+		const auto y_size = static_cast<float>((chip8::display_t::max_size_y() / 2) * display_scale);
+
+        // Draw the display texture, colored by the palette program
+        for (size_t idx = 0; idx < palette.size(); ++idx) {
+            RGBA2FloatArray(colors[idx], palette[idx]);
+        }
 
-        // Draw the display texture
 		ImGui::BeginChild("Image", {x_size + 16.0f, y_size + 16.0f}, true);
+        ImDrawList* const draw_list = ImGui::GetWindowDrawList();
+        draw_list->AddCallback(bind_palette_program, this);
 		ImGui::Image((ImTextureID)(intptr_t)texture, ImVec2{x_size, y_size});
+        draw_list->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
 		ImGui::EndChild();
 	}
 	ImGui::End();
@@ -457,7 +1007,7 @@ void MediaLayer::render_ui(chip8& chip) {
 	if (file_selector.update()) {
 		if (chip.load_rom(file_selector.get_selected_file())) {
             // Decompile the ROM and update the text editor
-            const auto program_data = std::span{&chip.memory[chip.rom_start], chip.rom_end - chip.rom_start};
+            const auto program_data = std::span{&chip.state.memory[chip.rom_start], chip.rom_end - chip.rom_start};
             const auto result = decompile_program(program_data);
 
             for (auto idx : result.failures) {
@@ -519,5 +1069,7 @@ void MediaLayer::render_ui(chip8& chip) {
 	//----------------------------------------------------------------------------------
 	// Memory
 	//----------------------------------------------------------------------------------
-	mem_editor.DrawWindow("Memory", chip.memory.data(), chip.memory.size());
+	mem_editor_chip = &chip;
+	mem_editor.DrawWindow("Memory", chip.state.memory.data(), memory_size(chip.get_platform()));
+	mem_editor_chip = nullptr;
 }
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <filesystem>
 #include <unordered_map>
 #include <limits>
+#include <optional>
+#include <string_view>
 
 #include <SDL2/SDL.h>
 #include <glad/glad.h>
@@ -11,7 +16,13 @@
 #include "gui_widgets/file_selector.h"
 #include "gui_widgets/TextEditor.h"
 
+#include "chip8/chip8_state.h"
+#include "chip8/movie/movie.h"
+#include "chip8/reverse_debugger/reverse_debugger.h"
+#include "chip8/run_ahead/run_ahead.h"
+#include "chip8/save_state/save_state.h"
 #include "input/input.h"
+#include "input/input_log.h"
 #include "beeper/beeper.h"
 
 
@@ -25,17 +36,22 @@ public:
     /**
      * @brief Processes pending SDL events
      * 
-     * @param[in] chip  A reference to an instance of a chip8, for passing input state.
-     * @param[in] quit  A reference to a flag that indicates when to quit the main loop.
+     * @param[in] chip   A reference to an instance of a chip8, for passing input state.
+     * @param[in] input  The log the key presses and releases are recorded in. Keys aren't
+     *                   passed to the chip8 while a movie is played.
+     * @param[in] quit   A reference to a flag that indicates when to quit the main loop.
      */
-    auto process_events(chip8& chip, bool& quit) -> void;
+    auto process_events(chip8& chip, InputLog& input, bool& quit) -> void;
 
     /**
      * @brief Render the GUI
      * 
-     * @param[in] chip  A reference to an instance of a chip8 to render the GUI for
+     * @param[in] chip      A reference to an instance of a chip8 to render the GUI for
+     * @param[in] input     The log of the input applied to the chip8, which movies are recorded from
+     * @param[in] debugger  Moves the chip8 backward for the debugger windows
+     * @param[in] run_ahead The frames run ahead of the chip8. Its display is presented instead of the chip8's, if it has one.
      */
-    auto render(chip8& chip) -> void;
+    auto render(chip8& chip, InputLog& input, ReverseDebugger& debugger, RunAhead& run_ahead) -> void;
 
     /**
      * @brief Set the display scaling
@@ -46,11 +62,64 @@ public:
      */
     auto set_display_scale(uint8_t scale) -> void;
 
+    /// Check if the rewind key (backspace) is held
+    [[nodiscard]]
+    auto is_rewind_held() const noexcept -> bool {
+        return rewind_held;
+    }
+
+    /// Get the player of the movie being played, or null if no movie is playing
+    [[nodiscard]]
+    auto get_movie_player() noexcept -> MoviePlayer* {
+        return movie_player ? &*movie_player : nullptr;
+    }
+
 private:
 
     auto begin_frame() -> void;
     auto end_frame() -> void;
-    auto render_ui(chip8& chip) -> void;
+    auto render_ui(chip8& chip, InputLog& input, ReverseDebugger& debugger, RunAhead& run_ahead) -> void;
+
+    // Copy the CHIP-8 display, or the display run ahead of it, into its texture if it changed since the last upload
+    auto upload_display(const chip8& chip, const RunAhead& run_ahead) -> void;
+
+    // Get the path of the save state or autosave of the loaded ROM. Empty if no ROM is loaded.
+    [[nodiscard]]
+    static auto get_state_file(const chip8& chip, bool autosave) -> std::filesystem::path;
+
+    // Queue the state of the chip to be written to its save state or autosave file
+    auto save_state(const chip8& chip, bool autosave) -> void;
+
+    // Load the save state or autosave of the loaded ROM
+    auto load_state(chip8& chip, bool autosave) -> void;
+
+    // Queue an autosave if it's enabled and the interval has passed
+    auto update_autosave(const chip8& chip) -> void;
+
+    // Get the path of the movie of the loaded ROM. Empty if no ROM is loaded.
+    [[nodiscard]]
+    static auto get_movie_file(const chip8& chip) -> std::filesystem::path;
+
+    // Reload the ROM and start recording its input into a movie
+    auto start_recording(chip8& chip, InputLog& input) -> void;
+
+    // Write the recording to the movie file of the loaded ROM
+    auto stop_recording(const chip8& chip, const InputLog& input) -> void;
+
+    // Reload the ROM and replay the movie file of it
+    auto start_playback(chip8& chip, InputLog& input) -> void;
+
+    // Stop recording or playing a movie without saving it, and print the reason
+    auto cancel_movie(std::string_view reason) -> void;
+
+    // Cancel the movie if the ROM or the settings it runs with changed, and report the end of a playback
+    auto update_movie(const chip8& chip) -> void;
+
+    // Create the shader program that draws the display texture with the palette
+    auto create_palette_program() -> void;
+
+    // An ImGui draw callback that switches to the palette program. UserCallbackData is the MediaLayer.
+    static auto bind_palette_program(const ImDrawList* draw_list, const ImDrawCmd* cmd) -> void;
 
 
     // The SDL window
@@ -59,18 +128,57 @@ private:
     // The OpenGL context for the SDL window
     SDL_GLContext gl_context = {};
 
-    // The CHIP-8 display texture and its scale
+    // The CHIP-8 display texture and its scale. The texture holds the palette index of each pixel.
     GLuint texture = 0;
     uint32_t display_scale = 10;
 
+    // The shader program that converts the palette indices to colors when the display is drawn
+    GLuint palette_program = 0;
+    GLint proj_mtx_location = -1;
+    GLint palette_location = -1;
+
+    // The color of each palette index, and the same colors as RGBA floats for the palette program
+    std::array<uint32_t, 4> colors = chip8_state::display_t::default_palette;
+    std::array<std::array<float, 4>, 4> palette = {};
+
+    // The pixel buffers the display is written to before it's copied into the texture. The
+    // buffers are used in turn, so writing a frame never waits for the copy of the previous one.
+    static constexpr size_t pixel_buffer_count = 3;
+    std::array<GLuint, pixel_buffer_count> pixel_buffers = {};
+    size_t next_pixel_buffer = 0;
+
+    // The display generation and restore count in the texture, and the number of frames that did and didn't upload the display
+    uint64_t uploaded_generation = std::numeric_limits<uint64_t>::max();
+    uint64_t uploaded_restore_count = 0;
+    uint64_t display_uploads = 0;
+    uint64_t skipped_uploads = 0;
+
     // CHIP-8 audio output
     Beeper beeper;
 
+    // Writes save states off of the render thread
+    SaveStateWriter state_writer;
+
+    // True while the rewind key is held
+    bool rewind_held = false;
+
+    // Periodic autosave state
+    bool autosave_enabled = false;
+    std::chrono::seconds autosave_interval{10};
+    std::chrono::steady_clock::time_point last_autosave = std::chrono::steady_clock::now();
+
+    // The movie being recorded, and the movie being played. At most one is set.
+    std::optional<Movie> recording;
+    std::optional<MoviePlayer> movie_player;
+
     // GUI widgets
     FileSelector file_selector;
     MemoryEditor mem_editor;
     TextEditor text_editor;
 
+    // The memory address the registers window reverse-continues until a change to
+    uint16_t watch_address = 0x200;
+
     // Instruction Window state
     int instruction_count = 10;
     std::vector<std::string> instructions;
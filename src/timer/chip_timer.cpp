@@ -2,7 +2,8 @@
 
 
 Chip8Timer::Chip8Timer() {
-    reset();
+	stopwatch.reset();
+	elapsed_time = std::chrono::duration<double>{0.0};
 }
 
 auto Chip8Timer::pause() noexcept -> void {
@@ -13,45 +14,53 @@ auto Chip8Timer::resume() noexcept -> void {
 	stopwatch.resume();
 }
 
-auto Chip8Timer::reset() noexcept -> void {
+auto Chip8Timer::reset(timer_state& state) noexcept -> void {
 	stopwatch.reset();
-	elapsed_time = std::chrono::duration<float>{0.0};
-    delay_timer = 0;
-    sound_timer = 0; 
+	elapsed_time = std::chrono::duration<double>{0.0};
+	state.virtual_time = 0;
+	state.delay = 0;
+	state.sound = 0;
+}
+
+auto Chip8Timer::set_mode(TimerMode new_mode, timer_state& state) noexcept -> void {
+	if (new_mode != mode) {
+		// Start counting from the current point in time in the new mode
+		mode = new_mode;
+		stopwatch.reset();
+		elapsed_time = std::chrono::duration<double>{0.0};
+		state.virtual_time = 0;
+	}
 }
 
-auto Chip8Timer::tick() noexcept -> void {
-	using namespace std::chrono_literals;
-	static constexpr std::chrono::duration<float> clock{1.0 / 60.0};
-    
+auto Chip8Timer::tick(timer_state& state) noexcept -> void {
+	static constexpr std::chrono::duration<double> clock{1.0 / tick_rate};
 
 	stopwatch.tick();
 	elapsed_time += stopwatch.delta_time();
 
 	if (elapsed_time >= clock) {
-		if (delay_timer > 0) {
-			--delay_timer;
-		}
-		if (sound_timer > 0) {
-			--sound_timer;
-		}
-		
-		elapsed_time = std::chrono::duration<float>{0.0};
+		// Keep the remainder so the timers don't drift slower than 60Hz
+		const auto ticks = static_cast<uint64_t>(elapsed_time / clock);
+		elapsed_time -= ticks * clock;
+		count_down(state, ticks);
 	}
 }
 
-auto Chip8Timer::get_delay() const noexcept -> uint8_t {
-	return delay_timer;
-}
+auto Chip8Timer::advance(timer_state& state, uint64_t instructions, uint32_t clock_rate) noexcept -> void {
+	if (clock_rate == 0) {
+		return;
+	}
 
-auto Chip8Timer::set_delay(uint8_t value) noexcept -> void {
-	delay_timer = value;
-}
+	state.virtual_time += instructions * tick_rate;
 
-auto Chip8Timer::set_sound(uint8_t value) noexcept -> void {
-	sound_timer = value;
+	if (state.virtual_time >= clock_rate) {
+		const uint64_t ticks = state.virtual_time / clock_rate;
+		state.virtual_time %= clock_rate;
+		count_down(state, ticks);
+	}
 }
 
-auto Chip8Timer::is_sound() const noexcept -> bool {
-	return sound_timer > 0;
+auto Chip8Timer::count_down(timer_state& state, uint64_t ticks) noexcept -> void {
+	state.delay = (ticks < state.delay) ? static_cast<uint8_t>(state.delay - ticks) : 0;
+	state.sound = (ticks < state.sound) ? static_cast<uint8_t>(state.sound - ticks) : 0;
 }
@@ -1,8 +1,46 @@
 #pragma once
 
+#include <cstdint>
+
 #include "util/stopwatch/stopwatch.h"
 
 
+/**
+ * @enum TimerMode
+ * 
+ * @brief The time source that drives the 60Hz delay and sound timers
+ */
+enum class TimerMode : uint8_t {
+    real_time,    //Count down with the host's wall clock
+    virtual_time, //Count down with the number of executed instructions
+};
+
+
+/**
+ * @struct timer_state
+ *
+ * @brief The delay and sound timers, which are part of the emulated state
+ *
+ * @details The values are kept apart from @ref Chip8Timer, which only holds
+ *          the host's clock, so they can be copied with the rest of the state.
+ */
+struct timer_state {
+    // The emulated time since the last tick, in units of 1 / (60 * clock_rate) seconds (see Chip8Timer::advance)
+    uint64_t virtual_time;
+
+    // Delay timer. Used for timing events.
+    uint8_t delay;
+
+    // Sound timer. Creates sound when the value is non-zero.
+    uint8_t sound;
+};
+
+
+/**
+ * @class Chip8Timer
+ *
+ * @brief Counts down a @ref timer_state at 60Hz
+ */
 class Chip8Timer final {
 public:
     Chip8Timer();
@@ -11,8 +49,21 @@ public:
     // Member Functions - Execution
     //------------------------------------------------------------
 
-    /// Update the timers
-    auto tick() noexcept -> void;
+    /// Update the timers with the time elapsed since the last tick. Only used in TimerMode::real_time.
+    auto tick(timer_state& state) noexcept -> void;
+
+    /**
+     * @brief Advance the timers by a number of executed instructions. Only used in TimerMode::virtual_time.
+     * 
+     * @details The timers count down once every (clock_rate / 60) instructions.
+     *          Time is counted in integer units of 1 / (60 * clock_rate) seconds,
+     *          so no remainder is lost and the result is identical on every host.
+     * 
+     * @param[in,out] state         The timers to count down
+     * @param[in]     instructions  The number of instructions that were executed
+     * @param[in]     clock_rate    The number of instructions per emulated second
+     */
+    auto advance(timer_state& state, uint64_t instructions, uint32_t clock_rate) noexcept -> void;
 
     /// Pause the timers
     auto pause() noexcept -> void;
@@ -20,69 +71,40 @@ public:
     /// Resume the timers
     auto resume() noexcept -> void;
 
-    // Reset the timers
-    auto reset() noexcept -> void;
+    // Reset the clock and the timers
+    auto reset(timer_state& state) noexcept -> void;
 
-
-    //------------------------------------------------------------
-    // Member Functions - Delay Timer
-    //------------------------------------------------------------
-
-    /**
-     * @brief Get the delay timer value
-     * @return The number of ticks before the delay timer hits 0
-     */
     [[nodiscard]]
-    auto get_delay() const noexcept -> uint8_t;
+    auto get_mode() const noexcept -> TimerMode {
+        return mode;
+    }
 
-    /**
-     * @brief Set the delay timer
-     * 
-     * @details The delay timer counts down from a user-provided value
-     *          to 0 at a rate of 60Hz
-     * 
-     * @param[in] value  The number of ticks to count down from
-     */
-    auto set_delay(uint8_t value) noexcept -> void;
+    /// Select the time source of the timers
+    auto set_mode(TimerMode new_mode, timer_state& state) noexcept -> void;
 
+private:
 
     //------------------------------------------------------------
-    // Member Functions - Sound Timer
+    // Member Functions - Helpers
     //------------------------------------------------------------
 
-    /**
-     * @brief Set the sound timer
-     * 
-     * @details The sound timer counts down from a user-provided value
-     *          to 0 at a rate of 60Hz. While the count is non-zero,
-     *          a sound will be produced.
-     * 
-     * @param[in] value  The number of ticks to count down from
-     */
-    auto set_sound(uint8_t value) noexcept -> void;
-
-	/**
-     * @brief Determine if a sound should be produced
-     * @return True if sound should be produced
-     */
-    [[nodiscard]]
-    auto is_sound() const noexcept -> bool;
+    /// Count down both timers by a number of 60Hz ticks
+    static auto count_down(timer_state& state, uint64_t ticks) noexcept -> void;
 
-private:
 
     //------------------------------------------------------------
     // Member Variables
     //------------------------------------------------------------
 
-    // The stopwatch used to keep time
-    Stopwatch<> stopwatch;
+    // The frequency of the timers
+    static constexpr uint32_t tick_rate = 60;
 
-    // The elapsed time
-    std::chrono::duration<float> elapsed_time;
+    // The time source of the timers
+    TimerMode mode = TimerMode::real_time;
 
-    // Delay timer. Used for timing events.
-	uint8_t delay_timer;
+    // The stopwatch used to keep time
+    Stopwatch<> stopwatch;
 
-    // Sound timer. Creates sound when the value is non-zero.
-	uint8_t sound_timer;
+    // The elapsed time since the last tick
+    std::chrono::duration<double> elapsed_time;
 };
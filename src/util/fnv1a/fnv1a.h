@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+
+/// The initial value of a 64-bit FNV-1a hash
+inline constexpr uint64_t fnv1a_offset = 0xCBF29CE484222325;
+
+
+/**
+ * @brief Compute or continue a 64-bit FNV-1a hash of a block of data
+ *
+ * @details FNV-1a is used to fingerprint and checksum emulated states. It's
+ *          fast and simple, but not suitable for anything adversarial.
+ *
+ * @param[in] data  The bytes to hash
+ * @param[in] hash  The hash of the preceding data, or fnv1a_offset to start a new hash
+ */
+[[nodiscard]]
+inline auto fnv1a(std::span<const uint8_t> data, uint64_t hash = fnv1a_offset) noexcept -> uint64_t {
+	for (const uint8_t byte : data) {
+		hash ^= byte;
+		hash *= 0x100000001B3;
+	}
+	return hash;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <utility>
+
+#if defined(_WIN32)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+/**
+ * @class MappedFile
+ *
+ * @brief A read-only memory mapping of a whole file
+ *
+ * @details The contents are paged in by the OS as they're read, so a file can
+ *          be parsed in place without reading it into a buffer first. The
+ *          mapping starts on a page boundary, so it's aligned for any type.
+ *          An empty or missing file results in an invalid mapping.
+ */
+class MappedFile {
+public:
+	MappedFile() = default;
+
+	explicit MappedFile(const std::filesystem::path& file) {
+		open(file);
+	}
+
+	MappedFile(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept :
+		data(std::exchange(other.data, nullptr)),
+		size(std::exchange(other.size, 0)) {
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+	auto operator=(MappedFile&& other) noexcept -> MappedFile& {
+		if (this != &other) {
+			close();
+			data = std::exchange(other.data, nullptr);
+			size = std::exchange(other.size, 0);
+		}
+		return *this;
+	}
+
+	/// Check if the file is mapped
+	[[nodiscard]]
+	auto is_open() const noexcept -> bool {
+		return data != nullptr;
+	}
+
+	/// Get the contents of the file. Empty if it isn't mapped.
+	[[nodiscard]]
+	auto get_bytes() const noexcept -> std::span<const uint8_t> {
+		return {data, size};
+	}
+
+	/**
+	 * @brief Map a file, replacing the current mapping
+	 *
+	 * @param[in] file  The path of the file to map
+	 *
+	 * @return True if the file was mapped, otherwise false.
+	 */
+	auto open(const std::filesystem::path& file) -> bool {
+		close();
+
+#if defined(_WIN32)
+		const HANDLE handle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		LARGE_INTEGER file_size = {};
+		if (GetFileSizeEx(handle, &file_size) and (file_size.QuadPart > 0)) {
+			if (const HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+				data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				size = data ? static_cast<size_t>(file_size.QuadPart) : 0;
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(handle);
+#else
+		const int fd = ::open(file.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+
+		struct stat info = {};
+		if ((fstat(fd, &info) == 0) and (info.st_size > 0)) {
+			void* const mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapping != MAP_FAILED) {
+				data = static_cast<const uint8_t*>(mapping);
+				size = static_cast<size_t>(info.st_size);
+			}
+		}
+		::close(fd);
+#endif
+
+		return is_open();
+	}
+
+	/// Unmap the file
+	auto close() noexcept -> void {
+		if (!data) {
+			return;
+		}
+
+#if defined(_WIN32)
+		UnmapViewOfFile(data);
+#else
+		munmap(const_cast<uint8_t*>(data), size);
+#endif
+
+		data = nullptr;
+		size = 0;
+	}
+
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+
+/**
+ * @class Pcg32
+ *
+ * @brief The PCG32 random number generator (PCG-XSH-RR with 64 bits of state)
+ *
+ * @details A small, fast generator with good statistical quality. Its whole
+ *          state is two 64-bit words, so it can be stored in an emulated
+ *          state that is copied every frame, where a 5 KB Mersenne Twister
+ *          would dominate the copy. The sequence of a seed is defined here
+ *          rather than by the standard library, so it's the same on every
+ *          host and compiler.
+ *
+ *          Satisfies std::uniform_random_bit_generator.
+ */
+class Pcg32 {
+public:
+	using result_type = uint32_t;
+
+	Pcg32() noexcept {
+		seed(0);
+	}
+
+	explicit Pcg32(uint64_t value, uint64_t stream = default_stream) noexcept {
+		seed(value, stream);
+	}
+
+	/**
+	 * @brief Restart the generator at the beginning of the sequence of a seed
+	 *
+	 * @param[in] value   The seed
+	 * @param[in] stream  Selects one of 2^63 independent sequences
+	 */
+	auto seed(uint64_t value, uint64_t stream = default_stream) noexcept -> void {
+		state     = 0;
+		increment = (stream << 1) | 1;
+		(*this)();
+		state += value;
+		(*this)();
+	}
+
+	/// Generate the next number in the sequence
+	auto operator()() noexcept -> result_type {
+		const uint64_t old = state;
+		state = (old * multiplier) + increment;
+
+		const auto xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+		const auto rotation   = static_cast<uint32_t>(old >> 59);
+		return (xorshifted >> rotation) | (xorshifted << ((0u - rotation) & 31));
+	}
+
+	[[nodiscard]]
+	static constexpr auto min() noexcept -> result_type {
+		return std::numeric_limits<result_type>::min();
+	}
+
+	[[nodiscard]]
+	static constexpr auto max() noexcept -> result_type {
+		return std::numeric_limits<result_type>::max();
+	}
+
+	[[nodiscard]]
+	auto operator==(const Pcg32&) const noexcept -> bool = default;
+
+private:
+	static constexpr uint64_t multiplier     = 6364136223846793005ULL;
+	static constexpr uint64_t default_stream = 0xDA3E39CB94B95BDBULL;
+
+	uint64_t state     = 0;
+	uint64_t increment = 0;
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+
+/// A SHA-1 digest
+using sha1_digest = std::array<uint8_t, 20>;
+
+
+/**
+ * @brief Compute the SHA-1 digest of a block of data
+ *
+ * @details SHA-1 is used to identify ROMs by their contents, as it is by the
+ *          community CHIP-8 databases. It's not used for anything that needs
+ *          a cryptographically secure hash.
+ */
+[[nodiscard]]
+inline auto sha1(std::span<const uint8_t> data) noexcept -> sha1_digest {
+	std::array<uint32_t, 5> h = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+	const auto process = [&h](const uint8_t* chunk) {
+		std::array<uint32_t, 80> w;
+		for (size_t i = 0; i < 16; ++i) {
+			w[i] = (uint32_t{chunk[4*i]} << 24) | (uint32_t{chunk[4*i + 1]} << 16) | (uint32_t{chunk[4*i + 2]} << 8) | uint32_t{chunk[4*i + 3]};
+		}
+		for (size_t i = 16; i < 80; ++i) {
+			w[i] = std::rotl(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+		}
+
+		auto [a, b, c, d, e] = h;
+
+		for (size_t i = 0; i < 80; ++i) {
+			uint32_t f = 0;
+			uint32_t k = 0;
+
+			if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+			else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+			else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+			else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+
+			const uint32_t temp = std::rotl(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = std::rotl(b, 30);
+			b = a;
+			a = temp;
+		}
+
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	};
+
+	// Process the whole chunks, then the padded remainder (1 bit, zeros, and the 64 bit length)
+	const size_t whole = data.size() / 64;
+	for (size_t i = 0; i < whole; ++i) {
+		process(data.data() + (i * 64));
+	}
+
+	std::array<uint8_t, 128> tail = {};
+	const size_t remainder = data.size() - (whole * 64);
+	std::copy_n(data.data() + (whole * 64), remainder, tail.begin());
+	tail[remainder] = 0x80;
+
+	const size_t tail_size = (remainder < 56) ? 64 : 128;
+	const uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+	for (size_t i = 0; i < 8; ++i) {
+		tail[tail_size - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+	}
+
+	process(tail.data());
+	if (tail_size == 128) {
+		process(tail.data() + 64);
+	}
+
+	auto digest = sha1_digest{};
+	for (size_t i = 0; i < 5; ++i) {
+		digest[4*i]     = static_cast<uint8_t>(h[i] >> 24);
+		digest[4*i + 1] = static_cast<uint8_t>(h[i] >> 16);
+		digest[4*i + 2] = static_cast<uint8_t>(h[i] >> 8);
+		digest[4*i + 3] = static_cast<uint8_t>(h[i]);
+	}
+	return digest;
+}
+
+
+/// Convert a SHA-1 digest to a lowercase hexadecimal string
+[[nodiscard]]
+inline auto to_string(const sha1_digest& digest) -> std::string {
+	static constexpr std::string_view digits = "0123456789abcdef";
+
+	std::string out;
+	out.reserve(digest.size() * 2);
+	for (const uint8_t byte : digest) {
+		out += digits[byte >> 4];
+		out += digits[byte & 0xF];
+	}
+	return out;
+}
+
+
+/// Parse a hexadecimal SHA-1 digest. Returns nothing if the string isn't 40 hexadecimal digits.
+[[nodiscard]]
+inline auto to_sha1_digest(std::string_view str) noexcept -> std::optional<sha1_digest> {
+	if (str.size() != 40) {
+		return {};
+	}
+
+	const auto nibble = [](char c) -> int {
+		if (c >= '0' and c <= '9') return c - '0';
+		if (c >= 'a' and c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' and c <= 'F') return c - 'A' + 10;
+		return -1;
+	};
+
+	auto digest = sha1_digest{};
+	for (size_t i = 0; i < digest.size(); ++i) {
+		const int high = nibble(str[2*i]);
+		const int low  = nibble(str[2*i + 1]);
+		if (high < 0 or low < 0) {
+			return {};
+		}
+		digest[i] = static_cast<uint8_t>((high << 4) | low);
+	}
+	return digest;
+}
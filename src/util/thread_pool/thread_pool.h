@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+
+/**
+ * @class ThreadPool
+ *
+ * @brief A fixed size pool of worker threads with work stealing
+ *
+ * @details Each worker has its own task queue. Tasks are distributed across
+ *          the queues round-robin, and a worker that runs out of tasks steals
+ *          from the front of the other queues. Workers only contend on a queue
+ *          when stealing, so throughput scales with the number of cores even
+ *          when the tasks take very different amounts of time.
+ */
+class ThreadPool {
+public:
+	using task_t = std::function<void()>;
+
+	/**
+	 * @param[in] thread_count  The number of worker threads. 0 selects the number of hardware threads.
+	 */
+	explicit ThreadPool(size_t thread_count = 0) {
+		if (thread_count == 0) {
+			thread_count = std::max(size_t{1}, static_cast<size_t>(std::thread::hardware_concurrency()));
+		}
+
+		for (size_t i = 0; i < thread_count; ++i) {
+			queues.push_back(std::make_unique<task_queue>());
+		}
+		for (size_t i = 0; i < thread_count; ++i) {
+			threads.emplace_back([this, i] { worker_loop(i); });
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+
+	/// Finishes the queued tasks, then stops the workers
+	~ThreadPool() {
+		wait();
+		{
+			std::scoped_lock lock{wake_mutex};
+			stopping = true;
+		}
+		wake.notify_all();
+
+		// Join before the synchronization members are destroyed
+		threads.clear();
+	}
+
+	auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+	auto operator=(ThreadPool&&) -> ThreadPool& = delete;
+
+	/// Get the number of worker threads
+	[[nodiscard]]
+	auto size() const noexcept -> size_t {
+		return threads.size();
+	}
+
+	/**
+	 * @brief Queue a task to be run by a worker
+	 *
+	 * @param[in] task  The function to run. Must not throw.
+	 */
+	auto submit(task_t task) -> void {
+		{
+			std::scoped_lock lock{wake_mutex};
+			++queued;
+			++pending;
+		}
+
+		auto& queue = *queues[next_queue++ % queues.size()];
+		{
+			std::scoped_lock lock{queue.mutex};
+			queue.tasks.push_back(std::move(task));
+		}
+
+		wake.notify_one();
+	}
+
+	/// Block until every submitted task has completed
+	auto wait() -> void {
+		std::unique_lock lock{wake_mutex};
+		done.wait(lock, [this] { return pending == 0; });
+	}
+
+private:
+
+	struct task_queue {
+		std::mutex mutex;
+		std::deque<task_t> tasks;
+	};
+
+	auto worker_loop(size_t index) -> void {
+		while (true) {
+			if (auto task = take(index)) {
+				(*task)();
+
+				std::scoped_lock lock{wake_mutex};
+				if (--pending == 0) {
+					done.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock lock{wake_mutex};
+			wake.wait(lock, [this] { return stopping or (queued > 0); });
+
+			if (stopping and (queued == 0)) {
+				return;
+			}
+		}
+	}
+
+	/// Take a task from the back of the worker's own queue, or steal one from the front of another queue
+	[[nodiscard]]
+	auto take(size_t index) -> std::optional<task_t> {
+		for (size_t offset = 0; offset < queues.size(); ++offset) {
+			auto& queue = *queues[(index + offset) % queues.size()];
+			std::scoped_lock lock{queue.mutex};
+
+			if (queue.tasks.empty()) {
+				continue;
+			}
+
+			task_t task;
+			if (offset == 0) {
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+			else {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+
+			--queued;
+			return task;
+		}
+
+		return {};
+	}
+
+
+	std::vector<std::unique_ptr<task_queue>> queues;
+	std::vector<std::jthread> threads;
+
+	// Guards the counters below and is used by the condition variables
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// Tasks in the queues, and tasks that haven't completed
+	std::atomic<size_t> queued = 0;
+	size_t pending = 0;
+
+	std::atomic<size_t> next_queue = 0;
+	bool stopping = false;
+};
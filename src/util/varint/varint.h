@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+
+/// The maximum number of bytes a 64-bit varint is encoded in
+inline constexpr size_t max_varint_bytes = 10;
+
+
+/**
+ * @brief Append an unsigned integer to a buffer as a varint
+ *
+ * @details The value is written 7 bits at a time, least significant bits
+ *          first. The high bit of each byte is set when another byte follows,
+ *          so small values take a single byte.
+ *
+ * @param[in] value  The value to encode
+ * @param[in] out    The buffer to append to
+ */
+inline auto write_varint(uint64_t value, std::vector<uint8_t>& out) -> void {
+	while (value >= 0x80) {
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+
+/**
+ * @brief Read a varint written by write_varint from the front of a buffer
+ *
+ * @param[in,out] data  The encoded bytes. The bytes that were read are removed from the front.
+ *
+ * @return The decoded value, or nullopt if the data ends early or the value doesn't fit in 64 bits.
+ */
+[[nodiscard]]
+inline auto read_varint(std::span<const uint8_t>& data) noexcept -> std::optional<uint64_t> {
+	uint64_t value = 0;
+
+	for (size_t i = 0; (i < data.size()) and (i < max_varint_bytes); ++i) {
+		const uint64_t bits = data[i] & 0x7F;
+
+		// The 10th byte only holds the top bit of the value
+		if ((i == (max_varint_bytes - 1)) and (bits > 1)) {
+			return std::nullopt;
+		}
+
+		value |= bits << (7 * i);
+
+		if ((data[i] & 0x80) == 0) {
+			data = data.subspan(i + 1);
+			return value;
+		}
+	}
+
+	return std::nullopt;
+}
@@ -0,0 +1,71 @@
+#include "recompiler.h"
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+
+// Convert a file name into a valid C++ identifier
+static auto to_identifier(std::string name) -> std::string {
+	for (auto& c : name) {
+		if (!std::isalnum(static_cast<unsigned char>(c))) {
+			c = '_';
+		}
+	}
+	if (name.empty() or std::isdigit(static_cast<unsigned char>(name.front()))) {
+		name.insert(name.begin(), '_');
+	}
+	return name;
+}
+
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cout << "Usage: chip8_aot <rom> <output.cpp> [name] [vip|schip|xo-chip]\n"
+		          << "  Recompiles a CHIP-8 ROM into a C++ translation unit. Linking the output into\n"
+		          << "  an executable makes the emulator run the compiled code whenever the ROM is loaded\n"
+		          << "  with the quirk profile it was compiled for (xo-chip by default).\n";
+		return 1;
+	}
+
+	const auto rom_path = std::filesystem::path{argv[1]};
+	const auto out_path = std::filesystem::path{argv[2]};
+	const auto name = to_identifier((argc > 3) ? argv[3] : rom_path.stem().string());
+
+	const auto profile = to_quirk_profile((argc > 4) ? argv[4] : "xo-chip");
+	if (!profile) {
+		std::cout << "Unknown quirk profile " << argv[4] << '\n';
+		return 1;
+	}
+
+	std::ifstream rom_file(rom_path, std::ios::binary);
+	if (!rom_file) {
+		std::cout << "Error opening " << rom_path << '\n';
+		return 1;
+	}
+
+	const auto rom = std::vector<uint8_t>(std::istreambuf_iterator<char>{rom_file}, std::istreambuf_iterator<char>{});
+
+	if (rom.size() > (Recompiler::memory_size - Recompiler::rom_start)) {
+		std::cout << "The ROM " << rom_path << " is too big to fit in the CHIP8 memory\n";
+		return 1;
+	}
+
+	const auto recompiler = Recompiler{rom, *profile};
+	const auto source = recompiler.generate(name, rom_path.filename().string());
+
+	std::ofstream out_file(out_path);
+	if (!out_file) {
+		std::cout << "Error opening " << out_path << '\n';
+		return 1;
+	}
+	out_file << source;
+
+	std::cout << "Recompiled " << rom_path.filename() << " into " << recompiler.get_blocks().size() << " blocks\n";
+
+	return 0;
+}
@@ -0,0 +1,363 @@
+#include "recompiler.h"
+
+#include <algorithm>
+#include <format>
+
+
+//----------------------------------------------------------------------------------
+// Control Flow
+//----------------------------------------------------------------------------------
+
+// Check if an instruction ends a basic block. Branches end a block because the
+// next instruction depends on the runtime state, and memory writes or waits
+// end a block because the code that follows may change or not run at all.
+[[nodiscard]]
+static auto ends_block(Opcodes op) noexcept -> bool {
+	switch (op) {
+		case Opcodes::ret:
+		case Opcodes::jmp_nnn:
+		case Opcodes::call_nnn:
+		case Opcodes::se_vx_nn:
+		case Opcodes::sne_vx_nn:
+		case Opcodes::se_vx_vy:
+		case Opcodes::sne_vx_vy:
+		case Opcodes::jmp_v0_nnn:
+		case Opcodes::drw_vx_vy_n:
+		case Opcodes::skp_vx:
+		case Opcodes::sknp_vx:
+		case Opcodes::exit:
+		case Opcodes::key_vx:
+		case Opcodes::bcd_vx:
+		case Opcodes::str_v0_vx:
+		case Opcodes::save_vx_vy:
+		case Opcodes::mov_i_nnnn:
+		case Opcodes::invalid:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+
+// Get the addresses that execution may continue at after a block-ending instruction.
+// skip is the address a skip instruction continues at when it skips.
+[[nodiscard]]
+static auto successors(instruction instr, uint16_t address, uint16_t skip) -> std::vector<uint16_t> {
+	const auto next = static_cast<uint16_t>(address + 2);
+
+	switch (instr.opcode) {
+		case Opcodes::jmp_nnn:
+			return {instr.nnn};
+
+		// The subroutine returns to the instruction after the call
+		case Opcodes::call_nnn:
+			return {instr.nnn, next};
+
+		case Opcodes::se_vx_nn:
+		case Opcodes::sne_vx_nn:
+		case Opcodes::se_vx_vy:
+		case Opcodes::sne_vx_vy:
+		case Opcodes::skp_vx:
+		case Opcodes::sknp_vx:
+			return {next, skip};
+
+		case Opcodes::drw_vx_vy_n:
+		case Opcodes::key_vx:
+		case Opcodes::bcd_vx:
+		case Opcodes::str_v0_vx:
+		case Opcodes::save_vx_vy:
+			return {next};
+
+		// The long load is followed by its 16 bit operand
+		case Opcodes::mov_i_nnnn:
+			return {static_cast<uint16_t>(address + 4)};
+
+		// The targets of ret and jmp v0 are only known at runtime
+		default:
+			return {};
+	}
+}
+
+
+//----------------------------------------------------------------------------------
+// Recompiler
+//----------------------------------------------------------------------------------
+
+Recompiler::Recompiler(std::span<const uint8_t> rom, QuirkProfile profile) :
+	rom(rom.first(std::min(rom.size(), memory_size - rom_start))),
+	profile(profile),
+	active_quirks(get_quirks(profile)) {
+	build_blocks(find_leaders());
+}
+
+
+auto Recompiler::fetch(uint16_t address) const -> std::optional<instruction> {
+	if (address < rom_start) {
+		return {};
+	}
+
+	const size_t offset = address - rom_start;
+	if ((offset + 1) >= rom.size()) {
+		return {};
+	}
+
+	return instruction{rom[offset], rom[offset + 1]};
+}
+
+
+auto Recompiler::skip_target(uint16_t address) const -> uint16_t {
+	const auto next = fetch(address + 2);
+	const bool long_load = next and (next->opcode == Opcodes::mov_i_nnnn);
+
+	return static_cast<uint16_t>(address + (long_load ? 6 : 4));
+}
+
+
+auto Recompiler::find_leaders() const -> std::set<uint16_t> {
+	std::set<uint16_t> leaders;
+	std::vector<uint16_t> pending = {rom_start};
+
+	while (!pending.empty()) {
+		const uint16_t start = pending.back();
+		pending.pop_back();
+
+		if (!fetch(start) or !leaders.insert(start).second) {
+			continue;
+		}
+
+		// Follow the code until it branches, then queue the branch targets.
+		// The timers are advanced after a block, so an instruction that uses them starts a new one.
+		for (uint16_t address = start; const auto instr = fetch(address); address += 2) {
+			if ((address != start) and uses_timers(instr->opcode)) {
+				pending.push_back(address);
+				break;
+			}
+			if (ends_block(instr->opcode)) {
+				for (const uint16_t target : successors(*instr, address, skip_target(address))) {
+					pending.push_back(target);
+				}
+				break;
+			}
+		}
+	}
+
+	return leaders;
+}
+
+
+auto Recompiler::build_blocks(const std::set<uint16_t>& leaders) -> void {
+	for (const uint16_t start : leaders) {
+		block blk;
+		blk.start = start;
+
+		uint16_t address = start;
+		while (const auto instr = fetch(address)) {
+			blk.instructions.push_back(*instr);
+			address += 2;
+
+			// Fall through into the next block rather than duplicating its code
+			if (ends_block(instr->opcode) or leaders.contains(address)) {
+				break;
+			}
+		}
+
+		blk.end = address;
+		blocks.push_back(std::move(blk));
+	}
+}
+
+
+//----------------------------------------------------------------------------------
+// Code Generation
+//----------------------------------------------------------------------------------
+
+// Get the name of a QuirkProfile enumerator, for referring to it in the generated code
+[[nodiscard]]
+static auto enumerator_name(QuirkProfile profile) noexcept -> std::string_view {
+	switch (profile) {
+		case QuirkProfile::cosmac_vip: return "cosmac_vip";
+		case QuirkProfile::schip:      return "schip";
+		default:                       return "xo_chip";
+	}
+}
+
+auto Recompiler::generate(std::string_view name, std::string_view source) const -> std::string {
+	size_t instruction_count = 0;
+	for (const auto& blk : blocks) {
+		instruction_count += blk.instructions.size();
+	}
+
+	std::string out;
+
+	out += std::format("// Generated by chip8_aot from {}. Do not edit.\n", source);
+	out += std::format("// {} blocks, {} instructions\n\n", blocks.size(), instruction_count);
+	out += "#include \"chip8/aot/aot_program.h\"\n\n\n";
+	out += "namespace {\n\n";
+
+	// ROM contents, used to match the program to a loaded ROM
+	out += "constexpr uint8_t rom[] = {";
+	for (size_t idx = 0; idx < rom.size(); ++idx) {
+		out += (idx % 16 == 0) ? "\n    " : " ";
+		out += std::format("0x{:02X},", rom[idx]);
+	}
+	out += "\n};\n\n";
+
+	for (const auto& blk : blocks) {
+		out += '\n';
+		emit_block(out, blk);
+	}
+
+	out += "\nconstexpr aot_block blocks[] = {\n";
+	for (const auto& blk : blocks) {
+		out += std::format("    {{0x{:03X}, 0x{:03X}, {}, block_{:03X}}},\n", blk.start, blk.end, blk.instructions.size(), blk.start);
+	}
+	out += "};\n\n";
+	out += "} //namespace\n\n\n";
+
+	out += std::format("extern const aot_program chip8_aot_{0} = {{\"{0}\", rom, QuirkProfile::{1}, blocks}};\n\n", name, enumerator_name(profile));
+	out += std::format("[[maybe_unused]] static const bool registered = register_aot_program(chip8_aot_{});\n", name);
+
+	return out;
+}
+
+
+auto Recompiler::emit_block(std::string& out, const block& blk) const -> void {
+	std::string body;
+	bool uses_v = false;
+	bool uses_i = false;
+	bool uses_pc = false;
+
+	uint16_t address = blk.start;
+	bool branched = false;
+
+	// The or, and, and xor instructions also clear vf with the VF reset quirk
+	const auto* const vf_reset = active_quirks.vf_reset ? " v[0xF] = 0;" : "";
+
+	for (const auto& instr : blk.instructions) {
+		const auto x = instr.x;
+		const auto y = instr.y;
+		std::string code;
+
+		// Statements match the order of the interpreter's operations, so vf is correct when x or y is 0xF
+		switch (instr.opcode) {
+			case Opcodes::sys_nnn:
+				break;
+
+			case Opcodes::jmp_nnn:
+				code = std::format("pc = 0x{:03X};", instr.nnn);
+				uses_pc = branched = true;
+				break;
+
+			case Opcodes::se_vx_nn:
+			case Opcodes::sne_vx_nn: {
+				const auto* cmp = (instr.opcode == Opcodes::se_vx_nn) ? "==" : "!=";
+				code = std::format("pc = (v[0x{:X}] {} 0x{:02X}) ? 0x{:03X} : 0x{:03X};", x, cmp, instr.nn, skip_target(address), address + 2);
+				uses_v = uses_pc = branched = true;
+				break;
+			}
+
+			case Opcodes::se_vx_vy:
+			case Opcodes::sne_vx_vy: {
+				const auto* cmp = (instr.opcode == Opcodes::se_vx_vy) ? "==" : "!=";
+				code = std::format("pc = (v[0x{:X}] {} v[0x{:X}]) ? 0x{:03X} : 0x{:03X};", x, cmp, y, skip_target(address), address + 2);
+				uses_v = uses_pc = branched = true;
+				break;
+			}
+
+			case Opcodes::mov_vx_nn:
+				code = std::format("v[0x{:X}] = 0x{:02X};", x, instr.nn);
+				uses_v = true;
+				break;
+
+			case Opcodes::add_vx_nn:
+				code = std::format("v[0x{:X}] += 0x{:02X};", x, instr.nn);
+				uses_v = true;
+				break;
+
+			case Opcodes::mov_vx_vy:
+				code = std::format("v[0x{:X}] = v[0x{:X}];", x, y);
+				uses_v = true;
+				break;
+
+			case Opcodes::or_vx_vy:
+				code = std::format("v[0x{:X}] |= v[0x{:X}];{}", x, y, vf_reset);
+				uses_v = true;
+				break;
+
+			case Opcodes::and_vx_vy:
+				code = std::format("v[0x{:X}] &= v[0x{:X}];{}", x, y, vf_reset);
+				uses_v = true;
+				break;
+
+			case Opcodes::xor_vx_vy:
+				code = std::format("v[0x{:X}] ^= v[0x{:X}];{}", x, y, vf_reset);
+				uses_v = true;
+				break;
+
+			case Opcodes::add_vx_vy:
+				code = std::format("{{ const uint8_t r = v[0x{0:X}] + v[0x{1:X}]; const bool c = (r < v[0x{0:X}]); v[0x{0:X}] = r; v[0xF] = c; }}", x, y);
+				uses_v = true;
+				break;
+
+			case Opcodes::sub_vx_vy:
+				code = std::format("v[0xF] = (v[0x{0:X}] > v[0x{1:X}]); v[0x{0:X}] = v[0x{0:X}] - v[0x{1:X}];", x, y);
+				uses_v = true;
+				break;
+
+			case Opcodes::subn_vx_vy:
+				code = std::format("v[0xF] = (v[0x{1:X}] > v[0x{0:X}]); v[0x{0:X}] = v[0x{1:X}] - v[0x{0:X}];", x, y);
+				uses_v = true;
+				break;
+
+			case Opcodes::mov_i_nnn:
+				code = std::format("i = 0x{:03X};", instr.nnn);
+				uses_i = true;
+				break;
+
+			case Opcodes::add_i_vx:
+				code = std::format("v[0xF] = (static_cast<uint16_t>(i + v[0x{0:X}]) < i); i = v[0x{0:X}] + i;", x);
+				uses_v = uses_i = true;
+				break;
+
+			case Opcodes::font_vx:
+				code = std::format("i = v[0x{:X}] * 5;", x);
+				uses_v = uses_i = true;
+				break;
+
+			// Everything else is executed by the interpreter, which also sets the PC
+			default:
+				code = std::format("AOTAccess::interpret(chip, 0x{:03X}, instruction(0x{:04X}));", address, static_cast<uint16_t>(instr));
+				branched = ends_block(instr.opcode);
+				break;
+		}
+
+		if (!code.empty()) {
+			body += std::format("    {:<60} // 0x{:03X}: {}\n", code, address, to_string(instr));
+		}
+		address += 2;
+	}
+
+	// Continue at the next instruction if the block falls through
+	if (!branched) {
+		body += std::format("    pc = 0x{:03X};\n", address);
+		uses_pc = true;
+	}
+
+	out += std::format("// 0x{:03X} - 0x{:03X}\n", blk.start, blk.end);
+	out += std::format("void block_{:03X}(chip8& chip) {{\n", blk.start);
+	if (uses_v) {
+		out += "    auto& v  = AOTAccess::v(chip);\n";
+	}
+	if (uses_i) {
+		out += "    auto& i  = AOTAccess::i(chip);\n";
+	}
+	if (uses_pc) {
+		out += "    auto& pc = AOTAccess::pc(chip);\n";
+	}
+	if (uses_v or uses_i or uses_pc) {
+		out += '\n';
+	}
+	out += body;
+	out += "}\n";
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chip8/isa/quirks.h"
+#include "instruction/instruction.h"
+
+
+/**
+ * @class Recompiler
+ *
+ * @brief Translates a CHIP-8 ROM into a C++ translation unit
+ *
+ * @details The ROM is traversed from its entry point to discover the basic
+ *          blocks that are reachable through direct branches. Each block is
+ *          emitted as a C++ function that operates on the chip8 state through
+ *          AOTAccess. Instructions which need the rest of the system (the
+ *          display, input, timers, stack, or memory) are executed by calling
+ *          the interpreter from the generated code. The timers are only
+ *          advanced after a block, so an instruction that uses them (see
+ *          uses_timers) always starts a block.
+ *
+ *          The targets of indirect jumps (jmp v0 nnn) can't be discovered
+ *          statically, and are executed by the interpreter at runtime.
+ *
+ *          The code is generated for the quirks of one profile, and the
+ *          program is only used when the ROM is run with that profile.
+ */
+class Recompiler {
+public:
+
+    /// The address the ROM is loaded at
+    static constexpr uint16_t rom_start = 0x200;
+
+    /// The size of the CHIP-8 memory
+    static constexpr size_t memory_size = 4096;
+
+    struct block {
+        // The address of the first instruction in the block
+        uint16_t start = 0;
+
+        // One past the last byte of the block
+        uint16_t end = 0;
+
+        // The instructions in the block
+        std::vector<instruction> instructions;
+    };
+
+    /**
+     * @param[in] rom      The contents of the ROM file
+     * @param[in] profile  The quirk profile to generate the code for
+     */
+    explicit Recompiler(std::span<const uint8_t> rom, QuirkProfile profile = QuirkProfile::xo_chip);
+
+    /**
+     * @brief Generate the C++ source for the ROM
+     *
+     * @param[in] name    The name of the program. Must be a valid C++ identifier.
+     * @param[in] source  The name of the ROM file, used in the generated comments
+     *
+     * @return The contents of the translation unit
+     */
+    [[nodiscard]]
+    auto generate(std::string_view name, std::string_view source) const -> std::string;
+
+    [[nodiscard]]
+    auto get_blocks() const noexcept -> const std::vector<block>& {
+        return blocks;
+    }
+
+private:
+
+    /// Find the start address of every reachable basic block
+    [[nodiscard]]
+    auto find_leaders() const -> std::set<uint16_t>;
+
+    /// Split the ROM into basic blocks at the leaders
+    auto build_blocks(const std::set<uint16_t>& leaders) -> void;
+
+    /// Get the instruction at an address, or nothing if the address isn't within the ROM
+    [[nodiscard]]
+    auto fetch(uint16_t address) const -> std::optional<instruction>;
+
+    /// Get the address a skip at an address continues at when it skips. The XO-CHIP long load is skipped as a whole.
+    [[nodiscard]]
+    auto skip_target(uint16_t address) const -> uint16_t;
+
+    /// Emit the function for a block
+    auto emit_block(std::string& out, const block& blk) const -> void;
+
+    std::span<const uint8_t> rom;
+    std::vector<block> blocks;
+
+    QuirkProfile profile;
+    quirks active_quirks;
+};
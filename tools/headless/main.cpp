@@ -0,0 +1,378 @@
+#include "headless/batch_runner.h"
+#include "headless/headless_runner.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+static constexpr std::string_view usage =
+	"Usage: chip8_headless <rom or directory>... [options]\n"
+	"  Runs CHIP-8 ROMs without a window. A single ROM prints the display, registers, and\n"
+	"  throughput. Multiple ROMs, directories (searched recursively for .ch8 files), or\n"
+	"  --seeds run as a batch on all cores and print a report.\n"
+	"\n"
+	"Options:\n"
+	"  --cycles <n>   Execute n instructions (default: 1000000)\n"
+	"  --frames <n>   Execute n 60Hz frames instead of a number of instructions\n"
+	"  --clock <hz>   Set the clock rate (default: 500)\n"
+	"  --ipf <n>      Execute n instructions per frame instead of using the clock rate\n"
+	"  --seed <n>     Seed the random number generator\n"
+	"  --seeds <n>    Run each ROM n times, with the seeds 0 to n-1\n"
+	"  --threads <n>  Use n worker threads in batch mode (default: all hardware threads)\n"
+	"  --lockstep     Run the seeds of each ROM in lock-step on one thread (see Chip8Batch)\n"
+	"  --jit          Enable the JIT compiler (ignored in lock-step mode)\n"
+	"  --no-fusion    Disable superinstruction fusion (ignored in lock-step mode)\n"
+	"  --no-idle-skip Execute every iteration of idle loops instead of skipping to the next timer tick\n"
+	"                 (ignored in lock-step mode)\n"
+	"  --no-aot       Don't use ahead-of-time compiled programs (ignored in lock-step mode)\n"
+	"  --quirks <p>   Follow the quirks of an interpreter: vip, schip, or xo-chip (default: xo-chip)\n"
+	"  --db <file>    Apply the platform, quirks, and instructions per frame recorded for each ROM in a database\n"
+	"  --xo-chip      Emulate XO-CHIP, with 64 KB of memory (ignored in lock-step mode)\n"
+	"  --load-state <file>  Load a save state after loading the ROM (single ROM only)\n"
+	"  --save-state <file>  Write a save state after the run (single ROM only)\n"
+	"  --rewind <n>   Record every frame, and rewind n frames after the run (single ROM only)\n"
+	"  --movie <file> Replay the input recorded in a movie, up to its end unless --cycles or --frames\n"
+	"                 is given, and check the final state against the recording (single ROM only)\n"
+	"  --quiet        Only print the throughput\n";
+
+
+[[nodiscard]]
+static auto parse_number(std::string_view str) -> std::optional<uint64_t> {
+	uint64_t value = 0;
+	const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+
+	if ((ec != std::errc{}) or (ptr != str.data() + str.size())) {
+		return {};
+	}
+	return value;
+}
+
+
+static auto print_display(const chip8& chip) -> void {
+	const auto& display = chip.get_display();
+
+	std::string line;
+	for (size_t y = 0; y < display.size_y(); ++y) {
+		line.clear();
+		for (size_t x = 0; x < display.size_x(); ++x) {
+			line += display.get_pixel(x, y) ? '#' : '.';
+		}
+		std::cout << line << '\n';
+	}
+}
+
+
+static auto print_registers(const chip8& chip) -> void {
+	const auto& v = chip.get_registers();
+
+	for (size_t idx = 0; idx < v.size(); ++idx) {
+		std::printf("v%zX=%02X%c", idx, v[idx], (idx % 8 == 7) ? '\n' : ' ');
+	}
+	std::printf("pc=%03X i=%03X sp=%zu dt=%02X st=%02X\n",
+		chip.get_pc(), chip.get_index(), chip.get_stack().size(), chip.get_delay_timer(), chip.get_sound_timer());
+}
+
+
+static auto print_throughput(const headless_result& result) -> void {
+	std::printf("%llu instructions, %llu frames in %.3f s (%.2f MIPS)",
+		static_cast<unsigned long long>(result.instructions),
+		static_cast<unsigned long long>(result.frames),
+		result.elapsed.count(),
+		result.instructions_per_second() / 1'000'000.0);
+
+	if (result.idle_instructions > 0) {
+		std::printf(", %.1f%% skipped in idle loops", 100.0 * result.idle_fraction());
+	}
+}
+
+
+// The save states loaded before and written after a single run, the frames rewound after it,
+// and the movie replayed during it. Not used if empty.
+struct state_files {
+	std::filesystem::path load;
+	std::filesystem::path save;
+	std::optional<uint64_t> rewind;
+	std::filesystem::path movie;
+};
+
+
+// Print whether the replay of a movie reproduced the recording. Returns false if it didn't.
+static auto report_movie(const MoviePlayer& player) -> bool {
+	const auto& header = player.get_movie().get_header();
+	const auto result  = player.get_result();
+
+	std::cout << "Movie: " << header.event_count << " events over " << header.length << " instructions, ";
+	if (!result) {
+		std::cout << "the end wasn't reached\n";
+		return true;
+	}
+	if (!*result) {
+		std::cout << "the replay doesn't match the recording (" << player.get_late_events() << " late events)\n";
+		return false;
+	}
+	std::cout << "the replay matches the recording\n";
+	return true;
+}
+
+
+// Run a single ROM and print the final state
+static auto run_single(const std::filesystem::path& rom, const batch_options& options, const state_files& states, bool count_given, bool quiet) -> int {
+	auto runner = HeadlessRunner{};
+	auto& chip  = runner.get_chip();
+
+	options.system.apply(chip);
+
+	if (!runner.load_rom(rom)) {
+		return 1;
+	}
+	if (!states.movie.empty() and !runner.play_movie(states.movie)) {
+		return 1;
+	}
+	if (!states.load.empty() and !runner.load_state(states.load)) {
+		return 1;
+	}
+	if (states.rewind) {
+		runner.set_rewind_enabled(true);
+	}
+
+	// A movie runs to its end by default
+	const auto* player = runner.get_movie_player();
+	const bool to_movie_end = player and !count_given;
+
+	const auto result = to_movie_end   ? runner.run_instructions(player->get_movie().get_header().length)
+	                  : options.frames ? runner.run_frames(options.count)
+	                  : runner.run_instructions(options.count);
+
+	if (states.rewind) {
+		const uint64_t rewound = runner.rewind(*states.rewind);
+		if (!quiet) {
+			std::cout << "Rewound " << rewound << " frames\n\n";
+		}
+	}
+
+	if (!states.save.empty() and !runner.save_state(states.save)) {
+		return 1;
+	}
+
+	if (const auto* info = chip.get_rom_info(); info and !quiet) {
+		std::cout << "ROM database: " << info->title << " (" << to_string(chip.get_platform()) << ", " << to_string(chip.get_quirk_profile()) << " quirks";
+		if (chip.get_clock_mode() == ClockMode::instructions_per_frame) {
+			std::cout << ", " << chip.get_instructions_per_frame() << " instructions per frame";
+		}
+		std::cout << ")\n\n";
+	}
+
+	if (!quiet) {
+		print_display(chip);
+		std::cout << '\n';
+		print_registers(chip);
+		std::cout << '\n';
+	}
+
+	print_throughput(result);
+	if (result.halted) {
+		std::cout << ", halted: " << to_string(chip.get_halt_reason());
+	}
+	std::cout << '\n';
+
+	if (player and !report_movie(*player)) {
+		return 1;
+	}
+
+	return 0;
+}
+
+
+// Run every ROM on all cores and print a report
+static auto run_many(std::span<const batch_job> jobs, const batch_options& options, bool quiet) -> int {
+	const auto start = std::chrono::steady_clock::now();
+	const auto results = run_batch(jobs, options);
+	const auto elapsed = std::chrono::duration<double>{std::chrono::steady_clock::now() - start};
+
+	headless_result total;
+	size_t failures = 0;
+
+	if (!quiet) {
+		std::printf("%-16s  %12s  %-20s  %10s  %s\n", "display", "instructions", "halt", "seed", "rom");
+	}
+
+	for (const auto& result : results) {
+		total.instructions      += result.run.instructions;
+		total.frames            += result.run.frames;
+		total.idle_instructions += result.run.idle_instructions;
+
+		if (!result.loaded) {
+			++failures;
+		}
+
+		if (quiet) {
+			continue;
+		}
+
+		const auto seed = result.job.seed ? std::to_string(*result.job.seed) : std::string{"-"};
+		const auto halt = result.loaded ? to_string(result.halt_reason) : std::string_view{"load failed"};
+
+		std::printf("%016llX  %12llu  %-20.*s  %10s  %s\n",
+			static_cast<unsigned long long>(result.display_hash),
+			static_cast<unsigned long long>(result.run.instructions),
+			static_cast<int>(halt.size()), halt.data(),
+			seed.c_str(),
+			result.job.rom.string().c_str());
+	}
+
+	total.elapsed = elapsed;
+
+	const size_t threads = (options.threads != 0) ? options.threads : std::max(size_t{1}, static_cast<size_t>(std::thread::hardware_concurrency()));
+
+	std::printf("\n%zu runs on %zu threads: ", results.size(), threads);
+	print_throughput(total);
+	std::cout << '\n';
+
+	return (failures == 0) ? 0 : 1;
+}
+
+
+int main(int argc, char** argv) {
+	auto options = batch_options{};
+	std::vector<std::filesystem::path> roms;
+	std::optional<uint64_t> seeds;
+	state_files states;
+	bool count_given = false;
+	bool quiet = false;
+
+	for (int idx = 1; idx < argc; ++idx) {
+		const auto arg = std::string_view{argv[idx]};
+
+		if (!arg.starts_with("--")) {
+			const auto path = std::filesystem::path{arg};
+
+			// Collect every ROM in a directory, in a stable order
+			if (std::filesystem::is_directory(path)) {
+				std::vector<std::filesystem::path> found;
+				for (const auto& entry : std::filesystem::recursive_directory_iterator{path}) {
+					if (entry.is_regular_file() and (entry.path().extension() == ".ch8")) {
+						found.push_back(entry.path());
+					}
+				}
+				std::ranges::sort(found);
+				roms.insert(roms.end(), found.begin(), found.end());
+			}
+			else {
+				roms.push_back(path);
+			}
+			continue;
+		}
+
+		if (arg == "--jit")       { options.system.jit = true;          continue; }
+		if (arg == "--no-fusion") { options.system.fusion = false;      continue; }
+		if (arg == "--no-aot")    { options.system.aot = false;         continue; }
+		if (arg == "--no-idle-skip") { options.system.idle_skip = false; continue; }
+		if (arg == "--xo-chip")   { options.system.platform = Platform::xo_chip; continue; }
+		if (arg == "--quiet")     { quiet = true;                       continue; }
+		if (arg == "--lockstep")  { options.lockstep = true;            continue; }
+
+		if (arg == "--db") {
+			auto database = std::make_shared<RomDatabase>();
+			if (((idx + 1) >= argc) or !database->load(argv[++idx])) {
+				std::cout << "Invalid value for " << arg << '\n';
+				return 1;
+			}
+			options.system.rom_database = std::move(database);
+			continue;
+		}
+
+		if (arg == "--load-state" or arg == "--save-state" or arg == "--movie") {
+			if ((idx + 1) >= argc) {
+				std::cout << "Invalid value for " << arg << '\n';
+				return 1;
+			}
+			(arg == "--load-state" ? states.load : (arg == "--save-state") ? states.save : states.movie) = argv[++idx];
+			continue;
+		}
+
+		if (arg == "--quirks") {
+			const auto profile = ((idx + 1) < argc) ? to_quirk_profile(argv[++idx]) : std::nullopt;
+			if (!profile) {
+				std::cout << "Invalid value for " << arg << '\n';
+				return 1;
+			}
+			options.system.quirks = *profile;
+			continue;
+		}
+
+		if (arg != "--cycles" and arg != "--frames" and arg != "--clock" and arg != "--ipf"
+		    and arg != "--seed" and arg != "--seeds" and arg != "--threads" and arg != "--rewind") {
+			std::cout << "Unknown option " << arg << "\n\n" << usage;
+			return 1;
+		}
+
+		// The remaining options take a numeric value
+		const auto number = ((idx + 1) < argc) ? parse_number(argv[++idx]) : std::nullopt;
+		if (!number) {
+			std::cout << "Invalid value for " << arg << '\n';
+			return 1;
+		}
+
+		// The clock settings are checked before they're narrowed to 32 bits
+		const bool invalid_clock = (arg == "--clock") and ((*number == 0) or (*number > chip8::max_clock_rate));
+		const bool invalid_ipf   = (arg == "--ipf") and ((*number == 0) or (*number > chip8::max_instructions_per_frame));
+		if (invalid_clock or invalid_ipf) {
+			std::cout << "Invalid value for " << arg << '\n';
+			return 1;
+		}
+
+		if (arg == "--cycles" or arg == "--frames") {
+			options.count  = *number;
+			options.frames = (arg == "--frames");
+			count_given    = true;
+		}
+		else if (arg == "--clock")   options.system.clock_rate = static_cast<uint32_t>(*number);
+		else if (arg == "--ipf")     options.system.instructions_per_frame = static_cast<uint32_t>(*number);
+		else if (arg == "--seed")    options.system.rng_seed = static_cast<uint32_t>(*number);
+		else if (arg == "--seeds")   seeds = *number;
+		else if (arg == "--threads") options.threads = static_cast<size_t>(*number);
+		else if (arg == "--rewind")  states.rewind = *number;
+	}
+
+	if (roms.empty()) {
+		std::cout << usage;
+		return 1;
+	}
+
+	if (!states.movie.empty() and !states.load.empty()) {
+		std::cout << "A movie replays from the start of the ROM, so it can't be used with --load-state\n";
+		return 1;
+	}
+
+	if ((roms.size() == 1) and !seeds and !options.lockstep) {
+		return run_single(roms.front(), options, states, count_given, quiet);
+	}
+	if (!states.load.empty() or !states.save.empty() or states.rewind or !states.movie.empty()) {
+		std::cout << "Save states, rewinding, and movies can only be used with a single ROM\n";
+		return 1;
+	}
+
+	std::vector<batch_job> jobs;
+	for (const auto& rom : roms) {
+		if (seeds) {
+			for (uint64_t seed = 0; seed < *seeds; ++seed) {
+				jobs.push_back(batch_job{rom, static_cast<uint32_t>(seed)});
+			}
+		}
+		else {
+			jobs.push_back(batch_job{rom, options.system.rng_seed});
+		}
+	}
+
+	return run_many(jobs, options, quiet);
+}